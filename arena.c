@@ -0,0 +1,93 @@
+#include "arena.h"
+#include <stdlib.h>
+
+#define ARENA_BLOCK_SIZE (64 * 1024)
+#define ARENA_ALIGN 16
+
+struct ArenaBlock {
+    ArenaBlock *prev;
+    size_t index;
+    size_t size;
+    size_t used;
+    _Alignas(ARENA_ALIGN) unsigned char data[];
+};
+
+static ArenaBlock *new_block(Arena *arena, size_t size) {
+    size_t capacity = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+    ArenaBlock *block = NULL;
+
+    if (arena->spare && arena->spare->size >= capacity) {
+        block = arena->spare;
+        arena->spare = NULL;
+    } else {
+        block = malloc(sizeof(ArenaBlock) + capacity);
+        if (!block) return NULL;
+        block->size = capacity;
+    }
+
+    block->prev = arena->current;
+    block->index = arena->current ? arena->current->index + 1 : 0;
+    block->used = 0;
+    arena->current = block;
+    return block;
+}
+
+void *arena_alloc(Arena *arena, size_t size) {
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+
+    ArenaBlock *block = arena->current;
+    if (!block || block->size - block->used < size) {
+        block = new_block(arena, size);
+        if (!block) return NULL;
+    }
+
+    void *memory = block->data + block->used;
+    block->used += size;
+    return memory;
+}
+
+ArenaMark arena_mark(const Arena *arena) {
+    ArenaMark mark = {0, 0};
+    if (arena->current) {
+        mark.block = arena->current->index;
+        mark.used = arena->current->used;
+    }
+    return mark;
+}
+
+static int mark_before(ArenaMark a, ArenaMark b) {
+    return a.block < b.block || (a.block == b.block && a.used < b.used);
+}
+
+// Free everything allocated after `mark`, except what arena_protect() kept
+void arena_rollback(Arena *arena, ArenaMark mark) {
+    if (mark_before(mark, arena->floor)) mark = arena->floor;
+
+    while (arena->current && arena->current->index > mark.block) {
+        ArenaBlock *block = arena->current;
+        arena->current = block->prev;
+        free(arena->spare);
+        arena->spare = block;
+    }
+
+    if (arena->current && arena->current->index == mark.block) {
+        arena->current->used = mark.used;
+    }
+}
+
+// Keep every allocation made so far alive across later rollbacks
+void arena_protect(Arena *arena) {
+    arena->floor = arena_mark(arena);
+}
+
+void arena_release(Arena *arena) {
+    while (arena->current) {
+        ArenaBlock *block = arena->current;
+        arena->current = block->prev;
+        free(block);
+    }
+    free(arena->spare);
+    arena->spare = NULL;
+    arena->floor.block = 0;
+    arena->floor.used = 0;
+}
@@ -0,0 +1,29 @@
+#ifndef ARENA_H_
+#define ARENA_H_
+
+#include <stddef.h>
+
+// Bump allocator: many small allocations, released all at once.
+// A mark records the current top so a failed attempt can be undone
+// with a single rollback.
+
+typedef struct ArenaBlock ArenaBlock;
+
+typedef struct {
+    size_t block;   // Index of the block that was on top
+    size_t used;    // Bytes used in that block
+} ArenaMark;
+
+typedef struct {
+    ArenaBlock *current;  // Block allocations are served from
+    ArenaBlock *spare;    // Last block given back by a rollback, reused first
+    ArenaMark floor;      // Rollbacks never go below this point
+} Arena;
+
+void *arena_alloc(Arena *arena, size_t size);
+ArenaMark arena_mark(const Arena *arena);
+void arena_rollback(Arena *arena, ArenaMark mark);
+void arena_protect(Arena *arena);
+void arena_release(Arena *arena);
+
+#endif // ARENA_H_
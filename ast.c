@@ -0,0 +1,71 @@
+#include "ast.h"
+
+#include <inttypes.h>
+
+static const char *const AST_KIND_NAMES[AST_KIND_COUNT] = {
+#define AST_NAME_ENTRY(kind, name) [kind] = name,
+    AST_KIND_LIST(AST_NAME_ENTRY)
+#undef AST_NAME_ENTRY
+};
+
+const char *ast_kind_name(AstKind kind) {
+    return kind < AST_KIND_COUNT ? AST_KIND_NAMES[kind] : "UNKNOWN";
+}
+
+// Names and literals, the kinds that keep a lexeme instead of operands
+int ast_is_leaf(AstKind kind) {
+    return kind >= AST_NAME;
+}
+
+size_t ast_node_count(const AstNode *node) {
+    if (!node) return 0;
+
+    size_t count = 1;
+    for (uint32_t i = 0; i < node->count; i++) {
+        count += ast_node_count(node->operands[i]);
+    }
+    return count;
+}
+
+static void write_leaf(const AstNode *node, FILE *file) {
+    switch (node->kind) {
+        case AST_INT:
+            fprintf(file, " %" PRId64, node->leaf.value.integer);
+            break;
+        case AST_FLOAT:
+            fprintf(file, " %.17g", node->leaf.value.real);
+            break;
+        case AST_BOOL:
+            fprintf(file, " %s", node->leaf.value.integer ? "true" : "false");
+            break;
+        case AST_CHAR:
+            fprintf(file, " '%.*s'", (int)node->leaf.length, node->leaf.text);
+            break;
+        case AST_STRING:
+            fprintf(file, " \"%.*s\"", (int)node->leaf.length, node->leaf.text);
+            break;
+        case AST_NAME:
+            fprintf(file, " %.*s", (int)node->leaf.length, node->leaf.text);
+            break;
+        default:
+            break;
+    }
+}
+
+static void write_node(const AstNode *node, FILE *file, int depth) {
+    fprintf(file, "%*s%s", depth * 2, "", ast_kind_name(node->kind));
+    if (node->op != TOKEN_UNKNOWN && node->kind != AST_STRING) {
+        fprintf(file, " %s", token_type_to_string(node->op));
+    }
+
+    if (ast_is_leaf(node->kind)) write_leaf(node, file);
+    fprintf(file, " (line %" PRIu32 ")\n", node->line);
+
+    for (uint32_t i = 0; i < node->count; i++) {
+        write_node(node->operands[i], file, depth + 1);
+    }
+}
+
+void write_ast(const AstNode *node, FILE *file) {
+    if (node) write_node(node, file, 0);
+}
@@ -0,0 +1,86 @@
+#ifndef AST_H_
+#define AST_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "lexers.h"
+
+// Kinds of abstract syntax tree nodes and the names write_ast() prints.
+// The comment after each entry lists its operands in order; "..." marks
+// a list of any length.
+#define AST_KIND_LIST(X) \
+    X(AST_PROGRAM,        "PROGRAM")        /* declarations..., MAIN */ \
+    X(AST_MAIN,           "MAIN")           /* [ARGS], body; op: return type */ \
+    X(AST_BLOCK,          "BLOCK")          /* statements... */ \
+    X(AST_VAR_DECL,       "VAR_DECL")       /* VAR...; op: type */ \
+    X(AST_VAR,            "VAR")            /* name, [initializer]; op: assignment, if initialized */ \
+    X(AST_ARRAY_DECL,     "ARRAY_DECL")     /* name, size; op: element type */ \
+    X(AST_ARRAY_INIT,     "ARRAY_INIT")     /* name, size, LIST; op: element type */ \
+    X(AST_LIST,           "LIST")           /* elements... */ \
+    X(AST_FUNC_DECL,      "FUNC_DECL")      /* name, PARAMS; op: return type */ \
+    X(AST_FUNC_DEF,       "FUNC_DEF")       /* name, PARAMS, body; op: return type */ \
+    X(AST_PARAMS,         "PARAMS")         /* PARAM or ARRAY_DECL... */ \
+    X(AST_PARAM,          "PARAM")          /* name; op: type */ \
+    X(AST_CALL,           "CALL")           /* name, ARGS */ \
+    X(AST_ARGS,           "ARGS")           /* expressions... */ \
+    X(AST_ASSIGN,         "ASSIGN")         /* target, [value]; op: assignment */ \
+    X(AST_IF,             "IF")             /* condition, then, [else]; else-if chains nest */ \
+    X(AST_WHILE,          "WHILE")          /* condition, body */ \
+    X(AST_FOR,            "FOR")            /* init, condition, update, body */ \
+    X(AST_RETURN,         "RETURN")         /* value */ \
+    X(AST_BREAK,          "BREAK")          \
+    X(AST_CONTINUE,       "CONTINUE")       \
+    X(AST_DISPLAY,        "DISPLAY")        /* STRING or NAME, values...; op: format specifier, if any */ \
+    X(AST_INPUT,          "INPUT")          /* target, prompt; op: type */ \
+    X(AST_BINARY,         "BINARY")         /* left, right; op: operator */ \
+    X(AST_UNARY,          "UNARY")          /* operand; op: operator */ \
+    X(AST_PREFIX_UPDATE,  "PREFIX_UPDATE")  /* name; op: UNARY_INC or UNARY_DEC */ \
+    X(AST_POSTFIX_UPDATE, "POSTFIX_UPDATE") /* name; op: UNARY_INC or UNARY_DEC */ \
+    X(AST_INDEX,          "INDEX")          /* name, index */ \
+    X(AST_NAME,           "NAME")           \
+    X(AST_INT,            "INT")            \
+    X(AST_FLOAT,          "FLOAT")          \
+    X(AST_BOOL,           "BOOL")           \
+    X(AST_CHAR,           "CHAR")           \
+    X(AST_STRING,         "STRING")         /* op: STR_CONST or STR_WITH_FORMAT */ \
+    X(AST_NULL,           "NULL")
+
+typedef enum {
+#define AST_ENUM(kind, name) kind,
+    AST_KIND_LIST(AST_ENUM)
+#undef AST_ENUM
+    AST_KIND_COUNT
+} AstKind;
+
+// Operands stored inside the node; longer lists get their own array
+#define AST_INLINE_OPERANDS 3
+
+// One node of the abstract syntax tree. Punctuation, keywords and
+// single-child wrappers of the parse tree have no node here: their
+// meaning is carried by the kind and op. Names and literals are leaves
+// and keep their lexeme and decoded value instead of operands.
+typedef struct AstNode {
+    AstKind kind;
+    TokenType op;               // Operator, assignment, type or format token; TOKEN_UNKNOWN if none
+    uint32_t line;              // Source line the construct starts on
+    uint32_t count;             // Entries in operands; 0 for leaves
+    struct AstNode **operands;  // inlineOperands for short lists
+    union {
+        struct AstNode *inlineOperands[AST_INLINE_OPERANDS];
+        struct {
+            const char *text;   // Lexeme in the parsed source, not NUL-terminated
+            uint32_t length;
+            TokenValue value;   // AST_INT and AST_FLOAT; AST_BOOL and AST_CHAR use value.integer
+        } leaf;
+    };
+} AstNode;
+
+const char *ast_kind_name(AstKind kind);
+int ast_is_leaf(AstKind kind);
+// Number of nodes in the tree below and including `node`
+size_t ast_node_count(const AstNode *node);
+// One node per line, indented by depth: kind, op, lexeme or value, line
+void write_ast(const AstNode *node, FILE *file);
+
+#endif // AST_H_
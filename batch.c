@@ -0,0 +1,339 @@
+#define _POSIX_C_SOURCE 200809L
+#include "batch.h"
+#include "lexers.h"
+#include "parser.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#define make_dir(path) _mkdir(path)
+#else
+#define make_dir(path) mkdir(path, 0777)
+#endif
+
+typedef enum {
+    UNIT_PENDING,
+    UNIT_PARSED,
+    UNIT_PARSE_FAILED,
+    UNIT_UNREADABLE,
+    UNIT_NO_OUTPUT_DIR
+} UnitStatus;
+
+typedef struct {
+    char *path;
+    char *output_dir;
+    UnitStatus status;
+} Unit;
+
+typedef struct {
+    Unit *units;
+    size_t count;
+    size_t capacity;
+} UnitList;
+
+// One deque per worker. The owner takes work from the bottom and idle
+// workers steal from the top, so they rarely touch the same end.
+typedef struct {
+    pthread_mutex_t lock;
+    size_t *items;
+    size_t top;
+    size_t bottom;
+} WorkDeque;
+
+typedef struct {
+    UnitList *units;
+    WorkDeque *deques;
+    int worker_count;
+    const BatchOptions *options;
+} Pool;
+
+typedef struct {
+    Pool *pool;
+    int id;
+} Worker;
+
+static int has_extension(const char *path, const char *extension) {
+    size_t length = strlen(path);
+    size_t extension_length = strlen(extension);
+    return length > extension_length && strcmp(path + length - extension_length, extension) == 0;
+}
+
+// Mirror the input path below the output directory: drop the .cty
+// extension, leading '/' and "./" parts, and turn ".." into "__"
+static char *unit_output_dir(const char *output_dir, const char *path) {
+    size_t length = strlen(path) - strlen(".cty");
+    char *result = malloc(strlen(output_dir) + 1 + length * 2 + 1);
+    char *out = result + sprintf(result, "%s", output_dir);
+
+    const char *part = path;
+    const char *end = path + length;
+    while (part < end) {
+        const char *slash = memchr(part, '/', end - part);
+        size_t part_length = (slash ? slash : end) - part;
+
+        if (part_length == 2 && strncmp(part, "..", 2) == 0) {
+            out += sprintf(out, "/__");
+        } else if (part_length > 0 && !(part_length == 1 && part[0] == '.')) {
+            *out++ = '/';
+            memcpy(out, part, part_length);
+            out += part_length;
+        }
+        part += part_length + 1;
+    }
+    *out = '\0';
+    return result;
+}
+
+static void add_unit(UnitList *list, const char *path, const char *output_dir) {
+    if (list->count == list->capacity) {
+        list->capacity = list->capacity ? list->capacity * 2 : 64;
+        list->units = realloc(list->units, list->capacity * sizeof(Unit));
+    }
+
+    Unit *unit = &list->units[list->count++];
+    unit->path = strdup(path);
+    unit->output_dir = unit_output_dir(output_dir, path);
+    unit->status = UNIT_PENDING;
+}
+
+// Add every .cty file below `dir_path`
+static void collect_directory(UnitList *list, const char *dir_path, const char *output_dir) {
+    DIR *dir = opendir(dir_path);
+    if (!dir) {
+        fprintf(stderr, "Error: cannot open directory %s\n", dir_path);
+        return;
+    }
+
+    struct dirent *entry;
+    while ((entry = readdir(dir))) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+
+        size_t length = strlen(dir_path) + 1 + strlen(entry->d_name) + 1;
+        char *child = malloc(length);
+        snprintf(child, length, "%s/%s", dir_path, entry->d_name);
+
+        struct stat info;
+        if (stat(child, &info) == 0) {
+            if (S_ISDIR(info.st_mode)) {
+                collect_directory(list, child, output_dir);
+            } else if (has_extension(child, ".cty")) {
+                add_unit(list, child, output_dir);
+            }
+        }
+        free(child);
+    }
+    closedir(dir);
+}
+
+static int compare_units(const void *a, const void *b) {
+    return strcmp(((const Unit *)a)->output_dir, ((const Unit *)b)->output_dir);
+}
+
+// Sort by output directory and drop inputs that would share one
+static void remove_duplicate_units(UnitList *list) {
+    if (list->count == 0) return;
+    qsort(list->units, list->count, sizeof(Unit), compare_units);
+
+    size_t kept = 0;
+    for (size_t i = 0; i < list->count; i++) {
+        if (kept > 0 && strcmp(list->units[kept - 1].output_dir, list->units[i].output_dir) == 0) {
+            free(list->units[i].path);
+            free(list->units[i].output_dir);
+            continue;
+        }
+        list->units[kept++] = list->units[i];
+    }
+    list->count = kept;
+}
+
+// Create `path` and any missing parents
+static int make_dirs(const char *path) {
+    char *copy = strdup(path);
+    int ok = 1;
+
+    for (char *c = copy + 1; ok; c++) {
+        if (*c != '/' && *c != '\0') continue;
+
+        char saved = *c;
+        *c = '\0';
+        if (make_dir(copy) != 0 && errno != EEXIST) ok = 0;
+        *c = saved;
+        if (saved == '\0') break;
+    }
+
+    free(copy);
+    return ok;
+}
+
+static void write_symbol_table_file(const TokenStream *tokens, const char *output_dir) {
+    size_t length = strlen(output_dir) + sizeof("/symbol_table.txt");
+    char *path = malloc(length);
+    snprintf(path, length, "%s/symbol_table.txt", output_dir);
+
+    FILE *file = fopen(path, "w");
+    if (file) {
+        write_token_stream(tokens, file);
+        fclose(file);
+    } else {
+        fprintf(stderr, "Failed to open %s for writing\n", path);
+    }
+    free(path);
+}
+
+static void compile_unit(Unit *unit, LexerState *lexer, Parser *parser, const BatchOptions *options) {
+    const TokenStream *tokens = lexer_lex(lexer, unit->path);
+    if (!tokens) {
+        unit->status = UNIT_UNREADABLE;
+        return;
+    }
+
+    if (!make_dirs(unit->output_dir)) {
+        unit->status = UNIT_NO_OUTPUT_DIR;
+        return;
+    }
+
+    if (options->write_symbol_table) {
+        write_symbol_table_file(tokens, unit->output_dir);
+    }
+
+    int parsed = writeParseOutputs(parser, tokens, unit->output_dir);
+    unit->status = parsed ? UNIT_PARSED : UNIT_PARSE_FAILED;
+}
+
+// Take the next unit: our own newest first, then the oldest of another worker
+static int next_unit(Pool *pool, int id, size_t *unit) {
+    WorkDeque *own = &pool->deques[id];
+    int found = 0;
+
+    pthread_mutex_lock(&own->lock);
+    if (own->bottom > own->top) {
+        *unit = own->items[--own->bottom];
+        found = 1;
+    }
+    pthread_mutex_unlock(&own->lock);
+
+    for (int i = 1; !found && i < pool->worker_count; i++) {
+        WorkDeque *victim = &pool->deques[(id + i) % pool->worker_count];
+        pthread_mutex_lock(&victim->lock);
+        if (victim->bottom > victim->top) {
+            *unit = victim->items[victim->top++];
+            found = 1;
+        }
+        pthread_mutex_unlock(&victim->lock);
+    }
+    return found;
+}
+
+static void *run_worker(void *arg) {
+    Worker *worker = arg;
+    Pool *pool = worker->pool;
+    LexerState *lexer = lexer_create();
+    Parser *parser = createParser();
+
+    size_t unit;
+    while (lexer && parser && next_unit(pool, worker->id, &unit)) {
+        compile_unit(&pool->units->units[unit], lexer, parser, pool->options);
+    }
+
+    destroyParser(parser);
+    lexer_destroy(lexer);
+    return NULL;
+}
+
+static int online_cores(void) {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    return cores > 0 ? (int)cores : 1;
+}
+
+int run_batch(char **paths, int path_count, const BatchOptions *options) {
+    UnitList units = {0};
+    int failures = 0;
+
+    for (int i = 0; i < path_count; i++) {
+        struct stat info;
+        if (stat(paths[i], &info) == 0 && S_ISDIR(info.st_mode)) {
+            collect_directory(&units, paths[i], options->output_dir);
+        } else if (has_extension(paths[i], ".cty")) {
+            add_unit(&units, paths[i], options->output_dir);
+        } else {
+            fprintf(stderr, "Error: unexpected file type: %s\n", paths[i]);
+            failures++;
+        }
+    }
+    remove_duplicate_units(&units);
+
+    int worker_count = options->jobs > 0 ? options->jobs : online_cores();
+    if ((size_t)worker_count > units.count) worker_count = units.count ? (int)units.count : 1;
+
+    // Deal the units out round-robin; stealing evens out uneven file sizes
+    Pool pool = { &units, calloc(worker_count, sizeof(WorkDeque)), worker_count, options };
+    for (int w = 0; w < worker_count; w++) {
+        pthread_mutex_init(&pool.deques[w].lock, NULL);
+        pool.deques[w].items = malloc((units.count / worker_count + 1) * sizeof(size_t));
+    }
+    for (size_t i = 0; i < units.count; i++) {
+        WorkDeque *deque = &pool.deques[i % worker_count];
+        deque->items[deque->bottom++] = i;
+    }
+
+    // A worker whose thread did not start leaves its deque to be stolen from
+    pthread_t *threads = malloc(worker_count * sizeof(pthread_t));
+    Worker *workers = malloc(worker_count * sizeof(Worker));
+    int started = 0;
+    for (int w = 0; w < worker_count; w++) {
+        workers[w].pool = &pool;
+        workers[w].id = w;
+        if (pthread_create(&threads[started], NULL, run_worker, &workers[w]) == 0) started++;
+    }
+    if (started == 0) {
+        // No threads at all: work through every deque on this one
+        run_worker(&workers[0]);
+    }
+    for (int w = 0; w < started; w++) {
+        pthread_join(threads[w], NULL);
+    }
+
+    size_t parsed = 0;
+    for (size_t i = 0; i < units.count; i++) {
+        Unit *unit = &units.units[i];
+        switch (unit->status) {
+            case UNIT_PARSED:
+                printf("%s: parsed -> %s\n", unit->path, unit->output_dir);
+                parsed++;
+                break;
+            case UNIT_PARSE_FAILED:
+                printf("%s: parsing failed -> %s\n", unit->path, unit->output_dir);
+                failures++;
+                break;
+            case UNIT_UNREADABLE:
+                printf("%s: cannot read file\n", unit->path);
+                failures++;
+                break;
+            default:
+                printf("%s: cannot create %s\n", unit->path, unit->output_dir);
+                failures++;
+                break;
+        }
+        free(unit->path);
+        free(unit->output_dir);
+    }
+    printf("Parsed %zu of %zu files with %d threads.\n", parsed, units.count, started ? started : 1);
+
+    for (int w = 0; w < worker_count; w++) {
+        pthread_mutex_destroy(&pool.deques[w].lock);
+        free(pool.deques[w].items);
+    }
+    free(pool.deques);
+    free(threads);
+    free(workers);
+    free(units.units);
+    return failures;
+}
@@ -0,0 +1,19 @@
+#ifndef BATCH_H_
+#define BATCH_H_
+
+// Batch mode: lex and parse many .cty files in one process on a
+// work-stealing thread pool. Each unit writes its outputs under
+// <output_dir>/<input path without .cty>/, e.g. samples/new.cty goes
+// to output/samples/new/parsed.txt.
+
+typedef struct {
+    const char *output_dir;
+    int jobs;                // Worker threads; 0 means one per online core
+    int write_symbol_table;
+} BatchOptions;
+
+// Compile every file in `paths`, and every .cty file below each directory
+// in it. Prints one status line per unit and returns how many failed.
+int run_batch(char **paths, int path_count, const BatchOptions *options);
+
+#endif // BATCH_H_
@@ -0,0 +1,113 @@
+#include "flat_tree.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+FlatTree *flat_tree_create(uint32_t count) {
+    FlatTree *tree = malloc(sizeof(FlatTree) + (size_t)count * (sizeof(FlatNode) + sizeof(uint32_t)));
+    if (!tree) return NULL;
+
+    tree->magic = FLAT_TREE_MAGIC;
+    tree->version = FLAT_TREE_VERSION;
+    tree->count = count;
+    tree->reserved = 0;
+    return tree;
+}
+
+size_t flat_tree_bytes(const FlatTree *tree) {
+    return sizeof(FlatTree) + (size_t)tree->count * (sizeof(FlatNode) + sizeof(uint32_t));
+}
+
+FlatTree *flat_tree_copy(const FlatTree *tree) {
+    FlatTree *copy = malloc(flat_tree_bytes(tree));
+    if (copy) memcpy(copy, tree, flat_tree_bytes(tree));
+    return copy;
+}
+
+void flat_tree_free(FlatTree *tree) {
+    free(tree);
+}
+
+int flat_tree_save(const FlatTree *tree, const char *path) {
+    FILE *file = fopen(path, "wb");
+    if (!file) return 0;
+
+    int saved = fwrite(tree, flat_tree_bytes(tree), 1, file) == 1;
+    return fclose(file) == 0 && saved;
+}
+
+// Whether `length` bytes at `tree` hold a complete tree whose subtrees
+// all end inside the node array and whose parents all contain their child
+static int is_valid(const FlatTree *tree, size_t length) {
+    if (length < sizeof(FlatTree) || tree->magic != FLAT_TREE_MAGIC || tree->version != FLAT_TREE_VERSION) return 0;
+    if (length != flat_tree_bytes(tree)) return 0;
+
+    const uint32_t *parents = flat_tree_parents(tree);
+    for (uint32_t i = 0; i < tree->count; i++) {
+        if (tree->nodes[i].size == 0 || tree->nodes[i].size > tree->count - i) return 0;
+        if (i == 0 ? parents[i] != FLAT_TREE_NO_PARENT
+                   : parents[i] >= i || !flat_tree_is_ancestor(tree, parents[i], i)) return 0;
+    }
+    return 1;
+}
+
+const FlatTree *flat_tree_map(const char *path) {
+#ifndef _WIN32
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+        close(fd);
+        return NULL;
+    }
+    size_t length = (size_t)info.st_size;
+    void *mapped = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) return NULL;
+
+    if (!is_valid(mapped, length)) {
+        munmap(mapped, length);
+        return NULL;
+    }
+    return mapped;
+#else
+    // No mmap: read the block into memory instead
+    FILE *file = fopen(path, "rb");
+    if (!file) return NULL;
+
+    FlatTree header;
+    FlatTree *tree = NULL;
+    if (fread(&header, sizeof(header), 1, file) == 1 && header.magic == FLAT_TREE_MAGIC && header.version == FLAT_TREE_VERSION) {
+        tree = flat_tree_create(header.count);
+        if (tree && fread(tree->nodes, flat_tree_bytes(tree) - sizeof(FlatTree), 1, file) != 1) {
+            flat_tree_free(tree);
+            tree = NULL;
+        }
+    }
+    fclose(file);
+
+    if (tree && !is_valid(tree, flat_tree_bytes(tree))) {
+        flat_tree_free(tree);
+        tree = NULL;
+    }
+    return tree;
+#endif
+}
+
+void flat_tree_unmap(const FlatTree *tree) {
+    if (!tree) return;
+#ifndef _WIN32
+    munmap((void *)tree, flat_tree_bytes(tree));
+#else
+    flat_tree_free((FlatTree *)tree);
+#endif
+}
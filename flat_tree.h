@@ -0,0 +1,65 @@
+#ifndef FLAT_TREE_H_
+#define FLAT_TREE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// A finished parse tree in one block: a header, every node in preorder,
+// then the parent of every node. Nodes refer to each other by position
+// only, so the block is freed or copied in one call, and a block written
+// to a file can be mapped back in and walked as it is (native byte order).
+//
+// A node's position is its ID, the NodeID of parse_tree.csv. The first
+// child of node i, if it has any, is node i + 1; each child's next
+// sibling follows its subtree, at j + nodes[j].size, up to the end of
+// the parent's subtree at i + nodes[i].size. A walk over the whole tree
+// is a scan of the array front to back.
+
+#define FLAT_TREE_MAGIC 0x45455254u  // "TREE"
+#define FLAT_TREE_VERSION 2
+
+// Parent of the root
+#define FLAT_TREE_NO_PARENT UINT32_MAX
+
+typedef struct {
+    uint32_t kind;   // Parse tree node kind; nodeKindLabel() names it
+    uint32_t size;   // Nodes in the subtree, this one included
+} FlatNode;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t count;  // Entries in nodes
+    uint32_t reserved;
+    FlatNode nodes[];  // Followed by uint32_t parents[count]
+} FlatTree;
+
+// The parent ID of every node, indexed by ID
+static inline uint32_t *flat_tree_parents(const FlatTree *tree) {
+    return (uint32_t *)(tree->nodes + tree->count);
+}
+
+static inline uint32_t flat_tree_parent(const FlatTree *tree, uint32_t id) {
+    return flat_tree_parents(tree)[id];
+}
+
+// Whether `ancestor` is `id` or lies on its path to the root
+static inline int flat_tree_is_ancestor(const FlatTree *tree, uint32_t ancestor, uint32_t id) {
+    return ancestor <= id && id - ancestor < tree->nodes[ancestor].size;
+}
+
+// Allocate a tree of `count` nodes with the header filled in
+FlatTree *flat_tree_create(uint32_t count);
+// Size of the whole block, header included
+size_t flat_tree_bytes(const FlatTree *tree);
+FlatTree *flat_tree_copy(const FlatTree *tree);
+void flat_tree_free(FlatTree *tree);
+
+// Write the block to `path`. Returns 0 on failure.
+int flat_tree_save(const FlatTree *tree, const char *path);
+// Map a block written by flat_tree_save() read-only. Returns NULL if the
+// file cannot be read or is not a flat tree of this version.
+const FlatTree *flat_tree_map(const char *path);
+void flat_tree_unmap(const FlatTree *tree);
+
+#endif // FLAT_TREE_H_
@@ -1,766 +1,681 @@
-#include "lexers.h"
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <ctype.h>
-
-size_t line_number = 1;        // Global line number
-
-Token *create_token(TokenType type, const char *value, size_t line_num) {
-    Token *token = (Token *)malloc(sizeof(Token));
-    token->type = type;
-    token->value = strdup(value);
-    token->line_num = line_num;
-    return token;
-}
-
-const char* token_type_to_string(TokenType type) {
-    switch (type) {
-        
-        case IDENTIFIER: return "IDENTIFIER";
-        case NUM_CONST: return "NUM_CONST";
-        case BOOL_CONST: return "BOOLEAN";     
-        case CHAR_CONST: return "CHAR_CONST";
-        case FLOAT_CONST: return "FLOAT_CONST";     
-        case STR_CONST: return "STR_CONST";
-        case STR_WITH_FORMAT: return "STR_WITH_FORMAT";
-        
-        case FORMAT_INT: return "FORMAT_INT";
-        case FORMAT_CHAR: return "FORMAT_CHAR";
-        case FORMAT_FLOAT: return "FORMAT_FLOAT";
-        case FORMAT_STR: return "FORMAT_STR";
-        
-        case ADD_OP: return "ADD_OP";
-        case SUB_OP: return "SUB_OP";
-        case MUL_OP: return "MUL_OP";
-        case DIV_OP: return "DIV_OP";
-        case INTDIV_OP: return "INTDIV_OP";
-        case MOD_OP: return "MOD_OP";
-        case EXPO_OP: return "EXPO_OP";
-
-        case REL_LT: return "REL_LT";
-        case REL_GT: return "REL_GT";
-        case REL_LE: return "REL_LE";
-        case REL_GE: return "REL_GE";
-        case REL_EQ: return "REL_EQ";
-        case REL_NEQ: return "REL_NEQ";
-        
-        case LOG_AND: return "LOG_AND";
-        case LOG_OR: return "LOG_OR";
-        case LOG_NOT: return "LOG_NOT";
-        
-        case UNARY_INC: return "UNARY_INC";
-        case UNARY_DEC: return "UNARY_DEC";
-
-        case ASSIGN_OP: return "ASSIGN_OP";
-        case ADD_ASSIGN: return "ADD_ASSIGN";
-        case SUB_ASSIGN: return "SUB_ASSIGN";
-        case MUL_ASSIGN: return "MUL_ASSIGN";
-        case DIV_ASSIGN: return "DIV_ASSIGN";
-        case INTDIV_ASSIGN: return "INTDIV_ASSIGN";
-        case MOD_ASSIGN: return "MOD_ASSIGN";
-        
-        case COMMA: return "COMMA";
-        case SEMICOLON: return "SEMICOLON";
-
-        case LEFT_CURLY: return "LEFT_CURLY";
-        case RIGHT_CURLY: return "RIGHT_CURLY";
-        case LEFT_PAREN:return "LEFT_PAREN";
-        case RIGHT_PAREN: return "RIGHT_PAREN";
-        case LEFT_BRACKET: return "LEFT_BRACKET";
-        case RIGHT_BRACKET: return "RIGHT_BRACKET";
-
-        case KW_BREAK: return "KW_BREAK";
-        case KW_CONTINUE: return "KW_CONTINUE";
-        case KW_DEFAULT: return "KW_DEFAULT";
-        case KW_DISPLAY: return "KW_DISPLAY";
-        case KW_ELSE: return "KW_ELSE";
-        case KW_FOR: return "KW_FOR";
-        case KW_IF: return "KW_IF";
-        case KW_INPUT: return "KW_INPUT";
-        case KW_MAIN: return "KW_MAIN";
-        case KW_RETURN: return "KW_RETURN";
-        case KW_WHILE: return "KW_WHILE";
-
-        case TYPE_BOOLEAN: return "TYPE_BOOLEAN";
-        case TYPE_CHARACTER: return "TYPE_CHARACTER";
-        case TYPE_FLOAT: return "TYPE_FLOAT";
-        case TYPE_INTEGER: return "TYPE_INTEGER";
-        case TYPE_STRING: return "TYPE_STRING";
-
-        case RW_CONSTANT: return "RW_CONSTANT";
-        case RW_NULL: return "RW_NULL";
-        case RW_VOID: return "RW_VOID";
-
-        case NW_DO: return "NW_DO";
-        case NW_END: return "NW_END";
-        case NW_LET: return "NW_LET";
-        case NW_THEN: return "NW_THEN";
-
-        case TOKEN_COMMENT: return "COMMENT";
-        case TOKEN_UNKNOWN: return "UNKNOWN";
-        case TOKEN_INVALID: return "INVALID";
-        case TOKEN_EOF: return "EOF";
-        default: return "UNDEFINED";
-    }
-}
-
-void print_token(const Token *token) {
-    printf("TOKEN: %-20s | TYPE: %-30s | LINE: %zu\n", 
-           token->value, 
-           token_type_to_string(token->type), 
-           token->line_num);
-}
-
-void write_to_symbol_table(const Token *token, FILE *symbol_table_file) {
-    fprintf(symbol_table_file, "TOKEN: %-20s | TYPE: %-30s | LINE: %zu\n", 
-            token->value, 
-            token_type_to_string(token->type), 
-           token->line_num);
-}
-
-void free_token(Token *token) {
-    if (token->value) free(token->value);
-    free(token);
-}
-
-Token *classify_number(const char *source, int *index) {
-    char buffer[64] = {0};
-    int buffer_index = 0;
-    int has_decimal = 0;
-    int is_flagged = 0;
-
-    // Append numbers with one decimal point
-    while (isdigit(source[*index]) || (source[*index] == '.') || (isalpha(source[*index]) || ispunct(source[*index]))) {
-        if (source[*index] == '.') {
-            has_decimal++;
-        } else if (isalpha(source[*index]) || strchr("@#", source[*index])){ // Flags for containing letters and special characters
-            is_flagged++;
-        } else if (ispunct(source[*index]) && !(strchr("@#", source[*index]))){ // Exits loop if an operator is seen
-            break;
-        }
-        
-        buffer[buffer_index++] = source[(*index)++];
-    }
-
-    // Determines if the number of decimals is invalid or has letters
-    if (has_decimal > 1 || is_flagged){
-        fprintf(stderr, "Error: Invalid token '%s' at line %zu\n", buffer, line_number);
-        return create_token(TOKEN_INVALID, buffer, line_number);
-    }
-
-    // Determine the token type based on the presence of a decimal point
-    TokenType type = has_decimal ? FLOAT_CONST : NUM_CONST;
-
-    return create_token(type, buffer, line_number);
-}
-
-
-Token *classify_string(const char *source, int *index) {
-    char buffer[256] = {0};
-    int buffer_index = 0;
-    int expect_format = 0;
-    int format_spec_count = 0;
-
-    (*index)++; // Skip the opening quote
-
-    while (source[*index] != '"' && source[*index] != '\0') {
-        
-        if (expect_format != 0) {
-            if (strchr("dcfs", source[*index])) { // int char float str
-                format_spec_count++;
-            }
-
-            buffer[buffer_index++] = source[(*index)++];
-            expect_format = 0;
-            continue;
-
-        } else if (source[*index] == '\n') {
-            line_number++;
-             
-        } else if (source[*index] == '%') {
-            buffer[buffer_index++] = source[(*index)++];
-            expect_format++;
-            continue;
-        }
-        
-        buffer[buffer_index++] = source[(*index)++];
-    }
-
-    if (source[*index] == '"') {
-        (*index)++; // Skip
-    } else {
-        fprintf(stderr, "Error: Unterminated string at line %zu\n", line_number);
-    }
-
-    if (format_spec_count > 0) {
-        return create_token(STR_WITH_FORMAT, buffer, line_number);
-    } else {
-        return create_token(STR_CONST, buffer, line_number);
-    }
-    
-}
-
-
-Token *classify_character(const char *source, int *index) {
-    (*index)++; // Skip apostrophe
-    char c = source[*index];
-
-    // Checks if character is empty 
-    if (c == '\0' || c == '\'') {
-        fprintf(stderr, "Error: Invalid or empty character at line %zu\n", line_number);
-        return NULL;
-    }
-
-    (*index)++;
-
-    // Check if there's more than one character inside apostrophe
-    if (source[*index] != '\'') {
-        char buffer[50];
-        int buffer_index = 0;
-        (*index)--; // Move back one character
-
-        fprintf(stderr, "Error: Too many characters in character constant at line %zu\n", line_number);
-
-        // Appends characters to buffer
-        while (source[*index] != '\'' && source[*index] != '\0') {
-            buffer[buffer_index] = source[*index];
-            (*index)++;
-            buffer_index++;
-        }
-
-        if (source[*index] == '\'') { // Skip apostrophe
-            (*index)++;
-        }
-
-        return create_token(TOKEN_INVALID, buffer, line_number);
-    }
-
-    (*index)++;
-
-    char buffer[2] = {c, '\0'};
-    return create_token(CHAR_CONST, buffer, line_number);
-}
-
-
-Token *classify_comment(const char *source, int *index) {
-    char buffer[256] = {0}; 
-    int buffer_index = 0;
-    size_t start_line = line_number;  
-
-    // Single-line comment: starts with `~~`
-    if (source[*index] == '~' && source[*index + 1] == '~') {
-        *index += 2;  // Skip the `~~`
-        while (source[*index] != '\n' && source[*index] != '\0') {
-            buffer[buffer_index++] = source[(*index)++];
-        }
-        return create_token(TOKEN_COMMENT, buffer, line_number);  // single-line comment
-    }
-
-    // Multi-line comment: starts with `~^` and ends with `^~`
-    if (source[*index] == '~' && source[*index + 1] == '^') {
-        *index += 2;  // Skip the `~^`
-        while (!(source[*index] == '^' && source[*index + 1] == '~') && source[*index] != '\0') {
-            if (source[*index] == '\n') {
-                line_number++;  // Increment the line number for each new line
-                buffer[buffer_index++] = ' ';  // Add a space instead of a newline
-            } else {
-                buffer[buffer_index++] = source[*index];  // Add other characters normally
-            }
-            (*index)++;
-        }
-
-        // Ensure we skip the closing `^~` if found
-        if (source[*index] == '^' && source[*index + 1] == '~') {
-            *index += 2;
-        } else {
-            printf("Warning: Unterminated multi-line comment at line %zu\n", line_number);
-        }
-
-        return create_token(TOKEN_COMMENT, buffer, start_line);
-    }
-
-    return NULL;  // Not a comment
-}
-
-
-Token *classify_word(const char *lexeme) {
-    int startIdx = 0;
-
-    switch (lexeme[startIdx]) {
-        case 'b':
-            switch (lexeme[startIdx + 1]) {
-                case 'r':
-                    if (lexeme[startIdx + 2] == 'e' && lexeme[startIdx + 3] == 'a' && lexeme[startIdx + 4] == 'k' && 
-                    lexeme[startIdx + 5] == '\0') {
-                        return create_token(KW_BREAK, "BREAK", line_number); // "break"
-                    }
-                    break;
-                case 'o':
-                    if (lexeme[startIdx + 2] == 'o' && lexeme[startIdx + 3] == 'l' && lexeme[startIdx + 4] == 'e' && 
-                    lexeme[startIdx + 5] == 'a' && lexeme[startIdx + 6] == 'n' && lexeme[startIdx + 7] == '\0') {
-                        return create_token(TYPE_BOOLEAN, "BOOLEAN", line_number); // "boolean"
-                    }
-                    break;
-            }
-            break;
-        
-        case 'c': // Handles words starting with 'c'
-            switch (lexeme[startIdx + 1]) {
-                case 'h': // "character"
-                    if (lexeme[startIdx + 2] == 'a' && lexeme[startIdx + 3] == 'r' &&
-                        lexeme[startIdx + 4] == 'a' && lexeme[startIdx + 5] == 'c' &&
-                        lexeme[startIdx + 6] == 't' && lexeme[startIdx + 7] == 'e' &&
-                        lexeme[startIdx + 8] == 'r' && lexeme[startIdx + 9] == '\0') {
-                        return create_token(TYPE_CHARACTER, "CHARACTER", line_number); // "character"
-                    }
-                    break;
-                case 'o': 
-                    switch (lexeme[startIdx + 2]) {
-                        case 'n': 
-                            switch (lexeme[startIdx + 3]) {
-                                case 's': 
-                                    if (lexeme[startIdx + 4] == 't' && lexeme[startIdx + 5] == 'a' &&
-                                        lexeme[startIdx + 6] == 'n' && lexeme[startIdx + 7] == 't' &&
-                                        lexeme[startIdx + 8] == '\0') {
-                                        return create_token(RW_CONSTANT, "CONSTANT", line_number); // "constant"
-                                    }
-                                    break;
-                                case 't': 
-                                    if (lexeme[startIdx + 4] == 'i' && lexeme[startIdx + 5] == 'n' &&
-                                        lexeme[startIdx + 6] == 'u' && lexeme[startIdx + 7] == 'e' &&
-                                        lexeme[startIdx + 8] == '\0') {
-                                        return create_token(KW_CONTINUE, "CONTINUE", line_number);// "continue"
-                                    }
-                                    break;
-                            }
-                            break;
-                    }
-                    break;
-            }
-            break;
-        case 'd':
-            switch (lexeme[startIdx + 1]) {
-                case 'o':
-                    if (lexeme[startIdx + 2] == '\0') {
-                            return create_token(NW_DO, "DO", line_number); // "do"
-                    }
-                    break;
-                case 'e':
-                    if (lexeme[startIdx + 2] == 'f' && lexeme[startIdx + 3] == 'a' &&
-                        lexeme[startIdx + 4] == 'u' && lexeme[startIdx + 5] == 'l' &&
-                        lexeme[startIdx + 6] == 't' && lexeme[startIdx + 7] == '\0') {
-                            return create_token(KW_DEFAULT, "DEFAULT", line_number); // "default"
-                    }
-                    break;
-                case 'i':
-                    if (lexeme[startIdx + 2] == 's' && lexeme[startIdx + 3] == 'p' &&
-                        lexeme[startIdx + 4] == 'l' && lexeme[startIdx + 5] == 'a' &&
-                        lexeme[startIdx + 6] == 'y' && lexeme[startIdx + 7] == '\0') {
-                            return create_token(KW_DISPLAY, "DISPLAY", line_number); // "display"
-                    }
-                    break;
-            }
-            break;
-        
-        case 'e':
-            switch (lexeme[startIdx + 1]) {
-                case 'l':
-                    if (lexeme[startIdx + 2] == 's' && lexeme[startIdx + 3] == 'e' &&
-                        lexeme[startIdx + 4] == '\0') {
-                            return create_token(KW_ELSE, "ELSE", line_number); // "else"
-                    }
-                    break;
-                case 'n':
-                    if (lexeme[startIdx + 2] == 'd' && lexeme[startIdx + 3] == '\0') {
-                    return create_token(NW_END, "END", line_number);// "end"
-                }
-                break;
-            }
-            break;
-        case 'f':
-            switch (lexeme[startIdx + 1]) {
-                case 'o':
-                    if (lexeme[startIdx + 2] == 'r' && lexeme[startIdx + 3] == '\0') {
-                        return create_token(KW_FOR, "FOR", line_number); // "for"
-                    }
-                    break;
-                case 'l':
-                    if (lexeme[startIdx + 2] == 'o' && lexeme[startIdx + 3] == 'a' && lexeme[startIdx + 4] == 't' && lexeme[startIdx + 5] == '\0') {
-                        return create_token(TYPE_FLOAT, "FLOAT", line_number); // "float"
-                    }
-                    break;
-                case 'a':
-                    if (lexeme[startIdx + 2] == 'l' && lexeme[startIdx + 3] == 's' && lexeme[startIdx + 4] == 'e' && lexeme[startIdx + 5] == '\0') {
-                        return create_token(BOOL_CONST, "FALSE", line_number); // "false"
-                    }
-                    break;
-            }
-            break;
-        case 'i':
-            switch (lexeme[startIdx + 1]) {
-                case 'f':
-                    if (lexeme[startIdx + 2] == '\0') {
-                        return create_token(KW_IF, "IF", line_number); // "if"
-                    }
-                    break;
-                case 'n':
-                    switch (lexeme[startIdx + 2]) {
-                        case 't':
-                            if (lexeme[startIdx + 3] == 'e' && lexeme[startIdx + 4] == 'g' &&
-                                lexeme[startIdx + 5] == 'e' && lexeme[startIdx + 6] == 'r' && lexeme[startIdx + 7] == '\0') {
-                                return create_token(TYPE_INTEGER, "INTEGER", line_number); // "integer"
-                            }
-                            break;
-                        case 'p':
-                            if (lexeme[startIdx + 3] == 'u' && lexeme[startIdx + 4] == 't' &&
-                                lexeme[startIdx + 5] == '\0') {
-                                return create_token(KW_INPUT, "INPUT", line_number); // "input"
-                            }
-                            break;
-                    }
-                    
-            }
-            break;
-        
-        case 'l':
-            switch (lexeme[startIdx + 1]) {
-                case 'e':
-                    if (lexeme[startIdx + 2] == 't' && lexeme[startIdx + 3] == '\0') {
-                            return create_token(NW_LET, "LET", line_number);// "let"
-                    }
-                    break;
-            }
-            break;
-        
-        case 'm':
-            switch (lexeme[startIdx + 1]) {
-                case 'a':
-                    if (lexeme[startIdx + 2] == 'i' && lexeme[startIdx + 3] == 'n' &&
-                        lexeme[startIdx + 4] == '\0') {
-                            return create_token(KW_MAIN, "MAIN", line_number); // "main"
-                    }
-                    break;
-            }
-            break;
-
-        case 'n':
-            switch (lexeme[startIdx + 1]) {
-                case 'u':
-                    if (lexeme[startIdx + 2] == 'l' && lexeme[startIdx + 3] == 'l' &&
-                        lexeme[startIdx + 4] == '\0') {
-                            return create_token(RW_NULL, "NULL", line_number); // "null"
-                    }
-                    break;
-            }
-            break;
-        
-        case 'r':
-            switch (lexeme[startIdx + 1]) {
-                case 'e':
-                    if (lexeme[startIdx + 2] == 't' && lexeme[startIdx + 3] == 'u' &&
-                        lexeme[startIdx + 4] == 'r' && lexeme[startIdx + 5] == 'n' &&
-                        lexeme[startIdx + 6] == '\0') {
-                            return create_token(KW_RETURN, "RETURN", line_number); // "return"
-                    }
-                    break;
-            }
-            break;
-        
-        case 's':
-            switch (lexeme[startIdx + 1]) {
-                case 't':
-                    if (lexeme[startIdx + 2] == 'r' && lexeme[startIdx + 3] == 'i' &&
-                        lexeme[startIdx + 4] == 'n' && lexeme[startIdx + 5] == 'g' &&
-                        lexeme[startIdx + 6] == '\0') {
-                            return create_token(TYPE_STRING, "STRING", line_number); // "string"
-                    }
-                    break;
-            }
-            break;
-        case 't':
-            switch (lexeme[startIdx + 1]) {
-                case 'h':
-                    if (lexeme[startIdx + 2] == 'e' && lexeme[startIdx + 3] == 'n' &&
-                        lexeme[startIdx + 4] == '\0') {
-                            return create_token(NW_THEN, "THEN", line_number); // "then"
-                    }
-                    break;
-                case 'r':
-                    if (lexeme[startIdx + 2] == 'u' && lexeme[startIdx + 3] == 'e' &&
-                        lexeme[startIdx + 4] == '\0') {
-                            return create_token(BOOL_CONST, "TRUE", line_number); // "true"
-                    }
-                    break;
-            }
-            break;
-        
-        case 'v':
-            switch (lexeme[startIdx + 1]) {
-                case 'o':
-                    if (lexeme[startIdx + 2] == 'i' && lexeme[startIdx + 3] == 'd' &&
-                        lexeme[startIdx + 4] == '\0') {
-                            return create_token(RW_VOID, "VOID", line_number);// "void"
-                    }
-                    break;
-            }
-            break;
-        case 'w':
-            switch (lexeme[startIdx + 1]) {
-                case 'h':
-                    if (lexeme[startIdx + 2] == 'i' && lexeme[startIdx + 3] == 'l' &&
-                        lexeme[startIdx + 4] == 'e' &&  lexeme[startIdx + 5] == '\0') {
-                            return create_token(KW_WHILE, "WHILE", line_number); // "while"
-                    }
-                    break;
-            }
-            break;
-        default: 
-            break;
-    }
-    // If no keyword is matched, classify as an identifier
-    return create_token(IDENTIFIER, lexeme, line_number);
-}
-
-
-Token *classify_operator(const char *source, int *index) {
-    char current = source[*index];
-    char next = source[*index + 1];
-    (*index)++;
-
-    switch (current) {
-        // Relational Operators
-        case '<':
-            if (next == '=') {
-                (*index)++;
-                return create_token(REL_LE, "<=", line_number);
-            }
-            return create_token(REL_LT, "<", line_number);
-
-        case '>':
-            if (next == '=') {
-                (*index)++;
-                return create_token(REL_GE, ">=", line_number);
-            }
-            return create_token(REL_GT, ">", line_number);
-
-        case '=':
-            if (next == '=') {
-                (*index)++;
-                return create_token(REL_EQ, "==", line_number);
-            }
-            return create_token(ASSIGN_OP, "=", line_number);
-
-        case '!':
-            if (next == '=') {
-                (*index)++;
-                return create_token(REL_NEQ, "!=", line_number);
-            }
-            return create_token(LOG_NOT, "!", line_number);
-
-        // Logical Operators
-        case '&':
-            if (next == '&') {
-                (*index)++;
-                return create_token(LOG_AND, "&&", line_number);
-            }
-            break;
-
-        case '|':
-            if (next == '|') {
-                (*index)++;
-                return create_token(LOG_OR, "||", line_number);
-            }
-            break;
-
-        // Arithmetic Operators and Unary Operators
-        case '+':
-            if (next == '=') {
-                (*index)++;
-                return create_token(ADD_ASSIGN, "+=", line_number);
-            }
-            if (next == '+') {
-                (*index)++;
-                return create_token(UNARY_INC, "++", line_number);
-            }
-            return create_token(ADD_OP, "+", line_number);
-
-        case '-':
-            if (next == '=') {
-                (*index)++;
-                return create_token(SUB_ASSIGN, "-=", line_number);
-            }
-            if (next == '-') {
-                (*index)++;
-                return create_token(UNARY_DEC, "--", line_number);
-            }
-            return create_token(SUB_OP, "-", line_number);
-
-        case '*':
-            if (next == '=') {
-                (*index)++;
-                return create_token(MUL_ASSIGN, "*=", line_number);
-            }
-            return create_token(MUL_OP, "*", line_number);
-
-        case '/':
-            if (next == '=') {
-                (*index)++;
-                return create_token(DIV_ASSIGN, "/=", line_number);
-            }
-            return create_token(DIV_OP, "/", line_number);
-
-        case '$':
-            if (next == '=') {
-                (*index)++;
-                return create_token(INTDIV_ASSIGN, "$=", line_number);
-            }
-            return create_token(INTDIV_OP, "$", line_number);
-
-        case '%':
-            if (next == '=') {
-                (*index)++;
-                return create_token(MOD_ASSIGN, "%=", line_number);
-            }
-            return create_token(MOD_OP, "%", line_number);
-
-        case '^':
-            return create_token(EXPO_OP, "^", line_number);
-
-        // Default case for unknown operators
-        default: {
-            char unknown[2] = {current, '\0'};
-            return create_token(TOKEN_UNKNOWN, unknown, line_number);
-        }
-    }
-
-    return NULL;
-}
-
-
-Token *classify_delimiter(char c, size_t line_number) {
-    switch (c) {
-        case ',': return create_token(COMMA, ",", line_number);
-        case ';': return create_token(SEMICOLON, ";", line_number);
-
-        // Parentheses
-        case '(': return create_token(LEFT_PAREN, "(", line_number);
-        case ')': return create_token(RIGHT_PAREN, ")", line_number);
-
-        // Braces
-        case '{': return create_token(LEFT_CURLY, "{", line_number);
-        case '}': return create_token(RIGHT_CURLY, "}", line_number);
-
-        // Brackets
-        case '[': return create_token(LEFT_BRACKET, "[", line_number);
-        case ']': return create_token(RIGHT_BRACKET, "]", line_number);
-
-        // Default case for unknown delimiters
-        default: {
-            char unknown[2] = {c, '\0'};
-            return create_token(TOKEN_UNKNOWN, unknown, line_number);
-        }
-    }
-}
-
-
-Token **tokenize(const char *source, size_t *token_count) {
-    size_t capacity = 10;
-    Token **tokens = malloc(capacity * sizeof(Token *));
-    *token_count = 0;
-    int index = 0;
-    int length = strlen(source);
-
-    while (index < length) {
-        char c = source[index];
-
-        // Skip white spaces and track line numbers
-        if (isspace(c)) {
-            if (c == '\n') line_number++;
-            index++;
-            continue;
-        }
-
-        Token *token = NULL;
-
-        // Comments
-        if (source[index] == '~') {
-            token = classify_comment(source, &index);
-        }
-        // Numbers
-        else if (isdigit(c)) {
-            token = classify_number(source, &index);
-        }
-        // Keywords or Identifiers
-        else if (isalpha(c) || c == '_') {
-            char buffer[64] = {0};
-            int buffer_index = 0;
-            int is_flagged = 0;
-
-            while (isalnum(source[index]) || ispunct(source[index])) {
-                if (source[index] == '_'){
-                } else if (strchr("@#.`?", source[index])) {
-                    is_flagged++;
-                } else if (ispunct(source[index]) && !strchr("@#.`?", source[index])) {
-                    break;
-                }
-                                
-                buffer[buffer_index++] = source[index++];
-            }
-
-            if (is_flagged){
-                fprintf(stderr, "Error: Invalid token '%s' at line %zu\n", buffer, line_number);
-                token = create_token(TOKEN_INVALID, buffer, line_number);
-            
-            } else {
-                token = classify_word(buffer); // Classify if string is keyword, reserved word, or noise word
-            }
-        }
-        // Operators
-        else if (strchr("+-*/=$%^<>!&|", c)) { 
-            token = classify_operator(source, &index);
-        }
-        // Delimiters
-        else if (strchr(";{},()[]", c)) {
-            token = classify_delimiter(c, line_number);
-            index++; 
-        }
-        else if (c == '"') { // Detect the start of a string
-            token = classify_string(source, &index);
-        }
-        else if (source[index] == '\'') { // Detect the start of a character
-            token = classify_character(source, &index);
-        }
-        // Handle unrecognized characters
-        else if (ispunct(source[index])) {
-            token = classify_operator(source, &index);
-            fprintf(stderr, "Error: Unrecognized character '%c' at line %zu\n", c, line_number);
-        }
-
-        // Store token
-        if (token) {
-            if (*token_count == capacity) {
-                capacity *= 2;
-                tokens = realloc(tokens, capacity * sizeof(Token *));
-            }
-            tokens[(*token_count)++] = token;
-        }
-    }
-
-    return tokens;
-}
-
-Token **lexer(FILE *file, size_t *token_count) {
-    fseek(file, 0, SEEK_END);
-    long file_size = ftell(file);
-    rewind(file);
-
-    char *buffer = malloc(file_size + 1);
-    fread(buffer, 1, file_size, file);
-    buffer[file_size] = '\0';
-
-    Token **tokens = tokenize(buffer, token_count);
-    free(buffer);
-
-    return tokens;
-}
\ No newline at end of file
+#define _POSIX_C_SOURCE 200809L
+#include "lexers.h"
+#include "scanner_dfa.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define LEXER_X86_KERNELS
+#endif
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Skips a ScanRun from `index` 16 or 32 bytes at a time and returns the
+// index of the first byte that may end it, adding the '\n's passed to
+// *lines. Only whole vectors inside `length` are read; the DFA scans the
+// rest of the run one byte at a time.
+typedef size_t (*RunSkipper)(const unsigned char *bytes, size_t index, size_t length, ScanRun run, size_t *lines);
+
+// Everything one lexing run touches, so separate states can lex in parallel
+struct LexerState {
+    size_t line_number;
+    const char *source;         // Tokens are slices of this buffer
+    size_t source_length;
+    size_t scan_offset;         // Where lexer_next_token() continues
+    size_t source_mapped_size;  // Nonzero when source is mmap'd
+    TokenStream stream;         // Tokens of the last lexer_tokenize()
+    TokenSink sink;             // Optional consumer of each new token
+    void *sink_context;
+    RunSkipper skip_run;        // NULL when runs go through the DFA byte by byte
+};
+
+_Static_assert(TOKEN_EOF <= UINT8_MAX, "TokenStream stores token kinds in a byte");
+
+static int create_token(Token *token, TokenType type, size_t offset, size_t length, size_t line_num) {
+    token->type = type;
+    token->offset = offset;
+    token->length = length;
+    token->line_num = line_num;
+    token->value.integer = 0;
+    return 1;
+}
+
+// Make room for `capacity` tokens in all four arrays
+int token_stream_reserve(TokenStream *stream, size_t capacity) {
+    if (capacity <= stream->capacity) return 1;
+
+    uint8_t *kind = realloc(stream->kind, capacity * sizeof(uint8_t));
+    if (kind) stream->kind = kind;
+    uint32_t *offset = realloc(stream->offset, capacity * sizeof(uint32_t));
+    if (offset) stream->offset = offset;
+    uint32_t *length = realloc(stream->length, capacity * sizeof(uint32_t));
+    if (length) stream->length = length;
+    uint32_t *line = realloc(stream->line, capacity * sizeof(uint32_t));
+    if (line) stream->line = line;
+    if (!kind || !offset || !length || !line) return 0;
+
+    stream->capacity = capacity;
+    return 1;
+}
+
+static int stream_push(TokenStream *stream, const Token *token) {
+    if (stream->count == stream->capacity &&
+        !token_stream_reserve(stream, stream->capacity ? stream->capacity * 2 : 1024)) {
+        return 0;
+    }
+
+    size_t i = stream->count++;
+    stream->kind[i] = (uint8_t)token->type;
+    stream->offset[i] = (uint32_t)token->offset;
+    stream->length[i] = (uint32_t)token->length;
+    stream->line[i] = (uint32_t)token->line_num;
+    if (token->type == NUM_CONST || token->type == FLOAT_CONST) {
+        return token_stream_add_value(stream, i, token->value);
+    }
+    return 1;
+}
+
+void token_stream_free(TokenStream *stream) {
+    free(stream->kind);
+    free(stream->offset);
+    free(stream->length);
+    free(stream->line);
+    free(stream->literal_value);
+    free(stream->literal_index);
+    memset(stream, 0, sizeof(TokenStream));
+}
+
+int token_stream_add_value(TokenStream *stream, size_t index, TokenValue value) {
+    if (stream->literal_count == stream->literal_capacity) {
+        size_t capacity = stream->literal_capacity ? stream->literal_capacity * 2 : 256;
+        TokenValue *values = realloc(stream->literal_value, capacity * sizeof(TokenValue));
+        if (values) stream->literal_value = values;
+        uint32_t *indices = realloc(stream->literal_index, capacity * sizeof(uint32_t));
+        if (indices) stream->literal_index = indices;
+        if (!values || !indices) return 0;
+        stream->literal_capacity = capacity;
+    }
+
+    stream->literal_value[stream->literal_count] = value;
+    stream->literal_index[stream->literal_count] = (uint32_t)index;
+    stream->literal_count++;
+    return 1;
+}
+
+// Binary search of the literal table
+size_t token_stream_find_literal(const TokenStream *stream, size_t index) {
+    size_t low = 0, high = stream->literal_count;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (stream->literal_index[middle] < index) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low < stream->literal_count && stream->literal_index[low] == index ? low : stream->literal_count;
+}
+
+TokenValue token_stream_value(const TokenStream *stream, size_t index) {
+    TokenValue value = { 0 };
+    TokenType type = (TokenType)stream->kind[index];
+    if (type != NUM_CONST && type != FLOAT_CONST) return value;
+
+    size_t literal = token_stream_find_literal(stream, index);
+    if (literal < stream->literal_count) value = stream->literal_value[literal];
+    return value;
+}
+
+static const char *const TOKEN_NAMES[] = {
+#define TOKEN_NAME(type, name, spelling) name,
+    TOKEN_LIST(TOKEN_NAME)
+#undef TOKEN_NAME
+};
+
+const char* token_type_to_string(TokenType type) {
+    if ((unsigned)type > TOKEN_EOF) return "UNDEFINED";
+    return TOKEN_NAMES[type];
+}
+
+// Reverse of token_type_to_string, used when reading a symbol table back in
+TokenType token_type_from_string(const char *name) {
+    for (int type = IDENTIFIER; type <= TOKEN_EOF; type++) {
+        if (strcmp(token_type_to_string((TokenType)type), name) == 0) {
+            return (TokenType)type;
+        }
+    }
+    return TOKEN_UNKNOWN;
+}
+
+// Powers of ten a double holds exactly, for decode_number's fast path
+static const double EXACT_POWERS_OF_TEN[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+int decode_number(TokenType type, const char *text, size_t length, TokenValue *value) {
+    if (type == NUM_CONST) {
+        uint64_t result = 0;
+        for (size_t i = 0; i < length; i++) {
+            unsigned digit = (unsigned)(text[i] - '0');
+            if (result > (uint64_t)(INT64_MAX - digit) / 10) {
+                value->integer = INT64_MAX;
+                return 0;
+            }
+            result = result * 10 + digit;
+        }
+        value->integer = (int64_t)result;
+        return 1;
+    }
+
+    // Digits, '.', digits: when all of them fit a 53-bit mantissa and at
+    // most 22 follow the '.', one division by an exact power of ten
+    // rounds correctly. Anything longer goes through strtod.
+    uint64_t mantissa = 0;
+    size_t fraction_digits = 0;
+    int seen_point = 0;
+    int exact = 1;
+    for (size_t i = 0; i < length && exact; i++) {
+        if (text[i] == '.') {
+            seen_point = 1;
+            continue;
+        }
+        mantissa = mantissa * 10 + (unsigned)(text[i] - '0');
+        fraction_digits += seen_point;
+        exact = mantissa < (UINT64_C(1) << 53) && fraction_digits <= 22;
+    }
+    if (exact) {
+        value->real = (double)mantissa / EXACT_POWERS_OF_TEN[fraction_digits];
+        return 1;
+    }
+
+    char small[64];
+    char *copy = length < sizeof(small) ? small : malloc(length + 1);
+    if (!copy) {
+        value->real = 0;
+        return 1;
+    }
+    memcpy(copy, text, length);
+    copy[length] = '\0';
+    value->real = strtod(copy, NULL);
+    if (copy != small) free(copy);
+    return !isinf(value->real);
+}
+
+// The KEYWORDS slot of the `length` bytes at `word`, or -1. Only one
+// slot can hold it, so this is one hash and one memcmp.
+static inline int keyword_slot(const char *word, size_t length) {
+    if (length < KEYWORD_MIN_LENGTH || length > KEYWORD_MAX_LENGTH) return -1;
+    unsigned hash = KEYWORD_ASSO[(unsigned char)word[0]] + KEYWORD_ASSO[(unsigned char)word[length - 1]] + (unsigned)length;
+    int slot = (int)(hash % KEYWORD_SLOTS);
+    return KEYWORDS[slot].length == length && memcmp(KEYWORDS[slot].spelling, word, length) == 0 ? slot : -1;
+}
+
+// Keywords and booleans print as their upper-case spelling rather than
+// the source text; every other token prints its slice unchanged
+static const char *spelled_text(const char *source, TokenType type, size_t offset, size_t length, size_t *text_length) {
+    int slot = type == IDENTIFIER ? -1 : keyword_slot(source + offset, length);
+    if (slot >= 0 && KEYWORDS[slot].type == type) {
+        *text_length = KEYWORDS[slot].length;
+        return KEYWORDS[slot].printed;
+    }
+    *text_length = length;
+    return source + offset;
+}
+
+// Text of a token; not NUL-terminated unless it is a keyword spelling
+const char *token_text(const LexerState *state, const Token *token, size_t *length) {
+    return spelled_text(state->source, token->type, token->offset, token->length, length);
+}
+
+const char *token_stream_text(const TokenStream *stream, size_t index, size_t *length) {
+    return spelled_text(stream->source, (TokenType)stream->kind[index], stream->offset[index], stream->length[index], length);
+}
+
+static void write_token(const char *source, const Token *token, FILE *file) {
+    size_t length;
+    const char *text = spelled_text(source, token->type, token->offset, token->length, &length);
+
+    fputs("TOKEN: ", file);
+    if (token->type == TOKEN_COMMENT) {
+        // Multi-line comments are shown on one line
+        for (size_t i = 0; i < length; i++) {
+            fputc(text[i] == '\n' ? ' ' : text[i], file);
+        }
+    } else {
+        fwrite(text, 1, length, file);
+    }
+    for (size_t i = length; i < 20; i++) fputc(' ', file);
+
+    fprintf(file, " | TYPE: %-30s | LINE: %zu\n",
+            token_type_to_string(token->type),
+            token->line_num);
+}
+
+void print_token(const LexerState *state, const Token *token) {
+    write_token(state->source, token, stdout);
+}
+
+void write_to_symbol_table(const LexerState *state, const Token *token, FILE *symbol_table_file) {
+    write_token(state->source, token, symbol_table_file);
+}
+
+// Every token of the stream, one line each, in print_token()'s format
+void write_token_stream(const TokenStream *stream, FILE *file) {
+    for (size_t i = 0; i < stream->count; i++) {
+        Token token = token_stream_at(stream, i);
+        write_token(stream->source, &token, file);
+    }
+}
+
+#ifdef LEXER_X86_KERNELS
+// Bit i of the result is set when byte i of `chunk` may end the run.
+// The bytes are those for which run_continues() in gen_scanner is false.
+static inline int run_stops_sse2(__m128i chunk, ScanRun run) {
+    __m128i stops = _mm_cmpeq_epi8(chunk, _mm_setzero_si128());
+    switch (run) {
+        case SCAN_RUN_SPACE: {
+            // ' ' or '\t'..'\r'; everything else stops
+            __m128i control = _mm_subs_epu8(_mm_sub_epi8(chunk, _mm_set1_epi8('\t')), _mm_set1_epi8('\r' - '\t'));
+            __m128i space = _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(' ')),
+                                         _mm_cmpeq_epi8(control, _mm_setzero_si128()));
+            return ~_mm_movemask_epi8(space) & 0xFFFF;
+        }
+        case SCAN_RUN_LINE_COMMENT:
+            stops = _mm_or_si128(stops, _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n')));
+            break;
+        case SCAN_RUN_BLOCK_COMMENT:
+            stops = _mm_or_si128(stops, _mm_cmpeq_epi8(chunk, _mm_set1_epi8('^')));
+            break;
+        case SCAN_RUN_STRING:
+            stops = _mm_or_si128(stops, _mm_cmpeq_epi8(chunk, _mm_set1_epi8('"')));
+            stops = _mm_or_si128(stops, _mm_cmpeq_epi8(chunk, _mm_set1_epi8('%')));
+            break;
+        default:
+            return 0xFFFF;
+    }
+    return _mm_movemask_epi8(stops);
+}
+
+static size_t skip_run_sse2(const unsigned char *bytes, size_t index, size_t length, ScanRun run, size_t *lines) {
+    const __m128i newline = _mm_set1_epi8('\n');
+    for (; index + 16 <= length; index += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)(bytes + index));
+        unsigned stops = run_stops_sse2(chunk, run);
+        unsigned newlines = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline));
+        if (stops) {
+            unsigned offset = __builtin_ctz(stops);
+            *lines += __builtin_popcount(newlines & ((1u << offset) - 1));
+            return index + offset;
+        }
+        *lines += __builtin_popcount(newlines);
+    }
+    return index;
+}
+
+__attribute__((target("avx2,popcnt,bmi")))
+static inline unsigned run_stops_avx2(__m256i chunk, ScanRun run) {
+    __m256i stops = _mm256_cmpeq_epi8(chunk, _mm256_setzero_si256());
+    switch (run) {
+        case SCAN_RUN_SPACE: {
+            __m256i control = _mm256_subs_epu8(_mm256_sub_epi8(chunk, _mm256_set1_epi8('\t')), _mm256_set1_epi8('\r' - '\t'));
+            __m256i space = _mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(' ')),
+                                            _mm256_cmpeq_epi8(control, _mm256_setzero_si256()));
+            return ~(unsigned)_mm256_movemask_epi8(space);
+        }
+        case SCAN_RUN_LINE_COMMENT:
+            stops = _mm256_or_si256(stops, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\n')));
+            break;
+        case SCAN_RUN_BLOCK_COMMENT:
+            stops = _mm256_or_si256(stops, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('^')));
+            break;
+        case SCAN_RUN_STRING:
+            stops = _mm256_or_si256(stops, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('"')));
+            stops = _mm256_or_si256(stops, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('%')));
+            break;
+        default:
+            return ~0u;
+    }
+    return (unsigned)_mm256_movemask_epi8(stops);
+}
+
+__attribute__((target("avx2,popcnt,bmi")))
+static size_t skip_run_avx2(const unsigned char *bytes, size_t index, size_t length, ScanRun run, size_t *lines) {
+    const __m256i newline = _mm256_set1_epi8('\n');
+    for (; index + 32 <= length; index += 32) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i *)(bytes + index));
+        unsigned stops = run_stops_avx2(chunk, run);
+        unsigned newlines = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, newline));
+        if (stops) {
+            unsigned offset = __builtin_ctz(stops);
+            *lines += __builtin_popcount(offset ? newlines << (32 - offset) : 0);
+            return index + offset;
+        }
+        *lines += __builtin_popcount(newlines);
+    }
+    // Finish with at most one 16-byte step before handing back to the DFA
+    return skip_run_sse2(bytes, index, length, run, lines);
+}
+#endif
+
+// Pick the widest kernel the CPU runs. CTY_SIMD=scalar|sse2|avx2 caps
+// the choice, e.g. to compare them with tools/bench_lexer.
+static RunSkipper choose_run_skipper(void) {
+    const char *limit = getenv("CTY_SIMD");
+    if (limit && strcmp(limit, "scalar") == 0) return NULL;
+#ifdef LEXER_X86_KERNELS
+    if (!(limit && strcmp(limit, "sse2") == 0) && __builtin_cpu_supports("avx2")) return skip_run_avx2;
+    return skip_run_sse2;
+#else
+    return NULL;
+#endif
+}
+
+LexerState *lexer_create(void) {
+    LexerState *state = calloc(1, sizeof(LexerState));
+    if (state) {
+        state->line_number = 1;
+        state->skip_run = choose_run_skipper();
+    }
+    return state;
+}
+
+// Drop the tokens and source buffer of the last run
+static void release_stream(LexerState *state) {
+    token_stream_free(&state->stream);
+#ifndef _WIN32
+    if (state->source_mapped_size) {
+        munmap((void *)state->source, state->source_mapped_size);
+    } else {
+        free((void *)state->source);
+    }
+#else
+    free((void *)state->source);
+#endif
+    state->source = NULL;
+    state->source_length = 0;
+    state->scan_offset = 0;
+    state->source_mapped_size = 0;
+    state->line_number = 1;
+}
+
+void lexer_set_sink(LexerState *state, TokenSink sink, void *context) {
+    state->sink = sink;
+    state->sink_context = context;
+}
+
+void lexer_destroy(LexerState *state) {
+    if (!state) return;
+    release_stream(state);
+    free(state);
+}
+
+// A word is a keyword, reserved word, noise word or boolean if
+// KEYWORD_LIST spells it, and an identifier otherwise
+static TokenType classify_word(const char *word, size_t length) {
+    int slot = keyword_slot(word, length);
+    return slot >= 0 ? (TokenType)KEYWORDS[slot].type : IDENTIFIER;
+}
+
+// Scan from *position to the end of the next token: one SCAN_NEXT lookup
+// per byte until the DFA stops, then act on the state it stopped in.
+// `source` holds `length` bytes followed by at least one '\0', on which
+// every state stops. Entering a run state hands the run to skip_run.
+// Returns 0 at the end of the input.
+static int scan_token(LexerState *state, const char *source, size_t length, size_t *position, Token *token) {
+    const unsigned char *bytes = (const unsigned char *)source;
+    RunSkipper skip_run = state->skip_run;
+    size_t index = *position;
+    size_t line = state->line_number;
+    int found = 0;
+
+    while (!found && index < length) {
+        size_t start = index;
+        size_t start_line = line;
+        unsigned scan_state = SCAN_START;
+        unsigned next;
+
+        while ((next = SCAN_NEXT[scan_state][bytes[index]]) != SCAN_STOP) {
+            scan_state = next;
+            index++;
+            if (scan_state >= SCAN_FIRST_RUN_STATE) {
+                line += scan_state >= SCAN_FIRST_NEWLINE_STATE;
+                // Single spaces between tokens are not worth a kernel call
+                if (skip_run && SCAN_NEXT[scan_state][bytes[index]] >= SCAN_FIRST_RUN_STATE) {
+                    index = skip_run(bytes, index, length, (ScanRun)SCAN_RUN[scan_state], &line);
+                }
+            }
+        }
+        state->line_number = line;
+
+        TokenType type = (TokenType)SCAN_TYPE[scan_state];
+        size_t length = index - start;
+        switch ((ScanAction)SCAN_ACTION[scan_state]) {
+            case SCAN_END:
+                *position = index;
+                return 0;
+
+            case SCAN_SKIP:
+                break;
+
+            case SCAN_TOKEN:
+                found = create_token(token, type, start, length, line);
+                break;
+
+            case SCAN_INTEGER:
+                found = create_token(token, type, start, length, line);
+                if (!decode_number(type, source + start, length, &token->value)) {
+                    fprintf(stderr, "Error: Integer constant '%.*s' is out of range at line %zu\n", (int)length, source + start, line);
+                }
+                break;
+
+            case SCAN_REAL:
+                found = create_token(token, type, start, length, line);
+                if (!decode_number(type, source + start, length, &token->value)) {
+                    fprintf(stderr, "Error: Float constant '%.*s' is out of range at line %zu\n", (int)length, source + start, line);
+                }
+                break;
+
+            case SCAN_WORD:
+                found = create_token(token, classify_word(source + start, length), start, length, line);
+                break;
+
+            case SCAN_INVALID:
+                fprintf(stderr, "Error: Invalid token '%.*s' at line %zu\n", (int)length, source + start, line);
+                found = create_token(token, TOKEN_INVALID, start, length, line);
+                break;
+
+            case SCAN_STRING:
+                found = create_token(token, type, start + 1, length - 2, line);
+                break;
+
+            case SCAN_OPEN_STRING:
+                fprintf(stderr, "Error: Unterminated string at line %zu\n", line);
+                found = create_token(token, type, start + 1, length - 1, line);
+                break;
+
+            case SCAN_CHAR:
+                found = create_token(token, CHAR_CONST, start + 1, 1, line);
+                break;
+
+            case SCAN_EMPTY_CHAR:
+                fprintf(stderr, "Error: Invalid or empty character at line %zu\n", line);
+                break;
+
+            case SCAN_LONG_CHAR:
+            case SCAN_CLOSED_LONG_CHAR:
+                fprintf(stderr, "Error: Too many characters in character constant at line %zu\n", line);
+                length -= SCAN_ACTION[scan_state] == SCAN_CLOSED_LONG_CHAR ? 2 : 1;
+                found = create_token(token, TOKEN_INVALID, start + 1, length, line);
+                break;
+
+            case SCAN_LINE_COMMENT:
+                found = create_token(token, TOKEN_COMMENT, start + 2, length - 2, line);
+                break;
+
+            case SCAN_BLOCK_COMMENT:
+                found = create_token(token, TOKEN_COMMENT, start + 2, length - 4, start_line);
+                break;
+
+            case SCAN_OPEN_BLOCK_COMMENT:
+                printf("Warning: Unterminated multi-line comment at line %zu\n", line);
+                found = create_token(token, TOKEN_COMMENT, start + 2, length - 2, start_line);
+                break;
+
+            case SCAN_UNRECOGNIZED:
+                found = create_token(token, TOKEN_UNKNOWN, start, 1, line);
+                fprintf(stderr, "Error: Unrecognized character '%c' at line %zu\n", source[start], line);
+                break;
+        }
+    }
+
+    *position = index;
+    return found;
+}
+
+// Lex the whole source into state->stream
+static int tokenize(LexerState *state, const char *source, size_t length) {
+    TokenStream *stream = &state->stream;
+    stream->count = 0;
+    stream->literal_count = 0;
+    stream->source = source;
+    size_t index = 0;
+
+    Token token;
+    while (scan_token(state, source, length, &index, &token)) {
+        if (!stream_push(stream, &token)) return 0;
+        if (state->sink) state->sink(state->sink_context, &token);
+    }
+    return 1;
+}
+
+// Read the rest of a stream into one buffer; works for pipes and stdin
+static char *read_stream(FILE *file, size_t *length) {
+    size_t capacity = 1 << 16;
+    size_t used = 0;
+    char *buffer = malloc(capacity);
+    if (!buffer) return NULL;
+
+    size_t read;
+    while ((read = fread(buffer + used, 1, capacity - used - 1, file)) > 0) {
+        used += read;
+        if (capacity - used == 1) {
+            capacity *= 2;
+            char *grown = realloc(buffer, capacity);
+            if (!grown) {
+                free(buffer);
+                return NULL;
+            }
+            buffer = grown;
+        }
+    }
+
+    buffer[used] = '\0';
+    *length = used;
+    return buffer;
+}
+
+// Take ownership of a source buffer; tokenize() runs on it later
+static void set_source(LexerState *state, const char *source, size_t length, size_t mapped_size) {
+    state->source = source;
+    state->source_length = length;
+    state->source_mapped_size = mapped_size;
+}
+
+// Token offsets are 32-bit, so larger sources are refused
+static int check_source_size(LexerState *state) {
+    if (state->source_length <= UINT32_MAX) return 1;
+    fprintf(stderr, "Error: sources of 4 GiB or more are not supported\n");
+    release_stream(state);
+    return 0;
+}
+
+// Read an already open stream into the state
+static int load_stream(LexerState *state, FILE *file) {
+    size_t length = 0;
+    char *buffer = read_stream(file, &length);
+    if (!buffer) return 0;
+    set_source(state, buffer, length, 0);
+    return check_source_size(state);
+}
+
+// Load the file at `path`, or standard input when it is "-". Regular files
+// are mapped read-only instead of copied; anything else is streamed.
+int lexer_load(LexerState *state, const char *path) {
+    release_stream(state);
+    if (strcmp(path, "-") == 0) return load_stream(state, stdin);
+
+#ifndef _WIN32
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return 0;
+
+    struct stat info;
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+        size_t length = (size_t)info.st_size;
+        long page_size = sysconf(_SC_PAGESIZE);
+
+        // The tail of the last page reads as zeros, which gives tokenize() its
+        // terminating '\0'. A file filling whole pages has no such tail.
+        if (length % (size_t)page_size != 0) {
+            char *mapped = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            close(fd);
+            if (mapped == MAP_FAILED) return 0;
+
+            posix_madvise(mapped, length, POSIX_MADV_SEQUENTIAL);
+            set_source(state, mapped, length, length);
+            return check_source_size(state);
+        }
+    }
+    close(fd);
+#endif
+
+    FILE *file = fopen(path, "rb");
+    if (!file) return 0;
+    int loaded = load_stream(state, file);
+    fclose(file);
+    return loaded;
+}
+
+// Tokenize the source loaded by lexer_load()
+const TokenStream *lexer_tokenize(LexerState *state) {
+    if (!state->source) return NULL;
+    state->line_number = 1;
+
+    // Sources average a token every 3 to 7 bytes; start near that
+    token_stream_reserve(&state->stream, state->source_length / 4 + 16);
+    return tokenize(state, state->source, state->source_length) ? &state->stream : NULL;
+}
+
+// Pull the next token of the loaded source into *token; 0 at the end.
+// The token is not kept, so memory stays flat however long the input.
+int lexer_next_token(LexerState *state, Token *token) {
+    if (!state->source) return 0;
+
+    int found = scan_token(state, state->source, state->source_length, &state->scan_offset, token);
+    if (found && state->sink) state->sink(state->sink_context, token);
+    return found;
+}
+
+const char *lexer_source(const LexerState *state) {
+    return state->source;
+}
+
+// Lex an already open stream
+const TokenStream *lexer_lex_stream(LexerState *state, FILE *file) {
+    release_stream(state);
+    if (!load_stream(state, file)) return NULL;
+    return lexer_tokenize(state);
+}
+
+const TokenStream *lexer_lex(LexerState *state, const char *path) {
+    if (!lexer_load(state, path)) return NULL;
+    return lexer_tokenize(state);
+}
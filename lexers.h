@@ -1,104 +1,235 @@
-#ifndef LEXER_H_
-#define LEXER_H_
-
-#include <stddef.h>
-#include <stdio.h>  // Add this line to include the FILE type
-
-typedef enum {
-    IDENTIFIER,
-    NUM_CONST,
-    BOOL_CONST,
-    CHAR_CONST,
-    FLOAT_CONST,
-    STR_CONST,
-    STR_WITH_FORMAT,
-
-    FORMAT_INT,
-    FORMAT_CHAR,
-    FORMAT_FLOAT,
-    FORMAT_STR,
-
-    ADD_OP,
-    SUB_OP,
-    MUL_OP,
-    DIV_OP,
-    INTDIV_OP,
-    MOD_OP,
-    EXPO_OP,
-
-    REL_LT,
-    REL_GT,
-    REL_LE,
-    REL_GE,
-    REL_EQ,
-    REL_NEQ,
-
-    LOG_AND,
-    LOG_OR,
-    LOG_NOT,
-
-    UNARY_INC,
-    UNARY_DEC,
-
-    ASSIGN_OP,
-    ADD_ASSIGN,
-    SUB_ASSIGN,
-    MUL_ASSIGN,
-    DIV_ASSIGN,
-    INTDIV_ASSIGN,
-    MOD_ASSIGN,
-
-    COMMA,
-    SEMICOLON,
-
-    LEFT_CURLY,
-    RIGHT_CURLY,
-    LEFT_PAREN,
-    RIGHT_PAREN,
-    LEFT_BRACKET,
-    RIGHT_BRACKET,
-
-    KW_BREAK,
-    KW_CONTINUE,
-    KW_DEFAULT,
-    KW_DISPLAY,
-    KW_ELSE,
-    KW_FOR,
-    KW_IF,
-    KW_INPUT,
-    KW_MAIN,
-    KW_RETURN,
-    KW_WHILE,
-
-    TYPE_BOOLEAN,
-    TYPE_CHARACTER,
-    TYPE_FLOAT,
-    TYPE_INTEGER,
-    TYPE_STRING,
-
-    RW_CONSTANT,
-    RW_NULL,
-    RW_VOID,
-
-    NW_DO,
-    NW_END,
-    NW_LET,
-    NW_THEN,
-    
-    TOKEN_COMMENT,
-    TOKEN_UNKNOWN,
-    TOKEN_INVALID,
-    TOKEN_EOF
-} TokenType;
-
-typedef struct {
-    TokenType type;
-    char *value;
-    size_t line_num;
-} Token;
-
-void print_token(const Token *token);
-Token **lexer(FILE *file, size_t *token_count);
-void write_to_symbol_table(const Token *token, FILE *symbol_table_file);
-
+#ifndef LEXER_H_
+#define LEXER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>  // Add this line to include the FILE type
+
+// The token set, described once. Each entry gives the TokenType, the
+// name token_type_to_string() prints, and the fixed spelling the scanner
+// matches. Entries without a spelling are keywords (see KEYWORD_LIST),
+// are scanned by the hand-written rules in tools/gen_scanner.c (words,
+// numbers, strings, characters and comments) or are never produced by
+// the lexer. After changing either list, run tools/gen_scanner to
+// regenerate scanner_dfa.h.
+#define TOKEN_LIST(X) \
+    X(IDENTIFIER,      "IDENTIFIER",      NULL) \
+    X(NUM_CONST,       "NUM_CONST",       NULL) \
+    X(BOOL_CONST,      "BOOLEAN",         NULL) \
+    X(CHAR_CONST,      "CHAR_CONST",      NULL) \
+    X(FLOAT_CONST,     "FLOAT_CONST",     NULL) \
+    X(STR_CONST,       "STR_CONST",       NULL) \
+    X(STR_WITH_FORMAT, "STR_WITH_FORMAT", NULL) \
+    \
+    X(FORMAT_INT,      "FORMAT_INT",      NULL) \
+    X(FORMAT_CHAR,     "FORMAT_CHAR",     NULL) \
+    X(FORMAT_FLOAT,    "FORMAT_FLOAT",    NULL) \
+    X(FORMAT_STR,      "FORMAT_STR",      NULL) \
+    \
+    X(ADD_OP,          "ADD_OP",          "+") \
+    X(SUB_OP,          "SUB_OP",          "-") \
+    X(MUL_OP,          "MUL_OP",          "*") \
+    X(DIV_OP,          "DIV_OP",          "/") \
+    X(INTDIV_OP,       "INTDIV_OP",       "$") \
+    X(MOD_OP,          "MOD_OP",          "%") \
+    X(EXPO_OP,         "EXPO_OP",         "^") \
+    \
+    X(REL_LT,          "REL_LT",          "<") \
+    X(REL_GT,          "REL_GT",          ">") \
+    X(REL_LE,          "REL_LE",          "<=") \
+    X(REL_GE,          "REL_GE",          ">=") \
+    X(REL_EQ,          "REL_EQ",          "==") \
+    X(REL_NEQ,         "REL_NEQ",         "!=") \
+    \
+    X(LOG_AND,         "LOG_AND",         "&&") \
+    X(LOG_OR,          "LOG_OR",          "||") \
+    X(LOG_NOT,         "LOG_NOT",         "!") \
+    \
+    X(UNARY_INC,       "UNARY_INC",       "++") \
+    X(UNARY_DEC,       "UNARY_DEC",       "--") \
+    \
+    X(ASSIGN_OP,       "ASSIGN_OP",       "=") \
+    X(ADD_ASSIGN,      "ADD_ASSIGN",      "+=") \
+    X(SUB_ASSIGN,      "SUB_ASSIGN",      "-=") \
+    X(MUL_ASSIGN,      "MUL_ASSIGN",      "*=") \
+    X(DIV_ASSIGN,      "DIV_ASSIGN",      "/=") \
+    X(INTDIV_ASSIGN,   "INTDIV_ASSIGN",   "$=") \
+    X(MOD_ASSIGN,      "MOD_ASSIGN",      "%=") \
+    \
+    X(COMMA,           "COMMA",           ",") \
+    X(SEMICOLON,       "SEMICOLON",       ";") \
+    \
+    X(LEFT_CURLY,      "LEFT_CURLY",      "{") \
+    X(RIGHT_CURLY,     "RIGHT_CURLY",     "}") \
+    X(LEFT_PAREN,      "LEFT_PAREN",      "(") \
+    X(RIGHT_PAREN,     "RIGHT_PAREN",     ")") \
+    X(LEFT_BRACKET,    "LEFT_BRACKET",    "[") \
+    X(RIGHT_BRACKET,   "RIGHT_BRACKET",   "]") \
+    \
+    X(KW_BREAK,        "KW_BREAK",        NULL) \
+    X(KW_CONTINUE,     "KW_CONTINUE",     NULL) \
+    X(KW_DEFAULT,      "KW_DEFAULT",      NULL) \
+    X(KW_DISPLAY,      "KW_DISPLAY",      NULL) \
+    X(KW_ELSE,         "KW_ELSE",         NULL) \
+    X(KW_FOR,          "KW_FOR",          NULL) \
+    X(KW_IF,           "KW_IF",           NULL) \
+    X(KW_INPUT,        "KW_INPUT",        NULL) \
+    X(KW_MAIN,         "KW_MAIN",         NULL) \
+    X(KW_RETURN,       "KW_RETURN",       NULL) \
+    X(KW_WHILE,        "KW_WHILE",        NULL) \
+    \
+    X(TYPE_BOOLEAN,    "TYPE_BOOLEAN",    NULL) \
+    X(TYPE_CHARACTER,  "TYPE_CHARACTER",  NULL) \
+    X(TYPE_FLOAT,      "TYPE_FLOAT",      NULL) \
+    X(TYPE_INTEGER,    "TYPE_INTEGER",    NULL) \
+    X(TYPE_STRING,     "TYPE_STRING",     NULL) \
+    \
+    X(RW_CONSTANT,     "RW_CONSTANT",     NULL) \
+    X(RW_NULL,         "RW_NULL",         NULL) \
+    X(RW_VOID,         "RW_VOID",         NULL) \
+    \
+    X(NW_DO,           "NW_DO",           NULL) \
+    X(NW_END,          "NW_END",          NULL) \
+    X(NW_LET,          "NW_LET",          NULL) \
+    X(NW_THEN,         "NW_THEN",         NULL) \
+    \
+    X(TOKEN_COMMENT,   "COMMENT",         NULL) \
+    X(TOKEN_UNKNOWN,   "UNKNOWN",         NULL) \
+    X(TOKEN_INVALID,   "INVALID",         NULL) \
+    X(TOKEN_EOF,       "EOF",             NULL)
+
+// Words that lex as something other than an IDENTIFIER. gen_scanner
+// turns them into a perfect hash table, KEYWORDS in scanner_dfa.h, which
+// the lexer uses to classify words and the printer to spell them.
+#define KEYWORD_LIST(X) \
+    X(KW_BREAK,       "break") \
+    X(KW_CONTINUE,    "continue") \
+    X(KW_DEFAULT,     "default") \
+    X(KW_DISPLAY,     "display") \
+    X(KW_ELSE,        "else") \
+    X(KW_FOR,         "for") \
+    X(KW_IF,          "if") \
+    X(KW_INPUT,       "input") \
+    X(KW_MAIN,        "main") \
+    X(KW_RETURN,      "return") \
+    X(KW_WHILE,       "while") \
+    \
+    X(TYPE_BOOLEAN,   "boolean") \
+    X(TYPE_CHARACTER, "character") \
+    X(TYPE_FLOAT,     "float") \
+    X(TYPE_INTEGER,   "integer") \
+    X(TYPE_STRING,    "string") \
+    \
+    X(RW_CONSTANT,    "constant") \
+    X(RW_NULL,        "null") \
+    X(RW_VOID,        "void") \
+    \
+    X(NW_DO,          "do") \
+    X(NW_END,         "end") \
+    X(NW_LET,         "let") \
+    X(NW_THEN,        "then") \
+    \
+    X(BOOL_CONST,     "true") \
+    X(BOOL_CONST,     "false")
+
+typedef enum {
+#define TOKEN_ENUM(type, name, spelling) type,
+    TOKEN_LIST(TOKEN_ENUM)
+#undef TOKEN_ENUM
+} TokenType;
+
+// Binary value of a numeric literal, decoded once by the lexer
+typedef union {
+    int64_t integer;    // NUM_CONST
+    double real;        // FLOAT_CONST
+} TokenValue;
+
+// One token on its own, as sinks and pulls hand them over
+typedef struct {
+    TokenType type;
+    size_t offset;      // Lexeme slice in the source buffer kept by the LexerState
+    size_t length;
+    size_t line_num;
+    TokenValue value;   // Zero unless type is NUM_CONST or FLOAT_CONST
+} Token;
+
+// All tokens of a source as parallel arrays, 13 bytes per token: a parser
+// checking kinds walks one byte array front to back. Offsets and lengths
+// are slices of `source`, which is why sources stay below 4 GiB.
+// Values of numeric literals are kept apart, 12 bytes per literal, sorted
+// by token index; other tokens have none.
+typedef struct {
+    uint8_t *kind;      // TokenType
+    uint32_t *offset;
+    uint32_t *length;
+    uint32_t *line;
+    size_t count;
+    size_t capacity;
+    TokenValue *literal_value;
+    uint32_t *literal_index;   // Token index of each literal_value
+    size_t literal_count;
+    size_t literal_capacity;
+    const char *source;
+} TokenStream;
+
+int token_stream_reserve(TokenStream *stream, size_t capacity);
+void token_stream_free(TokenStream *stream);
+// Record the value of literal token `index`. Literals are added in
+// token order. Returns 0 if out of memory.
+int token_stream_add_value(TokenStream *stream, size_t index, TokenValue value);
+// Position of token `index` in the literal table, or literal_count if
+// it has no value there
+size_t token_stream_find_literal(const TokenStream *stream, size_t index);
+// Value of token `index`; zero unless it is a NUM_CONST or FLOAT_CONST
+TokenValue token_stream_value(const TokenStream *stream, size_t index);
+
+static inline Token token_stream_at(const TokenStream *stream, size_t index) {
+    Token token = { (TokenType)stream->kind[index], stream->offset[index], stream->length[index], stream->line[index],
+                    token_stream_value(stream, index) };
+    return token;
+}
+
+// Per-run lexer context: line counter, source buffer and token storage.
+// Each thread lexing in parallel needs its own state.
+typedef struct LexerState LexerState;
+
+// Receives each token as soon as it is lexed, e.g. to hand it to a parser
+// running on another thread. The token itself stays owned by the state.
+typedef void (*TokenSink)(void *context, const Token *token);
+// Copies up to `max` further tokens into `out` and returns how many;
+// 0 means the stream has ended. Lets a parser consume tokens as they come.
+typedef size_t (*TokenPull)(void *context, Token *out, size_t max);
+
+const char *token_type_to_string(TokenType type);
+TokenType token_type_from_string(const char *name);
+// Decode the digits of a NUM_CONST ("123") or FLOAT_CONST ("1.5") into
+// *value. Returns 0 if the literal does not fit; *value then saturates
+// to INT64_MAX or infinity.
+int decode_number(TokenType type, const char *text, size_t length, TokenValue *value);
+
+// Whitespace, comment and string runs are skipped with the widest SIMD
+// kernel the CPU has; CTY_SIMD=scalar|sse2|avx2 caps it.
+LexerState *lexer_create(void);
+// The returned stream belongs to the state and stays valid until the next
+// lexer_lex*() call on it or lexer_destroy(). "-" lexes standard input.
+const TokenStream *lexer_lex(LexerState *state, const char *path);
+const TokenStream *lexer_lex_stream(LexerState *state, FILE *file);
+// lexer_lex() in two steps: load (mmap or read) the source, then tokenize it
+int lexer_load(LexerState *state, const char *path);
+const TokenStream *lexer_tokenize(LexerState *state);
+void lexer_set_sink(LexerState *state, TokenSink sink, void *context);
+// Pull-based alternative to lexer_tokenize(): one token per call from
+// the loaded source, 0 at the end. Nothing is stored per token; the sink,
+// if set, still sees each one.
+int lexer_next_token(LexerState *state, Token *token);
+// The loaded source, which every token's offset indexes
+const char *lexer_source(const LexerState *state);
+void lexer_destroy(LexerState *state);
+
+const char *token_text(const LexerState *state, const Token *token, size_t *length);
+const char *token_stream_text(const TokenStream *stream, size_t index, size_t *length);
+void print_token(const LexerState *state, const Token *token);
+void write_to_symbol_table(const LexerState *state, const Token *token, FILE *symbol_table_file);
+void write_token_stream(const TokenStream *stream, FILE *file);
+
 #endif // LEXER_H_
\ No newline at end of file
@@ -1,81 +1,247 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-
-#include "lexers.h"
-#include "parser.h"
-
-const char* VALID_EXTENSION = ".cty";
-void check_file_type(const char* filename, const char* expectedExtension);
-
-int main(int argc, char *argv[]) {
-    if (argc != 2) {
-        fprintf(stderr, "Error: correct syntax: %s <filename.cty>\n\n", argv[0]);
-        exit(1);
-    }
-
-    check_file_type(argv[1], VALID_EXTENSION);
-
-    // Open the .cty file
-    FILE *file = fopen(argv[1], "r");
-    if (!file) {
-        printf("ERROR: File not found\n");
-        exit(1);
-    }
-
-    // Open/Create the output file for the symbol table
-    FILE *symbol_table = fopen("output/symbol_table.txt", "w");
-    if (!symbol_table) {
-        printf("ERROR: Unable to create the output file\n");
-        fclose(file);
-        exit(1);
-    }
-
-    // Get tokens from the lexer
-    size_t token_count = 0;
-    Token **tokens = lexer(file, &token_count);
-    fclose(file);
-
-    // Check if lexer returned NULL tokens
-    if (!tokens) {
-        printf("Error: Lexer failed to process the file\n");
-        fclose(symbol_table);
-        exit(1);
-    }
-
-    // Write tokens to the symbol table
-    printf("Tokens generated:\n");
-    for (size_t i = 0; i < token_count; i++) {
-        print_token(tokens[i]);
-        write_to_symbol_table(tokens[i], symbol_table);
-    }
-    fclose(symbol_table);
-
-    // Run the parser
-    printf("\n--- Running Parser ---\n");
-    runParser("output/symbol_table.txt");  // We don't need to check return value anymore
-    printf("Parsing completed successfully. Check parsed.txt for results.\n");
-
-    // Clean up allocated memory for tokens
-    for (size_t j = 0; j < token_count; j++) {
-        if (tokens[j]->value) {
-            free(tokens[j]->value);
-        }
-        free(tokens[j]);
-    }
-    free(tokens);  // Free the token array
-
-    printf("Processing complete.\n");
-    return 0;
-}
-
-// Only files with .cty extensions are accepted
-void check_file_type(const char* filename, const char* expectedExtension){
-    const char *dot = strrchr(filename, '.');
-    
-    // Check if filename has an invalid extension
-    if(dot == NULL || strcmp(dot, expectedExtension) != 0){
-        fprintf(stderr, "Error: unexpected file type: %s\nExpected file type: <filename.cty>\n", filename);
-        exit(1);
-    }
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lexers.h"
+#include "parser.h"
+#include "batch.h"
+#include "pipeline.h"
+
+const char* VALID_EXTENSION = ".cty";
+void check_file_type(const char* filename, const char* expectedExtension);
+int run_streaming(const char *filename, const char *output_dir, int write_symbol_table);
+
+void print_usage(const char *program) {
+    fprintf(stderr, "Error: correct syntax: %s [--out DIR] [--no-symbol-table] [--trace] [--emit LIST] [--pipeline | --stream] <filename.cty | ->\n"
+                    "   or: %s --batch [--jobs N] [--out DIR] [--no-symbol-table] [--trace] [--emit LIST] <file.cty | dir>...\n"
+                    "LIST is \"none\" or a comma-separated subset of parsed,csv,paren,ast,bin (default parsed,csv,paren,ast);\n"
+                    "outputs left out are deleted from the output directory.\n"
+                    "DIR (default \"output\") must exist, except with --batch, which creates it\n\n",
+            program, program);
+}
+
+// Parser output names accepted by --emit
+static const struct {
+    const char *name;
+    unsigned output;
+} EMIT_NAMES[] = {
+    { "parsed", PARSE_OUTPUT_PARSED },
+    { "csv", PARSE_OUTPUT_CSV },
+    { "paren", PARSE_OUTPUT_PARENTHESIZED },
+    { "ast", PARSE_OUTPUT_AST },
+    { "bin", PARSE_OUTPUT_TREE_BINARY },
+};
+
+// ParseOutput flags of an --emit list, or -1 if it names an unknown output
+long parse_emit_list(const char *list) {
+    if (strcmp(list, "none") == 0) return 0;
+
+    long outputs = 0;
+    while (*list) {
+        size_t length = strcspn(list, ",");
+        size_t i = 0;
+        while (i < sizeof(EMIT_NAMES) / sizeof(EMIT_NAMES[0]) &&
+               (strlen(EMIT_NAMES[i].name) != length || strncmp(EMIT_NAMES[i].name, list, length) != 0)) {
+            i++;
+        }
+        if (i == sizeof(EMIT_NAMES) / sizeof(EMIT_NAMES[0])) return -1;
+
+        outputs |= EMIT_NAMES[i].output;
+        list += length;
+        if (*list == ',') list++;
+    }
+    return outputs;
+}
+
+// Open <output_dir>/symbol_table.txt for writing
+FILE *open_symbol_table(const char *output_dir) {
+    size_t length = strlen(output_dir) + sizeof("/symbol_table.txt");
+    char *path = malloc(length);
+    if (!path) return NULL;
+    snprintf(path, length, "%s/symbol_table.txt", output_dir);
+
+    FILE *file = fopen(path, "w");
+    free(path);
+    return file;
+}
+
+int main(int argc, char *argv[]) {
+    int write_symbol_table = 1;
+    int batch = 0;
+    int pipeline = 0;
+    int stream = 0;
+    unsigned parse_outputs = PARSE_OUTPUT_DEFAULT;
+    BatchOptions batch_options = { "output", 0, 1 };
+    char **inputs = malloc(argc * sizeof(char *));
+    int input_count = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--no-symbol-table") == 0) {
+            write_symbol_table = 0;
+        } else if (strcmp(argv[i], "--trace") == 0) {
+            setParseTrace(1);
+        } else if (strcmp(argv[i], "--emit") == 0 && i + 1 < argc) {
+            long outputs = parse_emit_list(argv[++i]);
+            if (outputs < 0) {
+                print_usage(argv[0]);
+                exit(1);
+            }
+            parse_outputs = (unsigned)outputs;
+            setParseOutputs(parse_outputs);
+        } else if (strcmp(argv[i], "--pipeline") == 0) {
+            pipeline = 1;
+        } else if (strcmp(argv[i], "--stream") == 0) {
+            stream = 1;
+        } else if (strcmp(argv[i], "--batch") == 0) {
+            batch = 1;
+        } else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+            batch_options.jobs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            batch_options.output_dir = argv[++i];
+        } else {
+            inputs[input_count++] = argv[i];
+        }
+    }
+
+    // Batch mode: many files or directories, one process, outputs per file
+    if (batch) {
+        if (input_count == 0) {
+            print_usage(argv[0]);
+            exit(1);
+        }
+        batch_options.write_symbol_table = write_symbol_table;
+        int failures = run_batch(inputs, input_count, &batch_options);
+        free(inputs);
+        return failures ? 1 : 0;
+    }
+
+    const char *filename = input_count == 1 ? inputs[0] : NULL;
+    free(inputs);
+    if (!filename) {
+        print_usage(argv[0]);
+        exit(1);
+    }
+
+    // "-" reads the program from standard input
+    if (strcmp(filename, "-") != 0) {
+        check_file_type(filename, VALID_EXTENSION);
+    }
+
+    // With --stream no token array is built at all
+    if (stream) return run_streaming(filename, batch_options.output_dir, write_symbol_table);
+
+    // Get tokens from the lexer. With --pipeline the parser runs at the
+    // same time, consuming tokens as the lexer thread produces them.
+    LexerState *lexer = lexer_create();
+    const TokenStream *tokens = NULL;
+    if (lexer && pipeline) {
+        Parser *parser = createParser();
+        int parsed = 0;
+        tokens = parser ? lex_and_parse_pipelined(lexer, parser, filename, batch_options.output_dir, &parsed) : NULL;
+        destroyParser(parser);
+        if (tokens) printf("Pipelined parse %s.\n", parsed ? "succeeded" : "failed");
+    } else if (lexer) {
+        tokens = lexer_lex(lexer, filename);
+    }
+
+    // Check if lexer returned NULL tokens
+    if (!tokens) {
+        printf("ERROR: File not found or unreadable\n");
+        lexer_destroy(lexer);
+        exit(1);
+    }
+
+    // Open/Create the output file for the symbol table (optional side output)
+    FILE *symbol_table = NULL;
+    if (write_symbol_table) {
+        symbol_table = open_symbol_table(batch_options.output_dir);
+        if (!symbol_table) {
+            printf("ERROR: Unable to create the output file\n");
+            lexer_destroy(lexer);
+            exit(1);
+        }
+    }
+
+    // Print the tokens and write them to the symbol table
+    printf("Tokens generated:\n");
+    write_token_stream(tokens, stdout);
+    if (symbol_table) {
+        write_token_stream(tokens, symbol_table);
+        fclose(symbol_table);
+    }
+
+    // Run the parser on the in-memory tokens
+    if (!pipeline) {
+        printf("\n--- Running Parser ---\n");
+        runParserTokens(tokens, batch_options.output_dir);
+        if (parse_outputs & PARSE_OUTPUT_PARSED) {
+            printf("Parsing completed successfully. Check parsed.txt for results.\n");
+        }
+    }
+
+    // Clean up allocated memory for tokens
+    lexer_destroy(lexer);
+
+    printf("Processing complete.\n");
+    return 0;
+}
+
+typedef struct {
+    const LexerState *lexer;
+    FILE *symbol_table;
+} TokenEcho;
+
+// Print a streamed token and add it to the symbol table
+void echo_token(void *context, const Token *token) {
+    TokenEcho *echo = context;
+    print_token(echo->lexer, token);
+    if (echo->symbol_table) write_to_symbol_table(echo->lexer, token, echo->symbol_table);
+}
+
+// Lex and parse in one pass that keeps only a window of tokens; each token
+// is printed and written to the symbol table as the parser pulls it
+int run_streaming(const char *filename, const char *output_dir, int write_symbol_table) {
+    LexerState *lexer = lexer_create();
+    Parser *parser = createParser();
+    if (!lexer || !parser || !lexer_load(lexer, filename)) {
+        printf("ERROR: File not found or unreadable\n");
+        destroyParser(parser);
+        lexer_destroy(lexer);
+        return 1;
+    }
+
+    TokenEcho echo = { lexer, NULL };
+    if (write_symbol_table) {
+        echo.symbol_table = open_symbol_table(output_dir);
+        if (!echo.symbol_table) {
+            printf("ERROR: Unable to create the output file\n");
+            destroyParser(parser);
+            lexer_destroy(lexer);
+            return 1;
+        }
+    }
+    lexer_set_sink(lexer, echo_token, &echo);
+
+    printf("Tokens generated:\n");
+    size_t token_count = 0;
+    int parsed = parse_streaming(lexer, parser, output_dir, &token_count);
+    printf("Streamed parse of %zu tokens %s.\n", token_count, parsed ? "succeeded" : "failed");
+
+    if (echo.symbol_table) fclose(echo.symbol_table);
+    destroyParser(parser);
+    lexer_destroy(lexer);
+
+    printf("Processing complete.\n");
+    return 0;
+}
+
+// Only files with .cty extensions are accepted
+void check_file_type(const char* filename, const char* expectedExtension){
+    const char *dot = strrchr(filename, '.');
+    
+    // Check if filename has an invalid extension
+    if(dot == NULL || strcmp(dot, expectedExtension) != 0){
+        fprintf(stderr, "Error: unexpected file type: %s\nExpected file type: <filename.cty>\n", filename);
+        exit(1);
+    }
 }
\ No newline at end of file
@@ -0,0 +1,76 @@
+#include "output_buffer.h"
+
+#include <stdlib.h>
+
+int output_buffer_init(OutputBuffer *buffer, FILE *file) {
+    buffer->file = file;
+    buffer->data = malloc(OUTPUT_BUFFER_SIZE);
+    buffer->used = 0;
+    buffer->capacity = buffer->data ? OUTPUT_BUFFER_SIZE : 0;
+    return buffer->data != NULL;
+}
+
+void output_buffer_flush(OutputBuffer *buffer) {
+    if (buffer->used > 0) fwrite(buffer->data, 1, buffer->used, buffer->file);
+    buffer->used = 0;
+}
+
+void output_buffer_free(OutputBuffer *buffer) {
+    output_buffer_flush(buffer);
+    free(buffer->data);
+    buffer->data = NULL;
+    buffer->capacity = 0;
+}
+
+// Text that does not fit: flush, then copy it in, or write it straight
+// through if it would not fit an empty buffer either
+void output_write_slow(OutputBuffer *buffer, const char *text, size_t length) {
+    output_buffer_flush(buffer);
+    if (length >= buffer->capacity) {
+        fwrite(text, 1, length, buffer->file);
+        return;
+    }
+    memcpy(buffer->data, text, length);
+    buffer->used = length;
+}
+
+// Indentation: `count` copies of `c`, filled in place a buffer at a time
+void output_write_repeated(OutputBuffer *buffer, char c, size_t count) {
+    if (buffer->capacity == 0) {
+        while (count-- > 0) fputc(c, buffer->file);
+        return;
+    }
+    while (count > 0) {
+        if (buffer->used == buffer->capacity) output_buffer_flush(buffer);
+        size_t chunk = buffer->capacity - buffer->used;
+        if (chunk > count) chunk = count;
+        memset(buffer->data + buffer->used, c, chunk);
+        buffer->used += chunk;
+        count -= chunk;
+    }
+}
+
+size_t output_format_uint(char *out, uint64_t value) {
+    char digits[20];
+    size_t start = sizeof(digits);
+    do {
+        digits[--start] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+    memcpy(out, digits + start, sizeof(digits) - start);
+    return sizeof(digits) - start;
+}
+
+void output_write_uint(OutputBuffer *buffer, uint64_t value) {
+    char digits[20];
+    output_write(buffer, digits, output_format_uint(digits, value));
+}
+
+void output_write_int(OutputBuffer *buffer, int64_t value) {
+    if (value < 0) {
+        output_write_char(buffer, '-');
+        output_write_uint(buffer, 0 - (uint64_t)value);
+    } else {
+        output_write_uint(buffer, (uint64_t)value);
+    }
+}
@@ -0,0 +1,51 @@
+#ifndef OUTPUT_BUFFER_H_
+#define OUTPUT_BUFFER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// Text collected in a large buffer of our own and handed to the file in
+// one fwrite per OUTPUT_BUFFER_SIZE bytes, instead of one stdio call per
+// field. Integers are formatted by hand. The file stays owned by the
+// caller; output_buffer_free() flushes but does not close it.
+
+#ifndef OUTPUT_BUFFER_SIZE
+#define OUTPUT_BUFFER_SIZE (256 * 1024)
+#endif
+
+typedef struct {
+    FILE *file;
+    char *data;
+    size_t used;
+    size_t capacity;
+} OutputBuffer;
+
+// Returns 0 if the buffer cannot be allocated; writes then go straight
+// to the file
+int output_buffer_init(OutputBuffer *buffer, FILE *file);
+void output_buffer_flush(OutputBuffer *buffer);
+void output_buffer_free(OutputBuffer *buffer);
+
+void output_write_slow(OutputBuffer *buffer, const char *text, size_t length);
+void output_write_repeated(OutputBuffer *buffer, char c, size_t count);
+void output_write_uint(OutputBuffer *buffer, uint64_t value);
+// Decimal digits of `value` into `out` (at most 20); returns how many
+size_t output_format_uint(char *out, uint64_t value);
+void output_write_int(OutputBuffer *buffer, int64_t value);
+
+static inline void output_write(OutputBuffer *buffer, const char *text, size_t length) {
+    if (buffer->capacity - buffer->used >= length) {
+        memcpy(buffer->data + buffer->used, text, length);
+        buffer->used += length;
+    } else {
+        output_write_slow(buffer, text, length);
+    }
+}
+
+static inline void output_write_char(OutputBuffer *buffer, char c) {
+    output_write(buffer, &c, 1);
+}
+
+#endif // OUTPUT_BUFFER_H_
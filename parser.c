@@ -1,1278 +1,1685 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <ctype.h>
 #include "lexers.h"
+#include "parser.h"
+#include "arena.h"
+#include "ast.h"
+#include "flat_tree.h"
+#include "output_buffer.h"
+
+// Kinds of parse tree nodes. A terminal node uses the TokenType it was
+// matched from as its kind; nonterminals and a few specially labelled
+// terminals are numbered after TOKEN_EOF.
+typedef enum {
+    NODE_SIMPLICITY = TOKEN_EOF + 1,
+    NODE_DECL_STMT,
+    NODE_VAR_DECL,
+    NODE_ID_LIST,
+    NODE_ASSIGN,
+    NODE_UPDATE,
+    NODE_UPDATE_OP,
+    NODE_BOOL_LITERAL,
+    NODE_ASSIGNMENT,
+    NODE_ARR_DECL,
+    NODE_FUNC_DECL,
+    NODE_PARAM_LIST,
+    NODE_PARAM,
+    NODE_FUNC_STMT,
+    NODE_FUNC_CALL,
+    NODE_ARG_LIST,
+    NODE_EXP,
+    NODE_FUNC_DEF,
+    NODE_BLOCK,
+    NODE_STMT_LIST,
+    NODE_ASSIGN_STMT,
+    NODE_ARR_STMT,
+    NODE_ARR_ASSIGN,
+    NODE_ARR_ACCESS,
+    NODE_ARR_INIT,
+    NODE_ARR_LIST,
+    NODE_COND_STMT,
+    NODE_IF_STMT,
+    NODE_IFELSE_STMT,
+    NODE_ELSEIF_STMT,
+    NODE_ELSE_STMT,
+    NODE_ITER_STMT,
+    NODE_WHILE_STMT,
+    NODE_FOR_STMT,
+    NODE_RETURN_STMT,
+    NODE_OUTPUT_STMT,
+    NODE_STD_OUTPUT,
+    NODE_VALUE_OUTPUT,
+    NODE_FORMAT_SPECIFIER,
+    NODE_SEQUENCE_OUTPUT,
+    NODE_OUTPUT_ELEM,
+    NODE_INPUT_STMT,
+
+    // Terminals the parser labels with their spelling instead of the token name
+    NODE_MAIN,
+    NODE_EQUALS_SIGN,
+    NODE_OPEN_PAREN_SIGN,
+    NODE_CLOSE_PAREN_SIGN,
+    NODE_COMMA_SIGN,
+    NODE_SEMICOLON_SIGN,
+
+    NODE_KIND_COUNT
+} NodeKind;
+
+// Labels of the kinds numbered after TOKEN_EOF
+static const char* const NODE_LABELS[NODE_KIND_COUNT] = {
+    [NODE_SIMPLICITY] = "SIMPLICITY",
+    [NODE_DECL_STMT] = "DECL_STMT",
+    [NODE_VAR_DECL] = "VAR_DECL",
+    [NODE_ID_LIST] = "ID_LIST",
+    [NODE_ASSIGN] = "ASSIGN",
+    [NODE_UPDATE] = "UPDATE",
+    [NODE_UPDATE_OP] = "UPDATE_OP",
+    [NODE_BOOL_LITERAL] = "BOOL_LITERAL",
+    [NODE_ASSIGNMENT] = "ASSIGNMENT",
+    [NODE_ARR_DECL] = "ARR_DECL",
+    [NODE_FUNC_DECL] = "FUNC_DECL",
+    [NODE_PARAM_LIST] = "PARAM_LIST",
+    [NODE_PARAM] = "PARAM",
+    [NODE_FUNC_STMT] = "FUNC_STMT",
+    [NODE_FUNC_CALL] = "FUNC_CALL",
+    [NODE_ARG_LIST] = "ARG_LIST",
+    [NODE_EXP] = "EXP",
+    [NODE_FUNC_DEF] = "FUNC_DEF",
+    [NODE_BLOCK] = "BLOCK",
+    [NODE_STMT_LIST] = "STMT_LIST",
+    [NODE_ASSIGN_STMT] = "ASSIGN_STMT",
+    [NODE_ARR_STMT] = "ARR_STMT",
+    [NODE_ARR_ASSIGN] = "ARR_ASSIGN",
+    [NODE_ARR_ACCESS] = "ARR_ACCESS",
+    [NODE_ARR_INIT] = "ARR_INIT",
+    [NODE_ARR_LIST] = "ARR_LIST",
+    [NODE_COND_STMT] = "COND_STMT",
+    [NODE_IF_STMT] = "IF_STMT",
+    [NODE_IFELSE_STMT] = "IFELSE_STMT",
+    [NODE_ELSEIF_STMT] = "ELSEIF_STMT",
+    [NODE_ELSE_STMT] = "ELSE_STMT",
+    [NODE_ITER_STMT] = "ITER_STMT",
+    [NODE_WHILE_STMT] = "WHILE_STMT",
+    [NODE_FOR_STMT] = "FOR_STMT",
+    [NODE_RETURN_STMT] = "RETURN_STMT",
+    [NODE_OUTPUT_STMT] = "OUTPUT_STMT",
+    [NODE_STD_OUTPUT] = "STD_OUTPUT",
+    [NODE_VALUE_OUTPUT] = "VALUE_OUTPUT",
+    [NODE_FORMAT_SPECIFIER] = "FORMAT_SPECIFIER",
+    [NODE_SEQUENCE_OUTPUT] = "SEQUENCE_OUTPUT",
+    [NODE_OUTPUT_ELEM] = "OUTPUT_ELEM",
+    [NODE_INPUT_STMT] = "INPUT_STMT",
+    [NODE_MAIN] = "MAIN",
+    [NODE_EQUALS_SIGN] = "=",
+    [NODE_OPEN_PAREN_SIGN] = "(",
+    [NODE_CLOSE_PAREN_SIGN] = ")",
+    [NODE_COMMA_SIGN] = ",",
+    [NODE_SEMICOLON_SIGN] = ";",
+};
+
+// Label written to the output files for a node kind
+static const char* nodeLabel(NodeKind kind) {
+    if (kind < NODE_SIMPLICITY) return token_type_to_string((TokenType)kind);
+    return NODE_LABELS[kind];
+}
+
+// nodeLabel() for the kind of a FlatNode, which may come from a file
+const char* nodeKindLabel(uint32_t kind) {
+    return kind < NODE_KIND_COUNT ? nodeLabel((NodeKind)kind) : "UNKNOWN";
+}
+
+// Lexeme and value of the token a terminal node was matched from
+typedef struct {
+    uint32_t offset;             // Slice of the parsed source
+    uint32_t length;
+    TokenValue value;
+} TreeToken;
 
+// Nodes get their IDs only when the finished tree is flattened, in
+// preorder, so nodes of abandoned alternatives leave no gaps.
 typedef struct TreeNode {
-    int id;
-    int parentID;
-    char *value;
-    struct TreeNode **children;
-    size_t childCount;
+    NodeKind kind;
+    uint32_t childCount;
+    uint32_t childCapacity;
+    uint32_t line;               // Source line of a terminal or operator; 0 for other nodes
+    struct TreeNode **children;  // Arena array of childCapacity entries
+    TreeToken token;             // Terminals only; other nodes are allocated without it
 } TreeNode;
 
-typedef struct {
-    char *type;
-    char *value;
-} TokenInfo;
-
-static size_t nextNodeID = 0;
-static size_t currentTokenIndex = 0;
-TokenInfo *tokens = NULL;
-size_t token_count = 0;
-FILE* parsed_file = NULL; 
+static int traceByDefault = 0;   // Trace setting for parsers created by runParser*()
+static unsigned outputsByDefault = PARSE_OUTPUT_DEFAULT;  // ParseOutput flags of new parsers
 
 // Function prototypes
-TreeNode* parseSimplicity(); //1
-TreeNode* parseDeclStmt(); // 2
-TreeNode* parseVarDecl(); //3
-TreeNode* parseTypeSpec(); // 4
-TreeNode* parseIdList(); // 5
-TreeNode* parseAssign(); // 6
-TreeNode* parseBoolExp(); // 7
-TreeNode* parseBoolTerm(); // 8
-TreeNode* parseBoolFactor(); // 9
-TreeNode* parseRelExp(); // 10
-TreeNode* parseArithExp(); // 11
-TreeNode* parseAddMinOp(); // 12
-TreeNode* parseTerm(); // 13
-TreeNode* parseFactor(); // 14
-TreeNode* parseBase(); // 15
-TreeNode* parseUpdate(); // 16
-TreeNode* parseUpdateOp(); // 17
-TreeNode* parseMulDivOp(); // 18
-TreeNode* parseRelOp(); // 19
-TreeNode* parseBoolLiteral(); // 20
-TreeNode* parseAssignment(); // 21
-TreeNode* parseArrDecl(); // 22
-TreeNode* parseFuncDecl(); // 23
-TreeNode* parseParamList(); // 24
-TreeNode* parseParam(); // 25
-TreeNode* parseFuncStmt(); // 26
-TreeNode* parseFuncCall(); // 27
-TreeNode* parseArgList(); // 28
-TreeNode* parseExp(); // 29
-TreeNode* parseFuncDef(); // 30
-TreeNode* parseBlock(); // 31
-TreeNode* parseStmtList(); // 32
-TreeNode* parseStmt(); // 33
-TreeNode* parseAssignStmt(); // 34
-TreeNode* parseArrStmt(); // 35
-TreeNode* parseArrAssign(); // 36
-TreeNode* parseArrAccess(); // 37
-TreeNode* parseArrInit(); // 38
-TreeNode* parseArrList(); // 39
-TreeNode* parseArrElem(); // 40
-TreeNode* parseCondStmt(); // 41
-TreeNode* parseIfStmt(); // 42
-TreeNode* parseIfElseStmt(); // 43
-TreeNode* parseElseIfStmt(); // 44
-TreeNode* parseElseStmt(); // 45
-TreeNode* parseIterStmt(); // 46
-TreeNode* parseWhileStmt(); // 47
-TreeNode* parseForStmt(); // 48
-TreeNode* parseReturnStmt(); // 49
-TreeNode* parseOutputStmt(); // 50
-TreeNode* parseStdOutput(); // 51
-TreeNode* parseValueOutput(); // 52
-TreeNode* parseFormatSpecifier(); // 53
-TreeNode* parseSequenceOutput(); // 54
-TreeNode* parseOutputElem(); // 55
-TreeNode* parseInputStmt(); // 56
+TreeNode* parseSimplicity(Parser* parser); //1
+TreeNode* parseDeclStmt(Parser* parser); // 2
+TreeNode* parseVarDecl(Parser* parser); //3
+TreeNode* parseTypeSpec(Parser* parser); // 4
+TreeNode* parseIdList(Parser* parser); // 5
+TreeNode* parseAssign(Parser* parser); // 6
+TreeNode* parseBoolExp(Parser* parser); // 7
+TreeNode* parseArithExp(Parser* parser); // 11
+TreeNode* parseUpdate(Parser* parser); // 16
+TreeNode* parseUpdateOp(Parser* parser); // 17
+TreeNode* parseBoolLiteral(Parser* parser); // 20
+TreeNode* parseAssignment(Parser* parser); // 21
+TreeNode* parseArrDecl(Parser* parser); // 22
+TreeNode* parseFuncDecl(Parser* parser); // 23
+TreeNode* parseParamList(Parser* parser); // 24
+TreeNode* parseParam(Parser* parser); // 25
+TreeNode* parseFuncStmt(Parser* parser); // 26
+TreeNode* parseFuncCall(Parser* parser); // 27
+TreeNode* parseArgList(Parser* parser); // 28
+TreeNode* parseExp(Parser* parser); // 29
+TreeNode* parseFuncDef(Parser* parser); // 30
+TreeNode* parseBlock(Parser* parser); // 31
+TreeNode* parseStmtList(Parser* parser); // 32
+TreeNode* parseStmt(Parser* parser); // 33
+TreeNode* parseAssignStmt(Parser* parser); // 34
+TreeNode* parseArrStmt(Parser* parser); // 35
+TreeNode* parseArrAssign(Parser* parser); // 36
+TreeNode* parseArrAccess(Parser* parser); // 37
+TreeNode* parseArrInit(Parser* parser); // 38
+TreeNode* parseArrList(Parser* parser); // 39
+TreeNode* parseArrElem(Parser* parser); // 40
+TreeNode* parseCondStmt(Parser* parser); // 41
+TreeNode* parseIfStmt(Parser* parser); // 42
+TreeNode* parseIfElseStmt(Parser* parser); // 43
+TreeNode* parseElseIfStmt(Parser* parser); // 44
+TreeNode* parseElseStmt(Parser* parser); // 45
+TreeNode* parseIterStmt(Parser* parser); // 46
+TreeNode* parseWhileStmt(Parser* parser); // 47
+TreeNode* parseForStmt(Parser* parser); // 48
+TreeNode* parseReturnStmt(Parser* parser); // 49
+TreeNode* parseOutputStmt(Parser* parser); // 50
+TreeNode* parseStdOutput(Parser* parser); // 51
+TreeNode* parseValueOutput(Parser* parser); // 52
+TreeNode* parseFormatSpecifier(Parser* parser); // 53
+TreeNode* parseSequenceOutput(Parser* parser); // 54
+TreeNode* parseOutputElem(Parser* parser); // 55
+TreeNode* parseInputStmt(Parser* parser); // 56
+
+// Predictive dispatch helpers for statements sharing a FIRST token
+TreeNode* parseTypedStmt(Parser* parser);
+TreeNode* parseLetStmt(Parser* parser);
+TreeNode* parseIdentifierStmt(Parser* parser);
+TreeNode* parseTopIdentifierStmt(Parser* parser);
+
+// Token sets used by matchAny(), one bit per set
+typedef unsigned int TokenSet;
+#define SET_TYPE_SPEC      (1u << 0)
+#define SET_ASSIGNMENT_OP  (1u << 1)
+#define SET_UPDATE_OP      (1u << 2)
+#define SET_FORMAT_SPEC    (1u << 3)
+
+// Precomputed set membership for every token type
+static const TokenSet TOKEN_SETS[TOKEN_EOF + 1] = {
+    [TYPE_BOOLEAN] = SET_TYPE_SPEC,
+    [TYPE_CHARACTER] = SET_TYPE_SPEC,
+    [TYPE_FLOAT] = SET_TYPE_SPEC,
+    [TYPE_INTEGER] = SET_TYPE_SPEC,
+    [TYPE_STRING] = SET_TYPE_SPEC,
+
+    [ASSIGN_OP] = SET_ASSIGNMENT_OP,
+    [ADD_ASSIGN] = SET_ASSIGNMENT_OP,
+    [SUB_ASSIGN] = SET_ASSIGNMENT_OP,
+    [MUL_ASSIGN] = SET_ASSIGNMENT_OP,
+    [DIV_ASSIGN] = SET_ASSIGNMENT_OP,
+    [INTDIV_ASSIGN] = SET_ASSIGNMENT_OP,
+    [MOD_ASSIGN] = SET_ASSIGNMENT_OP,
+
+    [UNARY_INC] = SET_UPDATE_OP,
+    [UNARY_DEC] = SET_UPDATE_OP,
+
+    [FORMAT_INT] = SET_FORMAT_SPEC,
+    [FORMAT_CHAR] = SET_FORMAT_SPEC,
+    [FORMAT_FLOAT] = SET_FORMAT_SPEC,
+    [FORMAT_STR] = SET_FORMAT_SPEC,
+};
+
+// Binding power of the binary operators, loosest first. BOOL_EXP starts
+// at PREC_OR and ARITH_EXP at PREC_ADD, so an arithmetic expression stops
+// at the first comparison or logical operator.
+enum {
+    PREC_NONE,
+    PREC_OR,      // LOG_OR
+    PREC_AND,     // LOG_AND
+    PREC_REL,     // REL_LT REL_GT REL_LE REL_GE REL_EQ REL_NEQ
+    PREC_ADD,     // ADD_OP SUB_OP
+    PREC_MUL,     // MUL_OP DIV_OP INTDIV_OP MOD_OP
+    PREC_EXPO     // EXPO_OP, right-associative
+};
+
+static const unsigned char BINARY_PRECEDENCE[TOKEN_EOF + 1] = {
+    [LOG_OR] = PREC_OR,
+    [LOG_AND] = PREC_AND,
+
+    [REL_LT] = PREC_REL,
+    [REL_GT] = PREC_REL,
+    [REL_LE] = PREC_REL,
+    [REL_GE] = PREC_REL,
+    [REL_EQ] = PREC_REL,
+    [REL_NEQ] = PREC_REL,
+
+    [ADD_OP] = PREC_ADD,
+    [SUB_OP] = PREC_ADD,
+
+    [MUL_OP] = PREC_MUL,
+    [DIV_OP] = PREC_MUL,
+    [INTDIV_OP] = PREC_MUL,
+    [MOD_OP] = PREC_MUL,
+
+    [EXPO_OP] = PREC_EXPO,
+};
+
+// LL(1) dispatch on the FIRST token of a statement.
+// FIRST(DECL_STMT)   = RW_CONSTANT NW_LET RW_VOID TYPE_SPEC
+// FIRST(ASSIGN_STMT) = NW_LET IDENTIFIER
+// FIRST(ARR_STMT)    = IDENTIFIER TYPE_SPEC
+// FIRST(COND_STMT)   = KW_IF
+// FIRST(ITER_STMT)   = KW_WHILE KW_FOR
+// FIRST(FUNC_STMT)   = IDENTIFIER TYPE_SPEC
+// FIRST(OUTPUT_STMT) = KW_DISPLAY
+// FIRST(INPUT_STMT)  = IDENTIFIER
+// Tokens shared by several statements go to a helper that looks one token further.
+typedef TreeNode* (*ParseFn)(Parser* parser);
+
+static const ParseFn STMT_TABLE[TOKEN_EOF + 1] = {
+    [TYPE_BOOLEAN] = parseTypedStmt,
+    [TYPE_CHARACTER] = parseTypedStmt,
+    [TYPE_FLOAT] = parseTypedStmt,
+    [TYPE_INTEGER] = parseTypedStmt,
+    [TYPE_STRING] = parseTypedStmt,
+    [RW_CONSTANT] = parseDeclStmt,
+    [RW_VOID] = parseDeclStmt,
+    [NW_LET] = parseLetStmt,
+    [IDENTIFIER] = parseIdentifierStmt,
+    [KW_IF] = parseCondStmt,
+    [KW_WHILE] = parseIterStmt,
+    [KW_FOR] = parseIterStmt,
+    [KW_DISPLAY] = parseOutputStmt,
+};
+
+// Same idea for the statements allowed before main: DECL_STMT, FUNC_STMT and ARR_STMT
+static const ParseFn TOP_LEVEL_TABLE[TOKEN_EOF + 1] = {
+    [TYPE_BOOLEAN] = parseTypedStmt,
+    [TYPE_CHARACTER] = parseTypedStmt,
+    [TYPE_FLOAT] = parseTypedStmt,
+    [TYPE_INTEGER] = parseTypedStmt,
+    [TYPE_STRING] = parseTypedStmt,
+    [RW_CONSTANT] = parseDeclStmt,
+    [RW_VOID] = parseDeclStmt,
+    [NW_LET] = parseDeclStmt,
+    [IDENTIFIER] = parseTopIdentifierStmt,
+};
 
 // Utility functions
-int match(const char* expectedType, int isOptional);
-TreeNode* createNode(const char* value);
-void addChild(TreeNode* parent, TreeNode* child);
-void freeTree(TreeNode* node);
-void writeParseTree(FILE* file, TreeNode* node);
-void writeParseTreeParenthesized(FILE* file, TreeNode* node, int depth);
-void writeParsingState();
-TokenInfo* readSymbolTable(const char* filename, size_t* token_count);
-
-// Function to read tokens from the symbol table
-TokenInfo* readSymbolTable(const char* filename, size_t* token_count) {
+int match(Parser* parser, TokenType expectedType, int isOptional);
+int matchAny(Parser* parser, TokenSet set, const char* setName);
+TokenType matchedType(Parser* parser);
+TreeNode* createNode(Parser* parser, unsigned kind);
+void addChild(Parser* parser, TreeNode* parent, TreeNode* child);
+void releaseTree(Parser* parser);
+void writeParsingDelta(Parser* parser);
+void openParseTrace(Parser* parser);
+int readSymbolTable(const char* filename, TokenStream* tokens);
+void freeSymbolTable(TokenStream* tokens);
+static int parseTokens(Parser* parser);
+static FILE* openOutput(Parser* parser, const char* name);
+TokenType peekType(Parser* parser, size_t offset);
+static int hasToken(Parser* parser, size_t index);
+static TokenType tokenKind(Parser* parser, size_t index);
+
+// Nonterminals whose results are cached by the packrat memo. Only rules
+// that backtracking parses again at the same token are worth a table:
+// every cached success also raises the tree arena's rollback floor.
+typedef enum {
+    MEMO_IF_STMT,
+    MEMO_BLOCK,
+    MEMO_RULE_COUNT
+} MemoRule;
+
+// Cached outcome of one nonterminal at one token index
+typedef struct {
+    enum { MEMO_UNKNOWN, MEMO_FAILED, MEMO_PARSED } state;
+    size_t endIndex;          // Token index after the rule ran
+    TreeNode* tree;           // Shared result, protected from arena rollbacks
+} MemoEntry;
+
+// Backtrack point: token position plus the top of the tree arena. While
+// it is open, pulled tokens from tokenIndex on are kept for a rewind.
+typedef struct {
+    size_t tokenIndex;
+    ArenaMark arena;
+    size_t depth;             // Position in parser->markStack
+} ParseMark;
+
+// All state of one parse lives in a Parser, so parsers can run side by side
+struct Parser {
+    const TokenStream* tokens;     // Loaded tokens; while pulling, &window, which starts at tokenBase
+    TokenStream window;            // Pulled tokens an open mark can still reach
+    size_t tokenBase;              // Pulled tokens before it can no longer be reached
+    size_t token_count;            // Tokens loaded so far, including dropped ones
+    TokenPull pull;                // Source of further tokens, NULL once drained
+    void* pullContext;
+    size_t currentTokenIndex;
+    Arena treeArena;               // Nodes and child arrays of the current parse
+    MemoEntry* memoTable[MEMO_RULE_COUNT];   // Indexed from tokenBase, like tokens
+    size_t memoCapacity[MEMO_RULE_COUNT];
+    size_t* markStack;             // Token index of every open ParseMark, oldest first
+    size_t markDepth;
+    size_t markCapacity;
+    TreeNode* tree;                // Result of the last successful parse
+    const char* treeSource;        // Source the tree's tokens are slices of
+    AstNode* ast;                  // tree lowered by lowerParseTree(), in treeArena
+    FlatTree* flatTree;            // tree in preorder, built by flattenParseTree()
+    const char* outputDir;         // Where parseTokens() writes its files
+    FILE* trace_file;
+    int traceEnabled;
+    int verbose;                   // Print the match log and rule progress to stdout
+    int outOfMemory;               // A tree node or mark could not be allocated; the parse fails
+    size_t literalHint;            // Literal table position of the last literal value read
+    unsigned outputs;              // ParseOutput flags: the files parseTokens() writes
+};
+
+// Tokens copied from a TokenPull source per call
+#define PULL_BATCH 256
+
+#define LOG_PARSE(parser, ...) do { if ((parser)->verbose) printf(__VA_ARGS__); } while (0)
+
+ParseMark markParse(Parser* parser);
+void rewindParse(Parser* parser, ParseMark mark);
+void releaseMark(Parser* parser, ParseMark mark);
+TreeNode* memoized(Parser* parser, MemoRule rule, ParseFn parse);
+void freeMemoTable(Parser* parser);
+TreeNode* parseIfStmtRule(Parser* parser);
+TreeNode* parseBlockRule(Parser* parser);
+static TreeNode* parseOperatorExp(Parser* parser, int minPrecedence, int boolean);
+static TreeNode* parseOperators(Parser* parser, int minPrecedence, int boolean);
+static TreeNode* parseOperand(Parser* parser, int boolean);
+static TreeNode* createOperatorNode(Parser* parser, TokenType op, uint32_t line);
+static uint32_t matchedLine(Parser* parser);
+
+// Function to read tokens from the symbol table. The token values are
+// copied into one buffer that becomes the stream's source.
+int readSymbolTable(const char* filename, TokenStream* tokens) {
     FILE* file = fopen(filename, "r");
     if (!file) {
         fprintf(stderr, "Error opening symbol table file\n");
-        return NULL;
+        return 0;
     }
 
-    TokenInfo* tokens = malloc(10 * sizeof(TokenInfo));
-    *token_count = 0;
-    size_t capacity = 10;
+    memset(tokens, 0, sizeof(TokenStream));
+    char* text = NULL;
+    size_t textLength = 0;
+    size_t textCapacity = 0;
     char line[256];
+    int ok = 1;
 
-    while (fgets(line, sizeof(line), file)) {
+    while (ok && fgets(line, sizeof(line), file)) {
         if (strstr(line, "TOKEN:") && strstr(line, "TYPE:")) {
-            if (*token_count >= capacity) {
-                capacity *= 2;
-                tokens = realloc(tokens, capacity * sizeof(TokenInfo));
+            if (tokens->count == tokens->capacity && !token_stream_reserve(tokens, tokens->capacity ? tokens->capacity * 2 : 10)) {
+                ok = 0;
+                break;
             }
+            size_t i = tokens->count;
+            tokens->kind[i] = TOKEN_UNKNOWN;
+            tokens->offset[i] = (uint32_t)textLength;
+            tokens->length[i] = 0;
 
             // Tokenize the line by splitting around "TOKEN:" and "TYPE:"
             char* tokenPart = strtok(line, "|");
             char* typePart = strtok(NULL, "|");
+            char* linePart = strtok(NULL, "|");
 
             // Process the "TOKEN" value
-            if (tokenPart) {
-                char value[100];
-                if (sscanf(tokenPart, "TOKEN: %s", value) == 1) {
-                    tokens[*token_count].value = strdup(value);
+            char value[100] = "";
+            if (tokenPart && sscanf(tokenPart, "TOKEN: %99s", value) == 1) {
+                size_t length = strlen(value);
+                if (textLength + length + 1 > textCapacity) {
+                    size_t capacity = (textLength + length + 1) * 2;
+                    char* larger = realloc(text, capacity);
+                    if (!larger) {
+                        ok = 0;
+                        break;
+                    }
+                    text = larger;
+                    textCapacity = capacity;
                 }
+                memcpy(text + textLength, value, length + 1);
+                tokens->length[i] = (uint32_t)length;
+                textLength += length + 1;
             }
 
             // Process the "TYPE" value
             if (typePart) {
                 char type[100];
                 if (sscanf(typePart, " TYPE: %s", type) == 1) {
-                    tokens[*token_count].type = strdup(type);
+                    tokens->kind[i] = (uint8_t)token_type_from_string(type);
+                }
+            }
+
+            // Process the "LINE" value
+            size_t lineNum = 0;
+            if (linePart) {
+                sscanf(linePart, " LINE: %zu", &lineNum);
+            }
+            tokens->line[i] = (uint32_t)lineNum;
+
+            // Numbers carry their binary value, as the lexer gives them
+            TokenType kind = (TokenType)tokens->kind[i];
+            if (kind == NUM_CONST || kind == FLOAT_CONST) {
+                TokenValue number;
+                decode_number(kind, value, tokens->length[i], &number);
+                if (!token_stream_add_value(tokens, i, number)) {
+                    ok = 0;
+                    break;
                 }
             }
 
             // Print the token and its type
-            printf("%s %s ", tokens[*token_count].value, tokens[*token_count].type);
-            (*token_count)++;
+            printf("%s %s ", value, token_type_to_string((TokenType)tokens->kind[i]));
+            tokens->count++;
         }
     }
 
     fclose(file);
-    return tokens;
+    tokens->source = text;
+    if (!ok) {
+        // A partial stream would parse as a different program
+        fprintf(stderr, "Error: out of memory while reading the symbol table\n");
+        freeSymbolTable(tokens);
+        return 0;
+    }
+    return 1;
+}
+
+// Free a stream produced by readSymbolTable (it owns its source)
+void freeSymbolTable(TokenStream* tokens) {
+    free((char*)tokens->source);
+    token_stream_free(tokens);
+}
+
+// Turn the per-match trace in parse_trace.txt on or off for parsers
+// created from now on
+void setParseTrace(int enabled) {
+    traceByDefault = enabled;
+}
+
+// Choose the output files of parsers created from now on
+void setParseOutputs(unsigned outputs) {
+    outputsByDefault = outputs;
 }
 
-// Function to write current parsing state
-void writeParsingState() {
-    if (!parsed_file) return;
+// Open the trace file and write the token types once as its header
+void openParseTrace(Parser* parser) {
+    if (!parser->traceEnabled) return;
 
-    // Write the current state of the tokens to parsed.txt
-    for (size_t i = 0; i < token_count; i++) {
-        if (i < currentTokenIndex) {
-            // Replace type with value for already parsed tokens
-            fprintf(parsed_file, "%s ", tokens[i].value);
+    parser->trace_file = openOutput(parser, "parse_trace.txt");
+    if (!parser->trace_file) return;
+
+    // The header lists every token, so a pulled stream is drained up front
+    while (hasToken(parser, parser->token_count)) {}
+
+    fprintf(parser->trace_file, "TOKENS %zu\n", parser->token_count);
+    for (size_t i = 0; i < parser->token_count; i++) {
+        fprintf(parser->trace_file, "%s ", token_type_to_string(tokenKind(parser, i)));
+    }
+    fprintf(parser->trace_file, "\n");
+}
+
+// Record the token consumed by the last match as "<index> <lexeme>".
+// tools/expand_trace.c rebuilds the full per-match view from these lines.
+void writeParsingDelta(Parser* parser) {
+    if (!parser->trace_file) return;
+
+    size_t index = parser->currentTokenIndex - 1;
+    fprintf(parser->trace_file, "%zu ", index);
+    size_t length;
+    const char* value = token_stream_text(parser->tokens, index - parser->tokenBase, &length);
+    for (size_t i = 0; i < length; i++) {
+        if (value[i] == '\n') {
+            fputs("\\n", parser->trace_file);
+        } else if (value[i] == '\\') {
+            fputs("\\\\", parser->trace_file);
         } else {
-            // Keep type for unparsed tokens
-            fprintf(parsed_file, "%s ", tokens[i].type);
+            fputc(value[i], parser->trace_file);
         }
     }
-    fprintf(parsed_file, "\n");
+    fputc('\n', parser->trace_file);
 }
 
 
 // Match the current token with the expected type and advance if successful
-int match(const char *expectedType, int isOptional) {
-    if (currentTokenIndex < token_count) {
-        printf("Matching token: %s (expected: %s)\n", tokens[currentTokenIndex].type, expectedType);
+int match(Parser* parser, TokenType expectedType, int isOptional) {
+    if (hasToken(parser, parser->currentTokenIndex)) {
+        LOG_PARSE(parser, "Matching token: %s (expected: %s)\n",
+               token_type_to_string(tokenKind(parser, parser->currentTokenIndex)), token_type_to_string(expectedType));
 
         // If the current token matches the expected type, proceed
-        if (strcmp(tokens[currentTokenIndex].type, expectedType) == 0) {
-            currentTokenIndex++;
-            writeParsingState();  // Write state after each successful match
+        if (tokenKind(parser, parser->currentTokenIndex) == expectedType) {
+            parser->currentTokenIndex++;
+            writeParsingDelta(parser);  // Record the consumed token
             return 1;
         }
 
         // Log and skip if optional
         if (isOptional) {
-            printf("Optional token '%s' not found. Skipping...\n", expectedType);
+            LOG_PARSE(parser, "Optional token '%s' not found. Skipping...\n", token_type_to_string(expectedType));
             return 0;
         }
 
         // Otherwise, return failure for mandatory tokens
-        printf("Unexpected token: %s (expected: %s). Stopping.\n", 
-               tokens[currentTokenIndex].type, expectedType);
+        LOG_PARSE(parser, "Unexpected token: %s (expected: %s). Stopping.\n",
+               token_type_to_string(tokenKind(parser, parser->currentTokenIndex)), token_type_to_string(expectedType));
         return 0;
     }
 
-    printf("No more tokens to match (expected: %s)\n", expectedType);
+    LOG_PARSE(parser, "No more tokens to match (expected: %s)\n", token_type_to_string(expectedType));
     return 0;
 }
 
+// Match the current token against a token set and advance if it belongs to it
+int matchAny(Parser* parser, TokenSet set, const char* setName) {
+    if (hasToken(parser, parser->currentTokenIndex)) {
+        LOG_PARSE(parser, "Matching token: %s (expected: %s)\n",
+               token_type_to_string(tokenKind(parser, parser->currentTokenIndex)), setName);
+
+        if (TOKEN_SETS[tokenKind(parser, parser->currentTokenIndex)] & set) {
+            parser->currentTokenIndex++;
+            writeParsingDelta(parser);  // Record the consumed token
+            return 1;
+        }
+
+        LOG_PARSE(parser, "Unexpected token: %s (expected: %s). Stopping.\n",
+               token_type_to_string(tokenKind(parser, parser->currentTokenIndex)), setName);
+        return 0;
+    }
+
+    LOG_PARSE(parser, "No more tokens to match (expected: %s)\n", setName);
+    return 0;
+}
+
+// Type of the token consumed by the last successful match
+TokenType matchedType(Parser* parser) {
+    return tokenKind(parser, parser->currentTokenIndex - 1);
+}
+
+// Source line of the token consumed by the last successful match
+static uint32_t matchedLine(Parser* parser) {
+    return parser->tokens->line[parser->currentTokenIndex - 1 - parser->tokenBase];
+}
+
+
+// Type of the token `offset` positions ahead of the current one
+TokenType peekType(Parser* parser, size_t offset) {
+    size_t index = parser->currentTokenIndex + offset;
+    return hasToken(parser, index) ? tokenKind(parser, index) : TOKEN_EOF;
+}
+
+
+// Kind of token `index`, which must be inside the loaded window
+static TokenType tokenKind(Parser* parser, size_t index) {
+    return (TokenType)parser->tokens->kind[index - parser->tokenBase];
+}
+
+
+// Slide the window of pulled tokens past everything no open mark can
+// rewind to. The token before the current one stays for matchedType().
+static void dropUnreachableTokens(Parser* parser) {
+    // A mark missing from markStack may still rewind to any token
+    if (parser->outOfMemory) return;
+
+    size_t keep = parser->currentTokenIndex ? parser->currentTokenIndex - 1 : 0;
+    if (parser->markDepth > 0 && parser->markStack[0] < keep) keep = parser->markStack[0];
+    if (keep <= parser->tokenBase) return;
+
+    TokenStream* window = &parser->window;
+    size_t drop = keep - parser->tokenBase;
+    size_t kept = parser->token_count - keep;
+    memmove(window->kind, window->kind + drop, kept * sizeof(uint8_t));
+    memmove(window->offset, window->offset + drop, kept * sizeof(uint32_t));
+    memmove(window->length, window->length + drop, kept * sizeof(uint32_t));
+    memmove(window->line, window->line + drop, kept * sizeof(uint32_t));
+    window->count = kept;
+
+    // Literal values are found by slot, so they move down with the tokens
+    size_t firstKept = 0;
+    while (firstKept < window->literal_count && window->literal_index[firstKept] < drop) firstKept++;
+    window->literal_count -= firstKept;
+    parser->literalHint = 0;
+    for (size_t i = 0; i < window->literal_count; i++) {
+        window->literal_value[i] = window->literal_value[firstKept + i];
+        window->literal_index[i] = window->literal_index[firstKept + i] - (uint32_t)drop;
+    }
+
+    // Memo entries are only looked up at the current index, so older ones go too
+    for (int rule = 0; rule < MEMO_RULE_COUNT; rule++) {
+        MemoEntry* table = parser->memoTable[rule];
+        size_t capacity = parser->memoCapacity[rule];
+        if (!table) continue;
+
+        size_t keptEntries = capacity > drop ? capacity - drop : 0;
+        memmove(table, table + (capacity - keptEntries), keptEntries * sizeof(MemoEntry));
+        memset(table + keptEntries, 0, (capacity - keptEntries) * sizeof(MemoEntry));
+    }
+    parser->tokenBase = keep;
+}
+
+
+// Append up to PULL_BATCH tokens from the pull source; 0 once it has ended
+static int pullTokens(Parser* parser) {
+    Token batch[PULL_BATCH];
+    size_t count = parser->pull(parser->pullContext, batch, PULL_BATCH);
+    if (count == 0) {
+        parser->pull = NULL;
+        return 0;
+    }
+
+    TokenStream* window = &parser->window;
+    if (window->count + count > window->capacity) {
+        dropUnreachableTokens(parser);
+
+        // Grow while the live window fills more than half, so each slide
+        // moves fewer tokens than were pulled since the last one
+        size_t needed = window->count + count;
+        if (needed * 2 > window->capacity) {
+            size_t capacity = window->capacity ? window->capacity * 2 : 1024;
+            while (capacity < needed * 2) capacity *= 2;
+            if (!token_stream_reserve(window, capacity)) {
+                parser->pull = NULL;
+                return 0;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        size_t slot = window->count++;
+        window->kind[slot] = (uint8_t)batch[i].type;
+        window->offset[slot] = (uint32_t)batch[i].offset;
+        window->length[slot] = (uint32_t)batch[i].length;
+        window->line[slot] = (uint32_t)batch[i].line_num;
+        if ((batch[i].type == NUM_CONST || batch[i].type == FLOAT_CONST) &&
+            !token_stream_add_value(window, slot, batch[i].value)) {
+            parser->pull = NULL;
+            return 0;
+        }
+    }
+    parser->token_count += count;
+    return 1;
+}
+
+
+// Whether token `index` exists, pulling more tokens if they are streamed in
+static int hasToken(Parser* parser, size_t index) {
+    while (index >= parser->token_count) {
+        if (!parser->pull || !pullTokens(parser)) return 0;
+    }
+    return 1;
+}
+
+
+// Save the parser position before trying an alternative
+ParseMark markParse(Parser* parser) {
+    ParseMark mark = { parser->currentTokenIndex, arena_mark(&parser->treeArena), parser->markDepth };
+
+    if (parser->markDepth == parser->markCapacity) {
+        size_t capacity = parser->markCapacity ? parser->markCapacity * 2 : 64;
+        size_t* stack = realloc(parser->markStack, capacity * sizeof(size_t));
+        if (!stack) {
+            // The mark still works for rewinds; parseLoaded() fails the parse
+            parser->outOfMemory = 1;
+            return mark;
+        }
+        parser->markStack = stack;
+        parser->markCapacity = capacity;
+    }
+    parser->markStack[parser->markDepth++] = mark.tokenIndex;
+    return mark;
+}
+
+
+// Undo a failed alternative: rewind the tokens and drop the nodes it built.
+// The mark stays open for the next alternative; marks opened after it are closed.
+void rewindParse(Parser* parser, ParseMark mark) {
+    parser->currentTokenIndex = mark.tokenIndex;
+    arena_rollback(&parser->treeArena, mark.arena);
+    if (parser->markDepth > mark.depth + 1) parser->markDepth = mark.depth + 1;
+}
+
+
+// Close a mark that will not be rewound to again, together with any
+// marks opened after it, so the tokens it kept can be dropped. Failed
+// alternatives may skip this: the caller's rewind closes their marks.
+void releaseMark(Parser* parser, ParseMark mark) {
+    if (parser->markDepth > mark.depth) parser->markDepth = mark.depth;
+}
+
+
+// Make room for memo entries up to `index`. With all tokens loaded the
+// first call covers the whole input; pulled tokens grow it as they arrive.
+static int growMemoTable(Parser* parser, MemoRule rule, size_t index) {
+    size_t capacity = parser->token_count - parser->tokenBase + 1;
+    if (capacity < parser->memoCapacity[rule] * 2) capacity = parser->memoCapacity[rule] * 2;
+    if (capacity <= index - parser->tokenBase) capacity = index - parser->tokenBase + 1;
+
+    MemoEntry* table = realloc(parser->memoTable[rule], capacity * sizeof(MemoEntry));
+    if (!table) return 0;
+    memset(table + parser->memoCapacity[rule], 0, (capacity - parser->memoCapacity[rule]) * sizeof(MemoEntry));
+    parser->memoTable[rule] = table;
+    parser->memoCapacity[rule] = capacity;
+    return 1;
+}
+
+
+// Packrat memoization: run `parse` at most once per (rule, token index).
+// Cached subtrees are shared, so a hit costs no re-parse or copy.
+TreeNode* memoized(Parser* parser, MemoRule rule, ParseFn parse) {
+    size_t start = parser->currentTokenIndex;
+
+    if (start - parser->tokenBase >= parser->memoCapacity[rule] && !growMemoTable(parser, rule, start)) {
+        return parse(parser);
+    }
+
+    MemoEntry* entry = &parser->memoTable[rule][start - parser->tokenBase];
+    if (entry->state != MEMO_UNKNOWN) {
+        parser->currentTokenIndex = entry->endIndex;
+        return entry->state == MEMO_PARSED ? entry->tree : NULL;
+    }
+
+    TreeNode* result = parse(parser);
+    if (start < parser->tokenBase) return result;  // Slid out of the window; nothing can look it up
+    entry = &parser->memoTable[rule][start - parser->tokenBase];  // parse() may have grown or slid the table
+    entry->endIndex = parser->currentTokenIndex;
+    if (result) {
+        entry->state = MEMO_PARSED;
+        entry->tree = result;
+        arena_protect(&parser->treeArena); // Later rewinds must not free a cached subtree
+    } else {
+        entry->state = MEMO_FAILED;
+    }
+    return result;
+}
+
+
+// Reset the memo for the next parse (the trees live in the arena)
+void freeMemoTable(Parser* parser) {
+    for (int rule = 0; rule < MEMO_RULE_COUNT; rule++) {
+        free(parser->memoTable[rule]);
+        parser->memoTable[rule] = NULL;
+        parser->memoCapacity[rule] = 0;
+    }
+}
+
 
 // Parse tree management
-TreeNode* createNode(const char* value) {
-    TreeNode* node = (TreeNode*)malloc(sizeof(TreeNode));
-    node->value = strdup(value);
-    node->childCount = 0;
+// Returns NULL if the arena is out of memory. The rule that asked for the
+// node then fails like any unmatched rule, and parseLoaded() fails the
+// whole parse.
+static TreeNode* allocNode(Parser* parser, NodeKind kind, size_t size) {
+    TreeNode* node = arena_alloc(&parser->treeArena, size);
+    if (!node) {
+        parser->outOfMemory = 1;
+        return NULL;
+    }
+    node->kind = kind;
     node->children = NULL;
+    node->childCount = 0;
+    node->childCapacity = 0;
+    node->line = 0;
     return node;
 }
 
+// Value of the literal token in `slot`. Terminals are created in token
+// order apart from backtracking, so the last literal found or the one
+// after it is usually the one asked for.
+static TokenValue literalValue(Parser* parser, size_t slot) {
+    const TokenStream* tokens = parser->tokens;
+    size_t literal = parser->literalHint;
+    if (literal >= tokens->literal_count || tokens->literal_index[literal] != slot) {
+        literal++;
+        if (literal >= tokens->literal_count || tokens->literal_index[literal] != slot) {
+            literal = token_stream_find_literal(tokens, slot);
+        }
+    }
+    if (literal == tokens->literal_count) {
+        TokenValue none = { 0 };
+        return none;
+    }
+    parser->literalHint = literal;
+    return tokens->literal_value[literal];
+}
+
+// `kind` is a NodeKind, or for a terminal the TokenType it was matched
+// from. A terminal records the token just matched if that is the token it
+// stands for; the "," of a display list is created late and records none.
+TreeNode* createNode(Parser* parser, unsigned kind) {
+    if (kind >= NODE_SIMPLICITY) {
+        return allocNode(parser, kind, offsetof(TreeNode, token));
+    }
+
+    TreeNode* node = allocNode(parser, kind, sizeof(TreeNode));
+    if (!node) return NULL;
+    memset(&node->token, 0, sizeof(TreeToken));
+    size_t index = parser->currentTokenIndex - 1;
+    if (parser->currentTokenIndex > 0 && tokenKind(parser, index) == (TokenType)kind) {
+        size_t slot = index - parser->tokenBase;
+        node->token.offset = parser->tokens->offset[slot];
+        node->token.length = parser->tokens->length[slot];
+        if (kind == NUM_CONST || kind == FLOAT_CONST) node->token.value = literalValue(parser, slot);
+        node->line = parser->tokens->line[slot];
+    }
+    return node;
+}
 
-void addChild(TreeNode* parent, TreeNode* child) {
-    if (!child) return;
-    parent->children = realloc(parent->children, sizeof(TreeNode*) * (parent->childCount + 1));
+// An operator node is labelled with its TokenType like any terminal, but
+// holds its operands as children
+static TreeNode* createOperatorNode(Parser* parser, TokenType op, uint32_t line) {
+    TreeNode* node = allocNode(parser, (NodeKind)op, offsetof(TreeNode, token));
+    if (node) node->line = line;
+    return node;
+}
+
+
+void addChild(Parser* parser, TreeNode* parent, TreeNode* child) {
+    if (!parent || !child) return;
+
+    // Double the capacity when full, so a list of n children is copied
+    // O(log n) times and the copies add up to less than 2n pointers. The
+    // first array holds two, enough for most nonterminals.
+    if (parent->childCount == parent->childCapacity) {
+        uint32_t capacity = parent->childCapacity ? parent->childCapacity * 2 : 2;
+        TreeNode** children = arena_alloc(&parser->treeArena, sizeof(TreeNode*) * capacity);
+        if (!children) {
+            parser->outOfMemory = 1;
+            return;
+        }
+        if (parent->childCount) memcpy(children, parent->children, sizeof(TreeNode*) * parent->childCount);
+        parent->children = children;
+        parent->childCapacity = capacity;
+    }
     parent->children[parent->childCount++] = child;
-    child->parentID = parent->id;
 }
 
 
-void freeTree(TreeNode* node) {
-    if (!node) return;
-    for (int i = 0; i < node->childCount; i++) {
-        freeTree(node->children[i]);
+// Tree memory belongs to parser->treeArena. Nodes of a failed alternative are
+// reclaimed by rewindParse(), and the rest by releaseTree() after the parse.
+// Release every node of the current parse at once
+void releaseTree(Parser* parser) {
+    arena_release(&parser->treeArena);
+}
+
+
+// Write every text view of the tree in one scan of the array. Each
+// view that is asked for gets its own OutputBuffer:
+//   parsed, csv      one "<id>,<parent id>,<label>" line per node in
+//                    preorder; the root's parent is -1. The line is
+//                    formatted once and copied to both.
+//   parenthesized    one node per line, indented by depth; `ends` holds
+//                    where each open subtree stops, so a node's ")" line
+//                    is written once the scan gets there.
+static void emitTree(const FlatTree* tree, OutputBuffer* parsed, OutputBuffer* csv, OutputBuffer* parenthesized) {
+    // Labels and their lengths by kind; the last entry is "UNKNOWN"
+    const char* labels[NODE_KIND_COUNT + 1];
+    size_t labelLengths[NODE_KIND_COUNT + 1];
+    for (uint32_t kind = 0; kind <= NODE_KIND_COUNT; kind++) {
+        labels[kind] = nodeKindLabel(kind);
+        labelLengths[kind] = strlen(labels[kind]);
+    }
+
+    const uint32_t* parents = flat_tree_parents(tree);
+    uint32_t* ends = NULL;
+    size_t depth = 0;
+    size_t capacity = 0;
+
+    for (uint32_t i = 0; i <= tree->count; i++) {
+        if (parenthesized) {
+            // Close the subtrees that end before node i
+            while (depth > 0 && ends[depth - 1] <= i) {
+                depth--;
+                output_write_repeated(parenthesized, ' ', depth * 2);
+                output_write(parenthesized, ")\n", 2);
+            }
+        }
+        if (i == tree->count) break;
+
+        const FlatNode* node = &tree->nodes[i];
+        uint32_t kind = node->kind < NODE_KIND_COUNT ? node->kind : NODE_KIND_COUNT;
+
+        if (parsed || csv) {
+            char prefix[44];  // "<id>,<parent>," with both at most 10 digits
+            size_t length = output_format_uint(prefix, i);
+            prefix[length++] = ',';
+            if (parents[i] == FLAT_TREE_NO_PARENT) {
+                prefix[length++] = '-';
+                prefix[length++] = '1';
+            } else {
+                length += output_format_uint(prefix + length, parents[i]);
+            }
+            prefix[length++] = ',';
+
+            OutputBuffer* sinks[2] = { parsed, csv };
+            for (int sink = 0; sink < 2; sink++) {
+                if (!sinks[sink]) continue;
+                output_write(sinks[sink], prefix, length);
+                output_write(sinks[sink], labels[kind], labelLengths[kind]);
+                output_write_char(sinks[sink], '\n');
+            }
+        }
+
+        if (parenthesized) {
+            output_write_repeated(parenthesized, ' ', depth * 2);
+            output_write_char(parenthesized, '(');
+            output_write(parenthesized, labels[kind], labelLengths[kind]);
+            if (node->size == 1) {
+                output_write(parenthesized, ")\n", 2);
+                continue;
+            }
+
+            // Children follow on their own lines
+            output_write_char(parenthesized, '\n');
+            if (depth == capacity) {
+                size_t grown = capacity ? capacity * 2 : 64;
+                uint32_t* larger = realloc(ends, grown * sizeof(uint32_t));
+                if (!larger) {
+                    // The open subtrees cannot be tracked, so the view stops here
+                    fprintf(stderr, "Error: out of memory while writing the parenthesized parse tree\n");
+                    parenthesized = NULL;
+                    continue;
+                }
+                ends = larger;
+                capacity = grown;
+            }
+            ends[depth++] = i + node->size;
+        }
+    }
+    free(ends);
+}
+
+// Write the tree to each of the files that is not NULL, in one pass
+void writeTreeOutputs(const FlatTree* tree, FILE* parsed, FILE* csv, FILE* parenthesized) {
+    OutputBuffer buffers[3];
+    FILE* files[3] = { parsed, csv, parenthesized };
+    OutputBuffer* sinks[3];
+    for (int i = 0; i < 3; i++) {
+        sinks[i] = NULL;
+        if (!files[i]) continue;
+        // Flush what the caller wrote so far; it precedes the tree
+        fflush(files[i]);
+        output_buffer_init(&buffers[i], files[i]);
+        sinks[i] = &buffers[i];
+    }
+
+    emitTree(tree, sinks[0], sinks[1], sinks[2]);
+
+    for (int i = 0; i < 3; i++) {
+        if (sinks[i]) output_buffer_free(sinks[i]);
     }
-    free(node->children);
-    free(node->value);
-    free(node);
 }
 
 
-void writeParseTree(FILE* file, TreeNode* node) {
-    if (!node) return;
+static uint32_t countNodes(TreeNode* node) {
+    uint32_t count = 1;
+    for (uint32_t i = 0; i < node->childCount; i++) {
+        count += countNodes(node->children[i]);
+    }
+    return count;
+}
 
-    fprintf(file, "%d,%d,%s\n", node->id, node->parentID, node->value);
-    for (size_t i = 0; i < node->childCount; i++) {
-        writeParseTree(file, node->children[i]);
+// Store the subtree of `node` in preorder from ID `index` on and return
+// the ID after it
+static uint32_t flattenNode(FlatTree* tree, uint32_t index, uint32_t parent, TreeNode* node) {
+    uint32_t next = index + 1;
+    for (uint32_t i = 0; i < node->childCount; i++) {
+        next = flattenNode(tree, next, index, node->children[i]);
     }
+    tree->nodes[index].kind = node->kind;
+    tree->nodes[index].size = next - index;
+    flat_tree_parents(tree)[index] = parent;
+    return next;
+}
+
+// Copy the tree of the last successful parse into one FlatTree block, once.
+// It is freed with the parse tree.
+const FlatTree* flattenParseTree(Parser* parser) {
+    if (parser->flatTree || !parser->tree) return parser->flatTree;
+
+    parser->flatTree = flat_tree_create(countNodes(parser->tree));
+    if (parser->flatTree) flattenNode(parser->flatTree, 0, FLAT_TREE_NO_PARENT, parser->tree);
+    return parser->flatTree;
 }
 
 
 // Parsing functions
-TreeNode* parseSimplicity() {
-    TreeNode* root = createNode("SIMPLICITY");
+TreeNode* parseSimplicity(Parser* parser) {
+    TreeNode* root = createNode(parser, NODE_SIMPLICITY);
 
     // [ { DECL_STMT | FUNC_STMT | ARR_STMT } ]
-    while (currentTokenIndex < token_count) {
-        size_t savedIndex = currentTokenIndex;
-        TreeNode* stmt = NULL;
-
-        // Try parsing each type of statement
-        if ((stmt = parseDeclStmt()) != NULL) {
-            addChild(root, stmt);
-        } else {
-            currentTokenIndex = savedIndex;
-            if ((stmt = parseFuncStmt()) != NULL) {
-                addChild(root, stmt);
-            } else {
-                currentTokenIndex = savedIndex;
-                if ((stmt = parseArrStmt()) != NULL) {
-                    addChild(root, stmt);
-                } else {
-                    // If none of the statements match, break the loop
-                    currentTokenIndex = savedIndex;
-                    break;
-                }
-            }
+    while (hasToken(parser, parser->currentTokenIndex)) {
+        TokenType next = peekType(parser, 0);
+
+        // TYPE_SPEC KW_MAIN starts the main function
+        if (peekType(parser, 1) == KW_MAIN) break;
+
+        ParseMark saved = markParse(parser);
+        ParseFn parse = TOP_LEVEL_TABLE[next];
+        TreeNode* stmt = parse ? parse(parser) : NULL;
+        if (!stmt) {
+            // If none of the statements match, break the loop
+            rewindParse(parser, saved);
+            releaseMark(parser, saved);
+            break;
         }
+        releaseMark(parser, saved);
+        addChild(parser, root, stmt);
     }
 
     // TYPE_SPEC
-    TreeNode* typeSpec = parseTypeSpec();
+    TreeNode* typeSpec = parseTypeSpec(parser);
     if (!typeSpec) {
-        printf("Error: Expected type specifier\n");
-        freeTree(root);
+        LOG_PARSE(parser, "Error: Expected type specifier\n");
         return NULL;
     }
-    addChild(root, typeSpec);
+    addChild(parser, root, typeSpec);
 
     // KW_MAIN
-    if (!match("KW_MAIN",0)) {
-        printf("Error: Expected 'main'\n");
-        freeTree(root);
+    if (!match(parser, KW_MAIN, 0)) {
+        LOG_PARSE(parser, "Error: Expected 'main'\n");
         return NULL;
     }
-    addChild(root, createNode("MAIN"));
+    addChild(parser, root, createNode(parser, NODE_MAIN));
 
     // LEFT_PAREN
-    if (!match("LEFT_PAREN",0)) {
-        printf("Error: Expected '('\n");
-        freeTree(root);
+    if (!match(parser, LEFT_PAREN, 0)) {
+        LOG_PARSE(parser, "Error: Expected '('\n");
         return NULL;
     }
-    addChild(root, createNode("LEFT_PAREN"));
+    addChild(parser, root, createNode(parser, LEFT_PAREN));
 
     // [ ARG_LIST | RW_VOID ]
-    if (match("RW_VOID",1)) {
-        addChild(root, createNode("RW_VOID"));
+    if (match(parser, RW_VOID, 1)) {
+        addChild(parser, root, createNode(parser, RW_VOID));
     } else {
-        TreeNode* args = parseArgList();
+        TreeNode* args = parseArgList(parser);
         if (args) {
-            addChild(root, args);
+            addChild(parser, root, args);
         }
     }
 
     // RIGHT_PAREN
-    if (!match("RIGHT_PAREN",0)) {
-        printf("Error: Expected ')'\n");
-        freeTree(root);
+    if (!match(parser, RIGHT_PAREN, 0)) {
+        LOG_PARSE(parser, "Error: Expected ')'\n");
         return NULL;
     }
-    addChild(root, createNode("RIGHT_PAREN"));
+    addChild(parser, root, createNode(parser, RIGHT_PAREN));
 
     // BLOCK
-    TreeNode* block = parseBlock();
+    TreeNode* block = parseBlock(parser);
     if (!block) {
-        printf("Error: Expected block\n");
-        freeTree(root);
+        LOG_PARSE(parser, "Error: Expected block\n");
         return NULL;
     }
-    addChild(root, block);
+    addChild(parser, root, block);
 
     return root;
 }
 
-TreeNode* parseDeclStmt() {
-    TreeNode* declStmt = createNode("DECL_STMT");
+TreeNode* parseDeclStmt(Parser* parser) {
+    TreeNode* declStmt = createNode(parser, NODE_DECL_STMT);
 
     // Save the current token index to backtrack if needed
-    size_t savedIndex = currentTokenIndex;
+    ParseMark saved = markParse(parser);
 
     // Attempt to parse a variable declaration
-    TreeNode* varDecl = parseVarDecl();
+    TreeNode* varDecl = parseVarDecl(parser);
     if (varDecl) {
-        addChild(declStmt, varDecl);
+        releaseMark(parser, saved);
+        addChild(parser, declStmt, varDecl);
         return declStmt;
     }
-    currentTokenIndex = savedIndex;
+    rewindParse(parser, saved);
 
     // Attempt to parse an array declaration
-    TreeNode* arrDecl = parseArrDecl();
+    TreeNode* arrDecl = parseArrDecl(parser);
     if (arrDecl) {
-        addChild(declStmt, arrDecl);
+        releaseMark(parser, saved);
+        addChild(parser, declStmt, arrDecl);
         return declStmt;
     }
-    currentTokenIndex = savedIndex;
+    rewindParse(parser, saved);
 
     // Attempt to parse a function declaration
-    TreeNode* funcDecl = parseFuncDecl();
+    TreeNode* funcDecl = parseFuncDecl(parser);
     if (funcDecl) {
-        addChild(declStmt, funcDecl);
+        releaseMark(parser, saved);
+        addChild(parser, declStmt, funcDecl);
         return declStmt;
     }
 
     // If none of the declarations match, return NULL
-    freeTree(declStmt);
     return NULL;
 }
 
-TreeNode* parseVarDecl() {
-    TreeNode* varDecl = createNode("VAR_DECL");
+TreeNode* parseVarDecl(Parser* parser) {
+    TreeNode* varDecl = createNode(parser, NODE_VAR_DECL);
 
     // Optional RW_CONSTANT
-    match("RW_CONSTANT", 1); // Pass '1' to indicate optional
+    match(parser, RW_CONSTANT, 1); // Pass '1' to indicate optional
 
     // Optional NW_LET
-    match("NW_LET", 1); // Pass '1' to indicate optional
+    match(parser, NW_LET, 1); // Pass '1' to indicate optional
 
     // TYPE_SPEC (mandatory)
-    TreeNode* typeSpec = parseTypeSpec();
+    TreeNode* typeSpec = parseTypeSpec(parser);
     if (!typeSpec) {
-        printf("Error: Expected TYPE_SPEC\n");
-        freeTree(varDecl); // Cleanup if TYPE_SPEC is missing
+        LOG_PARSE(parser, "Error: Expected TYPE_SPEC\n");
         return NULL;
     }
-    addChild(varDecl, typeSpec);
+    addChild(parser, varDecl, typeSpec);
 
     // ID_LIST or IDENTIFIER (mandatory)
-    TreeNode* idList = parseIdList();
+    TreeNode* idList = parseIdList(parser);
     if (idList) {
-        addChild(varDecl, idList);
-    } else if (match("IDENTIFIER", 0)) {
-        addChild(varDecl, createNode("IDENTIFIER"));
+        addChild(parser, varDecl, idList);
+    } else if (match(parser, IDENTIFIER, 0)) {
+        addChild(parser, varDecl, createNode(parser, IDENTIFIER));
     } else {
-        printf("Error: Expected ID_LIST or IDENTIFIER\n");
-        freeTree(varDecl); // Cleanup if neither ID_LIST nor IDENTIFIER is present
+        LOG_PARSE(parser, "Error: Expected ID_LIST or IDENTIFIER\n");
         return NULL;
     }
 
     // SEMICOLON (mandatory)
-    if (!match("SEMICOLON", 0)) {
-        printf("Error: Expected SEMICOLON\n");
-        freeTree(varDecl); // Cleanup if SEMICOLON is missing
+    if (!match(parser, SEMICOLON, 0)) {
+        LOG_PARSE(parser, "Error: Expected SEMICOLON\n");
         return NULL;
     }
-    addChild(varDecl, createNode("SEMICOLON"));
+    addChild(parser, varDecl, createNode(parser, SEMICOLON));
 
     return varDecl;
 }
 
-TreeNode* parseTypeSpec() {
-    if (match("TYPE_BOOLEAN",0)) return createNode("TYPE_BOOLEAN");
-    if (match("TYPE_CHARACTER",0)) return createNode("TYPE_CHARACTER");
-    if (match("TYPE_FLOAT",0)) return createNode("TYPE_FLOAT");
-    if (match("TYPE_INTEGER",0)) return createNode("TYPE_INTEGER");
-    if (match("TYPE_STRING",0)) return createNode("TYPE_STRING");
+TreeNode* parseTypeSpec(Parser* parser) {
+    if (matchAny(parser, SET_TYPE_SPEC, "TYPE_SPEC")) return createNode(parser, matchedType(parser));
     return NULL;
 }
 
-TreeNode* parseIdList() {
-    TreeNode* idList = createNode("ID_LIST");
+TreeNode* parseIdList(Parser* parser) {
+    TreeNode* idList = createNode(parser, NODE_ID_LIST);
 
     // Parse the first IDENTIFIER
-    if (!match("IDENTIFIER",0)) {
-        freeTree(idList); // Cleanup if no IDENTIFIER is found
+    if (!match(parser, IDENTIFIER, 0)) {
         return NULL;
     }
-    addChild(idList, createNode("IDENTIFIER"));
+    addChild(parser, idList, createNode(parser, IDENTIFIER));
 
     // Optionally parse ASSIGN after the first IDENTIFIER
-    TreeNode* assign = parseAssign();
+    TreeNode* assign = parseAssign(parser);
     if (assign) {
-        addChild(idList, assign);
+        addChild(parser, idList, assign);
     }
 
     // Parse zero or more {COMMA IDENTIFIER [ASSIGN]}
-    while (match("COMMA",0)) {
-        TreeNode* commaNode = createNode("COMMA");
-        addChild(idList, commaNode);
+    while (match(parser, COMMA, 0)) {
+        TreeNode* commaNode = createNode(parser, COMMA);
+        addChild(parser, idList, commaNode);
 
         // Ensure an IDENTIFIER follows the COMMA
-        if (!match("IDENTIFIER",0)) {
-            freeTree(idList); // Cleanup if no IDENTIFIER follows COMMA
+        if (!match(parser, IDENTIFIER, 0)) {
             return NULL;
         }
-        addChild(idList, createNode("IDENTIFIER"));
+        addChild(parser, idList, createNode(parser, IDENTIFIER));
 
         // Optionally parse ASSIGN after this IDENTIFIER
-        assign = parseAssign();
+        assign = parseAssign(parser);
         if (assign) {
-            addChild(idList, assign);
+            addChild(parser, idList, assign);
         }
     }
 
     return idList;
 }
 
-TreeNode* parseAssign() {
-    TreeNode* assign = createNode("ASSIGN");
+TreeNode* parseAssign(Parser* parser) {
+    TreeNode* assign = createNode(parser, NODE_ASSIGN);
 
     // Ensure the ASSIGN_OP token is present
-    if (!match("ASSIGN_OP",0)) {
-        freeTree(assign); // Cleanup if ASSIGN_OP is missing
+    if (!match(parser, ASSIGN_OP, 0)) {
         return NULL;
     }
-    addChild(assign, createNode("ASSIGN_OP"));
+    addChild(parser, assign, createNode(parser, ASSIGN_OP));
 
     // Check for RW_NULL
-    if (match("RW_NULL",0)) {
-        addChild(assign, createNode("RW_NULL"));
+    if (match(parser, RW_NULL, 0)) {
+        addChild(parser, assign, createNode(parser, RW_NULL));
         return assign;
     }
 
     // Check for STR_CONST
-    if (match("STR_CONST",0)) {
-        addChild(assign, createNode("STR_CONST"));
+    if (match(parser, STR_CONST, 0)) {
+        addChild(parser, assign, createNode(parser, STR_CONST));
         return assign;
     }
 
     // Check for CHAR_CONST
-    if (match("CHAR_CONST",0)) {
-        addChild(assign, createNode("CHAR_CONST"));
+    if (match(parser, CHAR_CONST, 0)) {
+        addChild(parser, assign, createNode(parser, CHAR_CONST));
         return assign;
     }
 
     // Check for ASSIGNMENT followed by ARITH_EXP
-    TreeNode* assignment = parseAssignment();
+    TreeNode* assignment = parseAssignment(parser);
     if (assignment) {
-        addChild(assign, assignment);
+        addChild(parser, assign, assignment);
 
-        TreeNode* arithExp = parseArithExp();
+        TreeNode* arithExp = parseArithExp(parser);
         if (arithExp) {
-            addChild(assign, arithExp);
+            addChild(parser, assign, arithExp);
             return assign;
-        } else {
-            // Cleanup if ARITH_EXP is missing
-            freeTree(assign);
-            // return NULL;
         }
+        // Without an ARITH_EXP the other forms are still tried
     }
 
     // Check for BOOL_EXP
-    TreeNode* boolExp = parseBoolExp();
+    TreeNode* boolExp = parseBoolExp(parser);
     if (boolExp) {
-        addChild(assign, boolExp);
+        addChild(parser, assign, boolExp);
         return assign;
     }
 
-    // If none of the options matched, cleanup and return NULL
-    // freeTree(assign);
+    // If none of the options matched, the node is returned as it is
     return assign;
 }
 
-TreeNode* parseBoolExp() {
-    // Create the root node for BOOL_EXP
-    TreeNode* boolExp = createNode("BOOL_EXP");
-
-    // Attempt to parse the first BOOL_TERM
-    TreeNode* boolTerm = parseBoolTerm();
-    if (!boolTerm) {
-        freeTree(boolExp); // Cleanup if BOOL_TERM is missing
-        return NULL;
-    }
-    addChild(boolExp, boolTerm);
-
-    // Check for repeated LOG_OR BOOL_TERM (right-recursive rule)
-    while (match("LOG_OR",0)) {
-        // Add the LOG_OR operator as a child
-        addChild(boolExp, createNode("LOG_OR"));
-
-        // Parse the next BOOL_TERM
-        TreeNode* nextBoolTerm = parseBoolTerm();
-        if (!nextBoolTerm) {
-            freeTree(boolExp); // Cleanup if BOOL_TERM is missing after LOG_OR
-            return NULL;
-        }
-        addChild(boolExp, nextBoolTerm);
-    }
-
-    return boolExp;
+TreeNode* parseBoolExp(Parser* parser) {
+    return parseOperatorExp(parser, PREC_OR, 1);
 }
 
-TreeNode* parseBoolTerm() {
-    // Create the root node for BOOL_TERM
-    TreeNode* boolTerm = createNode("BOOL_TERM");
-
-    // Attempt to parse the first BOOL_FACTOR
-    TreeNode* boolFactor = parseBoolFactor();
-    if (!boolFactor) {
-        freeTree(boolTerm); // Cleanup if BOOL_FACTOR is missing
-        return NULL;
-    }
-    addChild(boolTerm, boolFactor);
-
-    // Check for repeated LOG_AND BOOL_FACTOR (right-recursive rule)
-    while (match("LOG_AND",0)) {
-        // Add the LOG_AND operator as a child
-        addChild(boolTerm, createNode("LOG_AND"));
-
-        // Parse the next BOOL_FACTOR
-        TreeNode* nextBoolFactor = parseBoolFactor();
-        if (!nextBoolFactor) {
-            freeTree(boolTerm); // Cleanup if BOOL_FACTOR is missing after LOG_AND
-            return NULL;
-        }
-        addChild(boolTerm, nextBoolFactor);
-    }
-
-    return boolTerm;
+TreeNode* parseArithExp(Parser* parser) {
+    return parseOperatorExp(parser, PREC_ADD, 0);
 }
 
-TreeNode* parseBoolFactor() {
-    
-    printf("================================== BOOLFACTOR");
-    // Create the root node for BOOL_FACTOR
-    TreeNode* boolFactor = createNode("BOOL_FACTOR");
-
-    // Case 1: LOG_NOT BOOL_FACTOR
-    if (match("LOG_NOT",0)) {
-        addChild(boolFactor, createNode("LOG_NOT"));
-
-        TreeNode* nextBoolFactor = parseBoolFactor();
-        if (nextBoolFactor) {
-            addChild(boolFactor, nextBoolFactor);
-            return boolFactor;
-        } else {
-            // Cleanup if BOOL_FACTOR is missing after LOG_NOT
-            freeTree(boolFactor);
-            return NULL;
-        }
-    }
-
-    // Case 2: REL_EXP
-    TreeNode* relExp = parseRelExp();
-    if (relExp) {
-        addChild(boolFactor, relExp);
-        return boolFactor;
-    }
-
-    printf("================================== BACK TO BOOLFACT");
-    // Case 3: LEFT_PAREN BOOL_EXP RIGHT_PAREN
-    if (match("LEFT_PAREN",0)) {
-        addChild(boolFactor, createNode("LEFT_PAREN"));
-
-        TreeNode* boolExp = parseBoolExp();
-        if (!boolExp) {
-            // Cleanup if BOOL_EXP is missing after LEFT_PAREN
-            freeTree(boolFactor);
-            return NULL;
-        }
-        addChild(boolFactor, boolExp);
-
-        if (!match("RIGHT_PAREN",0)) {
-            // Cleanup if RIGHT_PAREN is missing
-            freeTree(boolFactor);
-            return NULL;
-        }
-        addChild(boolFactor, createNode("RIGHT_PAREN"));
-        return boolFactor;
-    }
-
-    printf("================================== BACK TO BOOLFACT");
-    // Case 4: ARITH_EXP
-    TreeNode* arithExp = parseArithExp();
-    if (arithExp) {
-        addChild(boolFactor, arithExp);
-        return boolFactor;
-    }
-
-    // Case 5: BOOL_LITERAL
-    if (match("BOOL_LITERAL",0)) {
-        addChild(boolFactor, createNode("BOOL_LITERAL"));
-        return boolFactor;
-    }
-
-    // Case 6: IDENTIFIER
-    if (match("IDENTIFIER",0)) {
-        addChild(boolFactor, createNode("IDENTIFIER"));
-        return boolFactor;
-    }
-
-    // If none of the options match, cleanup and return NULL
-    freeTree(boolFactor);
-    return NULL;
+// Parse one expression, or leave the position and the tree arena as they
+// were if there is none
+static TreeNode* parseOperatorExp(Parser* parser, int minPrecedence, int boolean) {
+    ParseMark saved = markParse(parser);
+    TreeNode* exp = parseOperators(parser, minPrecedence, boolean);
+    if (!exp) rewindParse(parser, saved);
+    releaseMark(parser, saved);
+    return exp;
 }
 
-TreeNode* parseRelExp() {
-    
-    printf("================================== RELEXP");
-    // Create the root node for REL_EXP
-    TreeNode* relExp = createNode("REL_EXP");
-
-    // Attempt to parse the first ARITH_EXP
-    TreeNode* firstArithExp = parseArithExp();
-    if (firstArithExp) {
-        // freeTree(relExp); // Cleanup if the first ARITH_EXP is missing
-        // return NULL;
-        addChild(relExp, firstArithExp);
-    }
-
-    printf("================================== REL_OP");
-    // Attempt to parse REL_OP
-    TreeNode* relOp = parseRelOp();
-    
-    if (!relOp) {
-        freeTree(relExp); // Cleanup if REL_OP is missing
-        return NULL;
-    }
-    addChild(relExp, relOp);
-
-    printf("================================== 2ND ARITH");
-    // Attempt to parse the second ARITH_EXP
-    TreeNode* secondArithExp = parseArithExp();
-    
-    if (!secondArithExp) {
-        freeTree(relExp); // Cleanup if the second ARITH_EXP is missing
-        return NULL;
-    }
-    addChild(relExp, secondArithExp);
-
-    return relExp;
-}
+// Precedence climbing: parse an operand, then fold in every binary
+// operator binding at least as tightly as minPrecedence. Each operator
+// becomes one node whose two children are its operands.
+static TreeNode* parseOperators(Parser* parser, int minPrecedence, int boolean) {
+    TreeNode* left = parseOperand(parser, boolean);
 
-TreeNode* parseArithExp() { 
-    
-    printf("================================== ARITH");
-    // Create the root node for ARITH_EXP
-    TreeNode* arithExp = createNode("ARITH_EXP");
+    while (left) {
+        TokenType op = peekType(parser, 0);
+        int precedence = BINARY_PRECEDENCE[op];
+        if (precedence == PREC_NONE || precedence < minPrecedence) break;
+        match(parser, op, 0);
+        uint32_t line = matchedLine(parser);
 
-    // Attempt to parse the first TERM
-    TreeNode* term = parseTerm();
-    if (!term) {
-        freeTree(arithExp); // Cleanup if TERM is missing
-        return NULL;
-    }
-    addChild(arithExp, term);
-    printf("Done with first term ===================");
-    // Parse { ADDMIN_OP TERM }
-    
-    while (1) {
-        printf("Done with first term ===================");
-        // Check if ADDMIN_OP is present
-        TreeNode* addMinOp = parseAddMinOp();
-        if (!addMinOp) {
-            break; // Exit the loop if no ADDMIN_OP is found
-        }
+        // EXPO_OP groups to the right, every other operator to the left
+        TreeNode* right = parseOperators(parser, op == EXPO_OP ? precedence : precedence + 1, boolean);
+        if (!right) return NULL;
 
-        // Add ADDMIN_OP to the tree
-        addChild(arithExp, addMinOp);
+        TreeNode* node = createOperatorNode(parser, op, line);
+        addChild(parser, node, left);
+        addChild(parser, node, right);
+        left = node;
 
-        // Parse the next TERM
-        TreeNode* nextTerm = parseTerm();
-        if (!nextTerm) {
-            freeTree(arithExp); // Cleanup if TERM is missing after ADDMIN_OP
-            return NULL;
-        }
-        addChild(arithExp, nextTerm);
+        // Comparisons do not chain: a < b < c is no expression
+        if (precedence == PREC_REL && BINARY_PRECEDENCE[peekType(parser, 0)] == PREC_REL) return NULL;
     }
-
-    return arithExp;
+    return left;
 }
 
-TreeNode* parseAddMinOp() {
-    if (match("ADD_OP",0)) return createNode("ADD_OP");
-    if (match("SUB_OP",0)) return createNode("SUB_OP"); 
-    return NULL;
-}
+// An operand is a literal, an identifier, an UPDATE or a parenthesized
+// expression. Boolean expressions also allow BOOL_CONST and LOG_NOT.
+static TreeNode* parseOperand(Parser* parser, int boolean) {
+    TokenType next = peekType(parser, 0);
+    switch (next) {
+        case IDENTIFIER:
+            if (TOKEN_SETS[peekType(parser, 1)] & SET_UPDATE_OP) return parseUpdate(parser);
+            match(parser, IDENTIFIER, 0);
+            return createNode(parser, IDENTIFIER);
 
-TreeNode* parseTerm() {
+        case UNARY_INC:
+        case UNARY_DEC:
+            return parseUpdate(parser);
 
-    printf("================================== TERM");
-    // Create the root node for TERM
-    TreeNode* term = createNode("TERM");
+        case NUM_CONST:
+        case FLOAT_CONST:
+            match(parser, next, 0);
+            return createNode(parser, next);
 
-    // Attempt to parse the first FACTOR
-    TreeNode* factor = parseFactor();
-    if (!factor) {
-        freeTree(term); // Cleanup if FACTOR is missing
-        return NULL;
-    }
-    addChild(term, factor);
-
-    
-    printf("===================================== done first TERM");
-    // Parse { MULDIV_OP FACTOR }
-    while (1) {
-        // Check if MULDIV_OP is present
-        TreeNode* mulDivOp = parseMulDivOp();
-        if (!mulDivOp) {
-            break; // Exit the loop if no MULDIV_OP is found
+        case LEFT_PAREN: {
+            match(parser, LEFT_PAREN, 0);
+            TreeNode* inner = parseOperators(parser, boolean ? PREC_OR : PREC_ADD, boolean);
+            if (!inner || !match(parser, RIGHT_PAREN, 0)) return NULL;
+            return inner;
         }
 
-        // Add MULDIV_OP to the tree
-        addChild(term, mulDivOp);
-
-        // Parse the next FACTOR
-        TreeNode* nextFactor = parseFactor();
-        if (!nextFactor) {
-            freeTree(term); // Cleanup if FACTOR is missing after MULDIV_OP
-            return NULL;
-        }
-        addChild(term, nextFactor);
-    }
-
-    return term;
-}
-
-TreeNode* parseFactor() {
-    printf("================================== FACTOR");
-    // Create the root node for FACTOR
-    TreeNode* factor = createNode("FACTOR");
-
-    // Attempt to parse the BASE
-    TreeNode* base = parseBase();
-    if (!base) {
-        freeTree(factor); // Cleanup if BASE is missing
-        return NULL;
-    }
-    addChild(factor, base);
-
-
-    printf("================================== done parse base");
-    // Parse { EXPO_OP FACTOR }
-    while (1) {
-        // Check if EXPO_OP (terminal) is present
-        if (!match("EXPO_OP",1)) {
-            break; // Exit the loop if no EXPO_OP is found
-        }
-
-        // Add EXPO_OP to the tree
-        TreeNode* expoOp = createNode("EXPO_OP");
-        addChild(factor, expoOp);
-
-        // Parse the next FACTOR
-        TreeNode* nextFactor = parseFactor();
-        if (!nextFactor) {
-            freeTree(factor); // Cleanup if FACTOR is missing after EXPO_OP
-            return NULL;
-        }
-        addChild(factor, nextFactor);
-    }
-
-    return factor;
-}
-
-TreeNode* parseBase() { 
-    printf("================================== BASE");
-    // Create the root node for BASE
-    TreeNode* base = createNode("BASE");
-
-    // Handle the case: LEFT_PAREN ARITH_EXP RIGHT_PAREN
-    if (match("LEFT_PAREN",0)) {
-        TreeNode* leftParen = createNode("LEFT_PAREN");
-        addChild(base, leftParen);
-
-        TreeNode* arithExp = parseArithExp();
-        if (!arithExp) {
-            freeTree(base); // Cleanup if ARITH_EXP is missing
-            return NULL;
+        case BOOL_CONST:
+            if (!boolean) return NULL;
+            match(parser, BOOL_CONST, 0);
+            return createNode(parser, BOOL_CONST);
+
+        case LOG_NOT: {
+            if (!boolean) return NULL;
+            match(parser, LOG_NOT, 0);
+            uint32_t line = matchedLine(parser);
+
+            // ! binds looser than a comparison: !a < b negates a < b
+            TreeNode* operand = parseOperators(parser, PREC_REL, boolean);
+            if (!operand) return NULL;
+            TreeNode* node = createOperatorNode(parser, LOG_NOT, line);
+            addChild(parser, node, operand);
+            return node;
         }
-        addChild(base, arithExp);
 
-        if (!match("RIGHT_PAREN",0)) {
-            freeTree(base); // Cleanup if RIGHT_PAREN is missing
+        default:
             return NULL;
-        }
-        TreeNode* rightParen = createNode("RIGHT_PAREN");
-        addChild(base, rightParen);
-
-        return base;
-    }
-
-    // Handle the case: UPDATE
-    TreeNode* update = parseUpdate();
-    if (update) {
-        addChild(base, update);
-        return base;
     }
-
-    // Handle the case: IDENTIFIER
-    if (match("IDENTIFIER",0)) {
-        TreeNode* identifier = createNode("IDENTIFIER");
-        addChild(base, identifier);
-        return base;
-    }
-
-    // Handle the case: NUM_CONST
-    if (match("NUM_CONST",0)) {
-        TreeNode* numConst = createNode("NUM_CONST");
-        addChild(base, numConst);
-        return base;
-    }
-
-    // Handle the case: FLOAT_CONST
-    if (match("FLOAT_CONST",0)) {
-        TreeNode* floatConst = createNode("FLOAT_CONST");
-        addChild(base, floatConst);
-        return base;
-    }
-
-    // If none of the cases match, return NULL
-    freeTree(base);
-    return NULL;
 }
 
-TreeNode* parseUpdate() { 
+TreeNode* parseUpdate(Parser* parser) { 
     // Create the root node for UPDATE
-    TreeNode* update = createNode("UPDATE");
+    TreeNode* update = createNode(parser, NODE_UPDATE);
 
     // Handle the case: IDENTIFIER UPDATE_OP
-    if (match("IDENTIFIER",0)) {
-        TreeNode* identifier = createNode("IDENTIFIER");
-        addChild(update, identifier);
+    if (match(parser, IDENTIFIER, 0)) {
+        TreeNode* identifier = createNode(parser, IDENTIFIER);
+        addChild(parser, update, identifier);
 
-        TreeNode* updateOp = parseUpdateOp();
+        TreeNode* updateOp = parseUpdateOp(parser);
         if (!updateOp) {
-            freeTree(update); // Cleanup if UPDATE_OP is missing
             return NULL;
         }
-        addChild(update, updateOp);
+        addChild(parser, update, updateOp);
         return update;
     }
 
     // Handle the case: UPDATE_OP IDENTIFIER
-    TreeNode* updateOp = parseUpdateOp();
+    TreeNode* updateOp = parseUpdateOp(parser);
     if (updateOp) {
-        addChild(update, updateOp);
+        addChild(parser, update, updateOp);
 
-        if (match("IDENTIFIER",0)) {
-            TreeNode* identifier = createNode("IDENTIFIER");
-            addChild(update, identifier);
+        if (match(parser, IDENTIFIER, 0)) {
+            TreeNode* identifier = createNode(parser, IDENTIFIER);
+            addChild(parser, update, identifier);
             return update;
         }
     }
 
-    // If neither case matches, cleanup and return NULL
-    freeTree(update);
-    return NULL;
-}
-
-TreeNode* parseUpdateOp() {
-    // Create the root node for UPDATE_OP
-    TreeNode* updateOp = createNode("UPDATE_OP");
-
-    // Check for UNARY_INC
-    if (match("UNARY_INC",0)) {
-        TreeNode* unaryInc = createNode("UNARY_INC");
-        addChild(updateOp, unaryInc);
-        return updateOp;
-    }
-
-    // Check for UNARY_DEC
-    if (match("UNARY_DEC",0)) {
-        TreeNode* unaryDec = createNode("UNARY_DEC");
-        addChild(updateOp, unaryDec);
-        return updateOp;
-    }
-
-    // If neither token matches, cleanup and return NULL
-    freeTree(updateOp);
+    // If neither case matches, return NULL
     return NULL;
 }
 
-TreeNode* parseMulDivOp() {
-    // Create the root node for MULDIV_OP
-    TreeNode* mulDivOp = createNode("MULDIV_OP");
-
-    // Check for each possible operator
-    if (match("MUL_OP",0)) {
-        TreeNode* mulOp = createNode("MUL_OP");
-        addChild(mulDivOp, mulOp);
-        return mulDivOp;
-    }
-    if (match("DIV_OP",0)) {
-        TreeNode* divOp = createNode("DIV_OP");
-        addChild(mulDivOp, divOp);
-        return mulDivOp;
-    }
-    if (match("INTDIV_OP",0)) {
-        TreeNode* intDivOp = createNode("INTDIV_OP");
-        addChild(mulDivOp, intDivOp);
-        return mulDivOp;
-    }
-    if (match("MOD_OP",0)) {
-        TreeNode* modOp = createNode("MOD_OP");
-        addChild(mulDivOp, modOp);
-        return mulDivOp;
+TreeNode* parseUpdateOp(Parser* parser) {
+    // Check for UNARY_INC or UNARY_DEC
+    if (!matchAny(parser, SET_UPDATE_OP, "UPDATE_OP")) {
+        return NULL;
     }
 
-    // If no match, cleanup and return NULL
-    freeTree(mulDivOp);
-    return NULL;
+    // Create the root node for UPDATE_OP
+    TreeNode* updateOp = createNode(parser, NODE_UPDATE_OP);
+    addChild(parser, updateOp, createNode(parser, matchedType(parser)));
+    return updateOp;
 }
 
-TreeNode* parseRelOp() {
-    // Create the root node for REL_OP
-    TreeNode* relOp = createNode("REL_OP");
-
-    // Check for each possible relational operator
-    if (match("REL_LT",0)) {
-        TreeNode* relLt = createNode("REL_LT");
-        addChild(relOp, relLt);
-        return relOp;
-    }
-    if (match("REL_GT",0)) {
-        TreeNode* relGt = createNode("REL_GT");
-        addChild(relOp, relGt);
-        return relOp;
-    }
-    if (match("REL_LE",0)) {
-        TreeNode* relLe = createNode("REL_LE");
-        addChild(relOp, relLe);
-        return relOp;
-    }
-    if (match("REL_GE",0)) {
-        TreeNode* relGe = createNode("REL_GE");
-        addChild(relOp, relGe);
-        return relOp;
-    }
-    if (match("REL_EQ",0)) {
-        TreeNode* relEq = createNode("REL_EQ");
-        addChild(relOp, relEq);
-        return relOp;
-    }
-    if (match("REL_NEQ",0)) {
-        TreeNode* relNeq = createNode("REL_NEQ");
-        addChild(relOp, relNeq);
-        return relOp;
+TreeNode* parseBoolLiteral(Parser* parser) {
+    // Check for BOOL_CONST
+    if (!match(parser, BOOL_CONST, 0)) {
+        return NULL;
     }
 
-    // If no match, cleanup and return NULL
-    freeTree(relOp);
-    return NULL;
-}
-
-TreeNode* parseBoolLiteral() {
     // Create the root node for BOOL_LITERAL
-    TreeNode* boolLiteral = createNode("BOOL_LITERAL");
+    TreeNode* boolLiteral = createNode(parser, NODE_BOOL_LITERAL);
+    addChild(parser, boolLiteral, createNode(parser, BOOL_CONST));
+    return boolLiteral;
+}
 
-    // Check for BOOL_CONST
-    if (match("BOOL_CONST",0)) {
-        TreeNode* boolConst = createNode("BOOL_CONST");
-        addChild(boolLiteral, boolConst);
-        return boolLiteral;
+TreeNode* parseAssignment(Parser* parser) {
+    // Check for any assignment operator
+    if (!matchAny(parser, SET_ASSIGNMENT_OP, "ASSIGNMENT")) {
+        return NULL;
     }
 
-    // If no match, cleanup and return NULL
-    freeTree(boolLiteral);
-    return NULL;
-}
-
-TreeNode* parseAssignment() {
     // Create the root node for ASSIGNMENT
-    TreeNode* assignment = createNode("ASSIGNMENT");
-
-    // Check for each possible assignment operator
-    if (match("ASSIGN_OP",0)) {
-        TreeNode* assignOp = createNode("ASSIGN_OP");
-        addChild(assignment, assignOp);
-        return assignment;
-    }
-    if (match("ADD_ASSIGN",0)) {
-        TreeNode* addAssign = createNode("ADD_ASSIGN");
-        addChild(assignment, addAssign);
-        return assignment;
-    }
-    if (match("SUB_ASSIGN",0)) {
-        TreeNode* subAssign = createNode("SUB_ASSIGN");
-        addChild(assignment, subAssign);
-        return assignment;
-    }
-    if (match("MUL_ASSIGN",0)) {
-        TreeNode* mulAssign = createNode("MUL_ASSIGN");
-        addChild(assignment, mulAssign);
-        return assignment;
-    }
-    if (match("DIV_ASSIGN",0)) {
-        TreeNode* divAssign = createNode("DIV_ASSIGN");
-        addChild(assignment, divAssign);
-        return assignment;
-    }
-    if (match("INTDIV_ASSIGN",0)) {
-        TreeNode* intDivAssign = createNode("INTDIV_ASSIGN");
-        addChild(assignment, intDivAssign);
-        return assignment;
-    }
-    if (match("MOD_ASSIGN",0)) {
-        TreeNode* modAssign = createNode("MOD_ASSIGN");
-        addChild(assignment, modAssign);
-        return assignment;
-    }
-
-    // If no match, cleanup and return NULL
-    freeTree(assignment);
-    return NULL;
+    TreeNode* assignment = createNode(parser, NODE_ASSIGNMENT);
+    addChild(parser, assignment, createNode(parser, matchedType(parser)));
+    return assignment;
 }
 
-TreeNode* parseArrDecl() {
+TreeNode* parseArrDecl(Parser* parser) {
     // Create the root node for ARR_DECL
-    TreeNode* arrDecl = createNode("ARR_DECL");
+    TreeNode* arrDecl = createNode(parser, NODE_ARR_DECL);
 
     // Optional RW_CONSTANT
-    if (match("RW_CONSTANT",1)) {
-        TreeNode* rwConstant = createNode("RW_CONSTANT");
-        addChild(arrDecl, rwConstant);
+    if (match(parser, RW_CONSTANT, 1)) {
+        TreeNode* rwConstant = createNode(parser, RW_CONSTANT);
+        addChild(parser, arrDecl, rwConstant);
     }
 
     // Parse TYPE_SPEC
-    TreeNode* typeSpec = parseTypeSpec();
+    TreeNode* typeSpec = parseTypeSpec(parser);
     if (!typeSpec) {
-        freeTree(arrDecl); // Cleanup if TYPE_SPEC is missing
         return NULL;
     }
-    addChild(arrDecl, typeSpec);
+    addChild(parser, arrDecl, typeSpec);
 
     // Parse IDENTIFIER
-    if (match("IDENTIFIER",0)) {
-        TreeNode* identifier = createNode("IDENTIFIER");
-        addChild(arrDecl, identifier);
+    if (match(parser, IDENTIFIER, 0)) {
+        TreeNode* identifier = createNode(parser, IDENTIFIER);
+        addChild(parser, arrDecl, identifier);
     } else {
-        freeTree(arrDecl); // Cleanup if IDENTIFIER is missing
         return NULL;
     }
 
     // Parse LEFT_BRACKET
-    if (match("LEFT_BRACKET",0)) {
-        TreeNode* leftBracket = createNode("LEFT_BRACKET");
-        addChild(arrDecl, leftBracket);
+    if (match(parser, LEFT_BRACKET, 0)) {
+        TreeNode* leftBracket = createNode(parser, LEFT_BRACKET);
+        addChild(parser, arrDecl, leftBracket);
     } else {
-        freeTree(arrDecl); // Cleanup if LEFT_BRACKET is missing
         return NULL;
     }
 
     // Parse NUM_CONST
-    if (match("NUM_CONST",0)) {
-        TreeNode* numConst = createNode("NUM_CONST");
-        addChild(arrDecl, numConst);
+    if (match(parser, NUM_CONST, 0)) {
+        TreeNode* numConst = createNode(parser, NUM_CONST);
+        addChild(parser, arrDecl, numConst);
     } else {
-        freeTree(arrDecl); // Cleanup if NUM_CONST is missing
         return NULL;
     }
 
     // Parse RIGHT_BRACKET
-    if (match("RIGHT_BRACKET",0)) {
-        TreeNode* rightBracket = createNode("RIGHT_BRACKET");
-        addChild(arrDecl, rightBracket);
+    if (match(parser, RIGHT_BRACKET, 0)) {
+        TreeNode* rightBracket = createNode(parser, RIGHT_BRACKET);
+        addChild(parser, arrDecl, rightBracket);
     } else {
-        freeTree(arrDecl); // Cleanup if RIGHT_BRACKET is missing
         return NULL;
     }
 
     // Parse SEMICOLON
-    if (match("SEMICOLON",0)) {
-        TreeNode* semicolon = createNode("SEMICOLON");
-        addChild(arrDecl, semicolon);
+    if (match(parser, SEMICOLON, 0)) {
+        TreeNode* semicolon = createNode(parser, SEMICOLON);
+        addChild(parser, arrDecl, semicolon);
         return arrDecl;
     } else {
-        freeTree(arrDecl); // Cleanup if SEMICOLON is missing
         return NULL;
     }
 }
 
-TreeNode* parseFuncDecl() {
+TreeNode* parseFuncDecl(Parser* parser) {
     // Create the root node for FUNC_DECL
-    TreeNode* funcDecl = createNode("FUNC_DECL");
+    TreeNode* funcDecl = createNode(parser, NODE_FUNC_DECL);
 
     // Parse TYPE_SPEC or RW_VOID
-    if (match("RW_VOID",1)) {
-        TreeNode* rwVoid = createNode("RW_VOID");
-        addChild(funcDecl, rwVoid);
+    if (match(parser, RW_VOID, 1)) {
+        TreeNode* rwVoid = createNode(parser, RW_VOID);
+        addChild(parser, funcDecl, rwVoid);
     } else {
-        TreeNode* typeSpec = parseTypeSpec();
+        TreeNode* typeSpec = parseTypeSpec(parser);
         if (!typeSpec) {
-            freeTree(funcDecl); // Cleanup if neither RW_VOID nor TYPE_SPEC is found
             return NULL;
         }
-        addChild(funcDecl, typeSpec);
+        addChild(parser, funcDecl, typeSpec);
     }
 
     // Parse IDENTIFIER
-    if (match("IDENTIFIER",0)) {
-        TreeNode* identifier = createNode("IDENTIFIER");
-        addChild(funcDecl, identifier);
+    if (match(parser, IDENTIFIER, 0)) {
+        TreeNode* identifier = createNode(parser, IDENTIFIER);
+        addChild(parser, funcDecl, identifier);
     } else {
-        freeTree(funcDecl); // Cleanup if IDENTIFIER is missing
         return NULL;
     }
 
     // Parse LEFT_PAREN
-    if (match("LEFT_PAREN",0)) {
-        TreeNode* leftParen = createNode("LEFT_PAREN");
-        addChild(funcDecl, leftParen);
+    if (match(parser, LEFT_PAREN, 0)) {
+        TreeNode* leftParen = createNode(parser, LEFT_PAREN);
+        addChild(parser, funcDecl, leftParen);
     } else {
-        freeTree(funcDecl); // Cleanup if LEFT_PAREN is missing
         return NULL;
     }
 
     // Parse PARAM_LIST
-    TreeNode* paramList = parseParamList();
+    TreeNode* paramList = parseParamList(parser);
     if (!paramList) {
-        freeTree(funcDecl); // Cleanup if PARAM_LIST is missing
         return NULL;
     }
-    addChild(funcDecl, paramList);
+    addChild(parser, funcDecl, paramList);
 
     // Parse RIGHT_PAREN
-    if (match("RIGHT_PAREN",0)) {
-        TreeNode* rightParen = createNode("RIGHT_PAREN");
-        addChild(funcDecl, rightParen);
+    if (match(parser, RIGHT_PAREN, 0)) {
+        TreeNode* rightParen = createNode(parser, RIGHT_PAREN);
+        addChild(parser, funcDecl, rightParen);
     } else {
-        freeTree(funcDecl); // Cleanup if RIGHT_PAREN is missing
         return NULL;
     }
 
     // Parse SEMICOLON
-    if (match("SEMICOLON",0)) {
-        TreeNode* semicolon = createNode("SEMICOLON");
-        addChild(funcDecl, semicolon);
+    if (match(parser, SEMICOLON, 0)) {
+        TreeNode* semicolon = createNode(parser, SEMICOLON);
+        addChild(parser, funcDecl, semicolon);
         return funcDecl; // Successfully parsed FUNC_DECL
     } else {
-        freeTree(funcDecl); // Cleanup if SEMICOLON is missing
         return NULL;
     }
 }
 
-TreeNode* parseParamList() {
+TreeNode* parseParamList(Parser* parser) {
     // Create the root node for PARAM_LIST
-    TreeNode* paramList = createNode("PARAM_LIST");
+    TreeNode* paramList = createNode(parser, NODE_PARAM_LIST);
 
     // Parse the first PARAM
-    TreeNode* param = parseParam();
+    TreeNode* param = parseParam(parser);
     if (!param) {
-        freeTree(paramList); // Cleanup if the first PARAM is missing
         return NULL;
     }
-    addChild(paramList, param);
+    addChild(parser, paramList, param);
 
     // Handle the recursive rule: { COMMA PARAM }
-    while (match("COMMA",0)) {
+    while (match(parser, COMMA, 0)) {
         // Add COMMA as a child
-        TreeNode* comma = createNode("COMMA");
-        addChild(paramList, comma);
+        TreeNode* comma = createNode(parser, COMMA);
+        addChild(parser, paramList, comma);
 
         // Parse the next PARAM
-        param = parseParam();
+        param = parseParam(parser);
         if (!param) {
-            freeTree(paramList); // Cleanup if PARAM is missing after a COMMA
             return NULL;
         }
-        addChild(paramList, param);
+        addChild(parser, paramList, param);
     }
 
     return paramList; // Successfully parsed PARAM_LIST
 }
 
-TreeNode* parseParam() {
+TreeNode* parseParam(Parser* parser) {
     // Create the root node for PARAM
-    TreeNode* param = createNode("PARAM");
+    TreeNode* param = createNode(parser, NODE_PARAM);
 
     // Attempt to parse TYPE_SPEC IDENTIFIER
-    TreeNode* typeSpec = parseTypeSpec();
+    TreeNode* typeSpec = parseTypeSpec(parser);
     if (typeSpec) {
-        addChild(param, typeSpec);
+        addChild(parser, param, typeSpec);
 
-        if (match("IDENTIFIER",0)) {
-            TreeNode* identifier = createNode("IDENTIFIER");
-            addChild(param, identifier);
+        if (match(parser, IDENTIFIER, 0)) {
+            TreeNode* identifier = createNode(parser, IDENTIFIER);
+            addChild(parser, param, identifier);
             return param; // Successfully parsed TYPE_SPEC IDENTIFIER
         } else {
-            freeTree(param); // Cleanup if IDENTIFIER is missing
             return NULL;
         }
     }
 
     // Attempt to parse ARR_DECL
-    TreeNode* arrDecl = parseArrDecl();
+    TreeNode* arrDecl = parseArrDecl(parser);
     if (arrDecl) {
-        addChild(param, arrDecl);
+        addChild(parser, param, arrDecl);
         return param; // Successfully parsed ARR_DECL
     }
 
-    // If neither rule matches, clean up and return NULL
-    freeTree(param);
+    // If neither rule matches, return NULL
     return NULL;
 }
 
-TreeNode* parseFuncStmt() {
+TreeNode* parseFuncStmt(Parser* parser) {
     // Create the root node for FUNC_STMT
-    TreeNode* funcStmt = createNode("FUNC_STMT");
+    TreeNode* funcStmt = createNode(parser, NODE_FUNC_STMT);
 
     // Attempt to parse FUNC_CALL
-    TreeNode* funcCall = parseFuncCall();
+    TreeNode* funcCall = parseFuncCall(parser);
     if (funcCall) {
-        addChild(funcStmt, funcCall);
+        addChild(parser, funcStmt, funcCall);
         return funcStmt; // Successfully parsed FUNC_CALL
     }
 
     // Attempt to parse FUNC_DEF
-    TreeNode* funcDef = parseFuncDef();
+    TreeNode* funcDef = parseFuncDef(parser);
     if (funcDef) {
-        addChild(funcStmt, funcDef);
+        addChild(parser, funcStmt, funcDef);
         return funcStmt; // Successfully parsed FUNC_DEF
     }
 
-    // If neither FUNC_CALL nor FUNC_DEF matches, clean up and return NULL
-    freeTree(funcStmt);
+    // If neither FUNC_CALL nor FUNC_DEF matches, return NULL
     return NULL;
 }
 
-TreeNode* parseFuncCall() {
+TreeNode* parseFuncCall(Parser* parser) {
     // Create the root node for FUNC_CALL
-    TreeNode* funcCall = createNode("FUNC_CALL");
+    TreeNode* funcCall = createNode(parser, NODE_FUNC_CALL);
 
     // Match IDENTIFIER
-    if (match("IDENTIFIER",0)) {
-        TreeNode* identifier = createNode("IDENTIFIER");
-        addChild(funcCall, identifier);
+    if (match(parser, IDENTIFIER, 0)) {
+        TreeNode* identifier = createNode(parser, IDENTIFIER);
+        addChild(parser, funcCall, identifier);
 
         // Match LEFT_PAREN
-        if (match("LEFT_PAREN",0)) {
-            TreeNode* leftParen = createNode("LEFT_PAREN");
-            addChild(funcCall, leftParen);
+        if (match(parser, LEFT_PAREN, 0)) {
+            TreeNode* leftParen = createNode(parser, LEFT_PAREN);
+            addChild(parser, funcCall, leftParen);
 
             // Parse ARG_LIST
-            TreeNode* argList = parseArgList();
+            TreeNode* argList = parseArgList(parser);
             if (argList) {
-                addChild(funcCall, argList);
+                addChild(parser, funcCall, argList);
 
                 // Match RIGHT_PAREN
-                if (match("RIGHT_PAREN",0)) {
-                    TreeNode* rightParen = createNode("RIGHT_PAREN");
-                    addChild(funcCall, rightParen);
+                if (match(parser, RIGHT_PAREN, 0)) {
+                    TreeNode* rightParen = createNode(parser, RIGHT_PAREN);
+                    addChild(parser, funcCall, rightParen);
 
                     // Match SEMICOLON
-                    if (match("SEMICOLON",0)) {
-                        TreeNode* semicolon = createNode("SEMICOLON");
-                        addChild(funcCall, semicolon);
+                    if (match(parser, SEMICOLON, 0)) {
+                        TreeNode* semicolon = createNode(parser, SEMICOLON);
+                        addChild(parser, funcCall, semicolon);
                         return funcCall; // Successfully parsed FUNC_CALL
                     }
                 }
@@ -1280,687 +1687,680 @@ TreeNode* parseFuncCall() {
         }
     }
 
-    // If any part fails, clean up and return NULL
-    freeTree(funcCall);
+    // If any part fails, return NULL
     return NULL;
 }
 
-TreeNode* parseArgList() {
+TreeNode* parseArgList(Parser* parser) {
     // Create the root node for ARG_LIST
-    TreeNode* argList = createNode("ARG_LIST");
+    TreeNode* argList = createNode(parser, NODE_ARG_LIST);
 
     // Parse the first EXP
-    TreeNode* exp = parseExp();
+    TreeNode* exp = parseExp(parser);
     if (!exp) {
-        freeTree(argList); // Cleanup if no EXP is found
         return NULL;
     }
-    addChild(argList, exp);
+    addChild(parser, argList, exp);
 
     // Parse optional { , EXP } sequence
-    while (match("COMMA",0)) {
-        TreeNode* comma = createNode("COMMA");
-        addChild(argList, comma);
+    while (match(parser, COMMA, 0)) {
+        TreeNode* comma = createNode(parser, COMMA);
+        addChild(parser, argList, comma);
 
         // Parse the next EXP
-        exp = parseExp();
+        exp = parseExp(parser);
         if (!exp) {
-            freeTree(argList); // Cleanup if EXP after COMMA is missing
             return NULL;
         }
-        addChild(argList, exp);
+        addChild(parser, argList, exp);
     }
 
     return argList; // Successfully parsed ARG_LIST
 }
 
-TreeNode* parseExp() {
+TreeNode* parseExp(Parser* parser) {
     // Create the root node for EXP
-    TreeNode* exp = createNode("EXP");
+    TreeNode* exp = createNode(parser, NODE_EXP);
 
-    // Attempt to parse ARITH_EXP
-    TreeNode* arithExp = parseArithExp();
-    if (arithExp) {
-        addChild(exp, arithExp);
-        return exp; // Successfully parsed ARITH_EXP
-    }
-
-    // Attempt to parse BOOL_EXP
-    TreeNode* boolExp = parseBoolExp();
+    // BOOL_EXP covers ARITH_EXP, so one parse decides
+    TreeNode* boolExp = parseBoolExp(parser);
     if (boolExp) {
-        addChild(exp, boolExp);
-        return exp; // Successfully parsed BOOL_EXP
+        addChild(parser, exp, boolExp);
+        return exp;
     }
 
-    // If neither ARITH_EXP nor BOOL_EXP matches, clean up and return NULL
-    freeTree(exp);
+    // If no expression matches, return NULL
     return NULL;
 }
 
-TreeNode* parseFuncDef() {
+TreeNode* parseFuncDef(Parser* parser) {
     // Create the root node for FUNC_DEF
-    TreeNode* funcDef = createNode("FUNC_DEF");
+    TreeNode* funcDef = createNode(parser, NODE_FUNC_DEF);
 
     // Parse TYPE_SPEC
-    TreeNode* typeSpec = parseTypeSpec();
+    TreeNode* typeSpec = parseTypeSpec(parser);
     if (!typeSpec) {
-        freeTree(funcDef);
         return NULL; // TYPE_SPEC is mandatory
     }
-    addChild(funcDef, typeSpec);
+    addChild(parser, funcDef, typeSpec);
 
     // Match IDENTIFIER
-    if (!match("IDENTIFIER",0)) {
-        freeTree(funcDef);
+    if (!match(parser, IDENTIFIER, 0)) {
         return NULL; // IDENTIFIER is mandatory
     }
-    TreeNode* identifier = createNode("IDENTIFIER");
-    addChild(funcDef, identifier);
+    TreeNode* identifier = createNode(parser, IDENTIFIER);
+    addChild(parser, funcDef, identifier);
 
     // Match LEFT_PAREN
-    if (!match("LEFT_PAREN",0)) {
-        freeTree(funcDef);
+    if (!match(parser, LEFT_PAREN, 0)) {
         return NULL; // LEFT_PAREN is mandatory
     }
-    TreeNode* leftParen = createNode("LEFT_PAREN");
-    addChild(funcDef, leftParen);
+    TreeNode* leftParen = createNode(parser, LEFT_PAREN);
+    addChild(parser, funcDef, leftParen);
 
     // Parse PARAM_LIST
-    TreeNode* paramList = parseParamList();
+    TreeNode* paramList = parseParamList(parser);
     if (!paramList) {
-        freeTree(funcDef);
         return NULL; // PARAM_LIST is mandatory
     }
-    addChild(funcDef, paramList);
+    addChild(parser, funcDef, paramList);
 
     // Match RIGHT_PAREN
-    if (!match("RIGHT_PAREN",0)) {
-        freeTree(funcDef);
+    if (!match(parser, RIGHT_PAREN, 0)) {
         return NULL; // RIGHT_PAREN is mandatory
     }
-    TreeNode* rightParen = createNode("RIGHT_PAREN");
-    addChild(funcDef, rightParen);
+    TreeNode* rightParen = createNode(parser, RIGHT_PAREN);
+    addChild(parser, funcDef, rightParen);
 
     // Parse BLOCK
-    TreeNode* block = parseBlock();
+    TreeNode* block = parseBlock(parser);
     if (!block) {
-        freeTree(funcDef);
         return NULL; // BLOCK is mandatory
     }
-    addChild(funcDef, block);
+    addChild(parser, funcDef, block);
 
     // Return the successfully parsed FUNC_DEF node
     return funcDef;
 }
 
-TreeNode* parseBlock() {
+TreeNode* parseBlock(Parser* parser) {
+    return memoized(parser, MEMO_BLOCK, parseBlockRule);
+}
+
+TreeNode* parseBlockRule(Parser* parser) {
     // Create the root node for BLOCK
-    TreeNode* block = createNode("BLOCK");
+    TreeNode* block = createNode(parser, NODE_BLOCK);
 
     // Match LEFT_CURLY
-    if (!match("LEFT_CURLY",0)) {
-        freeTree(block);
+    if (!match(parser, LEFT_CURLY, 0)) {
         return NULL; // LEFT_CURLY is mandatory
     }
-    TreeNode* leftCurly = createNode("LEFT_CURLY");
-    addChild(block, leftCurly);
+    TreeNode* leftCurly = createNode(parser, LEFT_CURLY);
+    addChild(parser, block, leftCurly);
 
     // Parse STMT_LIST
-    TreeNode* stmtList = parseStmtList();
+    TreeNode* stmtList = parseStmtList(parser);
     if (!stmtList) {
-        freeTree(block);
         return NULL; // STMT_LIST is mandatory
     }
-    addChild(block, stmtList);
+    addChild(parser, block, stmtList);
 
     // Parse optional [RETURN_STMT | KW_BREAK | KW_CONTINUE]
-    if (match("KW_BREAK",1)) {
-        TreeNode* kwBreak = createNode("KW_BREAK");
-        addChild(block, kwBreak);
-    } else if (match("KW_CONTINUE",1)) {
-        TreeNode* kwContinue = createNode("KW_CONTINUE");
-        addChild(block, kwContinue);
+    if (match(parser, KW_BREAK, 1)) {
+        TreeNode* kwBreak = createNode(parser, KW_BREAK);
+        addChild(parser, block, kwBreak);
+    } else if (match(parser, KW_CONTINUE, 1)) {
+        TreeNode* kwContinue = createNode(parser, KW_CONTINUE);
+        addChild(parser, block, kwContinue);
     } else {
-        TreeNode* returnStmt = parseReturnStmt();
+        TreeNode* returnStmt = parseReturnStmt(parser);
         if (returnStmt) {
-            addChild(block, returnStmt);
+            addChild(parser, block, returnStmt);
         }
     }
 
     // Parse optional [NW_END]
-    if (match("NW_END",1)) {
-        TreeNode* nwEnd = createNode("NW_END");
-        addChild(block, nwEnd);
+    if (match(parser, NW_END, 1)) {
+        TreeNode* nwEnd = createNode(parser, NW_END);
+        addChild(parser, block, nwEnd);
     }
 
     // Match RIGHT_CURLY
-    if (!match("RIGHT_CURLY",0)) {
-        freeTree(block);
+    if (!match(parser, RIGHT_CURLY, 0)) {
         return NULL; // RIGHT_CURLY is mandatory
     }
-    TreeNode* rightCurly = createNode("RIGHT_CURLY");
-    addChild(block, rightCurly);
+    TreeNode* rightCurly = createNode(parser, RIGHT_CURLY);
+    addChild(parser, block, rightCurly);
 
     // Return the successfully parsed BLOCK node
     return block;
 }
 
-TreeNode* parseStmtList() {
+TreeNode* parseStmtList(Parser* parser) {
     // Create the root node for STMT_LIST
-    TreeNode* stmtList = createNode("STMT_LIST");
+    TreeNode* stmtList = createNode(parser, NODE_STMT_LIST);
 
     // Parse the first mandatory STMT
-    TreeNode* stmt = parseStmt();
+    TreeNode* stmt = parseStmt(parser);
     if (!stmt) {
-        freeTree(stmtList);
         return NULL; // At least one STMT is mandatory
     }
-    addChild(stmtList, stmt);
+    addChild(parser, stmtList, stmt);
 
     // Parse zero or more additional STMTs
     while (1) {
         // Try parsing another STMT
-        stmt = parseStmt();
+        stmt = parseStmt(parser);
         if (!stmt) break; // Stop if no more STMTs are found
-        addChild(stmtList, stmt);
+        addChild(parser, stmtList, stmt);
     }
 
     // Return the successfully parsed STMT_LIST node
     return stmtList;
 }
 
-TreeNode* parseStmt() {
-    // Attempt to parse DECL_STMT
-    TreeNode* stmt = parseDeclStmt();
-    if (stmt) return stmt;
-
-    // Attempt to parse ASSIGN_STMT
-    stmt = parseAssignStmt();
-    if (stmt) return stmt;
+TreeNode* parseStmt(Parser* parser) {
+    // Pick the statement from the current token instead of trying all eight
+    ParseFn parse = STMT_TABLE[peekType(parser, 0)];
+    if (!parse) return NULL;
 
-    // Attempt to parse ARR_STMT
-    stmt = parseArrStmt();
-    if (stmt) return stmt;
+    ParseMark saved = markParse(parser);
+    TreeNode* stmt = parse(parser);
+    if (!stmt) rewindParse(parser, saved);
+    releaseMark(parser, saved);
+    return stmt;
+}
 
-    // Attempt to parse COND_STMT
-    stmt = parseCondStmt();
-    if (stmt) return stmt;
+// TYPE_SPEC starts a declaration, an array initialization or a function
+// definition. They only differ after the identifier, so try them in order.
+TreeNode* parseTypedStmt(Parser* parser) {
+    ParseMark saved = markParse(parser);
 
-    // Attempt to parse ITER_STMT
-    stmt = parseIterStmt();
-    if (stmt) return stmt;
+    TreeNode* stmt = parseDeclStmt(parser);
+    if (!stmt) {
+        rewindParse(parser, saved);
+        stmt = parseArrStmt(parser);
+    }
+    if (!stmt) {
+        rewindParse(parser, saved);
+        stmt = parseFuncStmt(parser);
+    }
+    if (!stmt) rewindParse(parser, saved);
 
-    // Attempt to parse FUNC_STMT
-    stmt = parseFuncStmt();
-    if (stmt) return stmt;
+    releaseMark(parser, saved);
+    return stmt;
+}
 
-    // Attempt to parse OUTPUT_STMT
-    stmt = parseOutputStmt();
-    if (stmt) return stmt;
+// NW_LET TYPE_SPEC ... declares a variable, NW_LET IDENTIFIER ... assigns one
+TreeNode* parseLetStmt(Parser* parser) {
+    if (peekType(parser, 1) == IDENTIFIER) return parseAssignStmt(parser);
+    return parseDeclStmt(parser);
+}
 
-    // Attempt to parse INPUT_STMT
-    stmt = parseInputStmt();
-    if (stmt) return stmt;
+// IDENTIFIER starts an assignment, an input, a call or an array assignment
+TreeNode* parseIdentifierStmt(Parser* parser) {
+    switch (peekType(parser, 1)) {
+        case LEFT_PAREN:
+            return parseFuncStmt(parser);
+        case LEFT_BRACKET:
+            return parseArrStmt(parser);
+        case ASSIGN_OP:
+            if (peekType(parser, 2) == KW_INPUT) return parseInputStmt(parser);
+            return parseAssignStmt(parser);
+        default:
+            return parseAssignStmt(parser);
+    }
+}
 
-    // If no valid statement was found, return NULL
-    return NULL;
+// Before main an IDENTIFIER can only start a call or an array assignment
+TreeNode* parseTopIdentifierStmt(Parser* parser) {
+    switch (peekType(parser, 1)) {
+        case LEFT_PAREN:
+            return parseFuncStmt(parser);
+        case LEFT_BRACKET:
+            return parseArrStmt(parser);
+        default:
+            return NULL;
+    }
 }
 
-TreeNode* parseAssignStmt() {
-    printf("===================================== ASSIGN");
+TreeNode* parseAssignStmt(Parser* parser) {
+    LOG_PARSE(parser, "===================================== ASSIGN");
     // Create the root node for ASSIGN_STMT
-    TreeNode* assignStmt = createNode("ASSIGN_STMT");
+    TreeNode* assignStmt = createNode(parser, NODE_ASSIGN_STMT);
 
     // Optional NW_LET
-    if (match("NW_LET",1)) {
-        TreeNode* nwLet = createNode("NW_LET");
-        addChild(assignStmt, nwLet);
+    if (match(parser, NW_LET, 1)) {
+        TreeNode* nwLet = createNode(parser, NW_LET);
+        addChild(parser, assignStmt, nwLet);
     }
 
 
-    printf("===================================== MATCH IDENTIFIER");
+    LOG_PARSE(parser, "===================================== MATCH IDENTIFIER");
     // Match IDENTIFIER
-    if (!match("IDENTIFIER",0)) {
-        freeTree(assignStmt);
+    if (!match(parser, IDENTIFIER, 0)) {
         return NULL; // IDENTIFIER is mandatory
     }
-    TreeNode* identifier = createNode("IDENTIFIER");
-    addChild(assignStmt, identifier);
+    TreeNode* identifier = createNode(parser, IDENTIFIER);
+    addChild(parser, assignStmt, identifier);
 
-    printf("===================================== ASSIGN");
+    LOG_PARSE(parser, "===================================== ASSIGN");
     // Parse ASSIGN (nonterminal)
-    TreeNode* assign = parseAssign();
+    TreeNode* assign = parseAssign(parser);
     if (!assign) {
-        freeTree(assignStmt);
         return NULL; // ASSIGN is mandatory
     }
-    addChild(assignStmt, assign);
+    addChild(parser, assignStmt, assign);
 
 
-    printf("===================================== SEMICOLON");
+    LOG_PARSE(parser, "===================================== SEMICOLON");
     // Match SEMICOLON
-    if (!match("SEMICOLON",0)) {
-        freeTree(assignStmt);
+    if (!match(parser, SEMICOLON, 0)) {
         return NULL; // SEMICOLON is mandatory
     }
-    TreeNode* semicolon = createNode("SEMICOLON");
-    addChild(assignStmt, semicolon);
+    TreeNode* semicolon = createNode(parser, SEMICOLON);
+    addChild(parser, assignStmt, semicolon);
 
     // Return the successfully parsed ASSIGN_STMT node
     return assignStmt;
 }
 
-TreeNode* parseArrStmt() {
+TreeNode* parseArrStmt(Parser* parser) {
     // Create the root node for ARR_STMT
-    TreeNode* arrStmt = createNode("ARR_STMT");
+    TreeNode* arrStmt = createNode(parser, NODE_ARR_STMT);
 
     // Attempt to parse ARR_ASSIGN
-    TreeNode* arrAssign = parseArrAssign();
+    TreeNode* arrAssign = parseArrAssign(parser);
     if (arrAssign) {
-        addChild(arrStmt, arrAssign);
+        addChild(parser, arrStmt, arrAssign);
         return arrStmt;
     }
 
     // Attempt to parse ARR_INIT
-    TreeNode* arrInit = parseArrInit();
+    TreeNode* arrInit = parseArrInit(parser);
     if (arrInit) {
-        addChild(arrStmt, arrInit);
+        addChild(parser, arrStmt, arrInit);
         return arrStmt;
     }
 
     // If neither ARR_ASSIGN nor ARR_INIT matched, free the node and return NULL
-    freeTree(arrStmt);
     return NULL;
 }
 
-TreeNode* parseArrAssign() {
+TreeNode* parseArrAssign(Parser* parser) {
     // Create the root node for ARR_ASSIGN
-    TreeNode* arrAssign = createNode("ARR_ASSIGN");
+    TreeNode* arrAssign = createNode(parser, NODE_ARR_ASSIGN);
 
     // Parse ARR_ACCESS (nonterminal)
-    TreeNode* arrAccess = parseArrAccess();
+    TreeNode* arrAccess = parseArrAccess(parser);
     if (!arrAccess) {
-        freeTree(arrAssign);
         return NULL; // ARR_ACCESS is mandatory
     }
-    addChild(arrAssign, arrAccess);
+    addChild(parser, arrAssign, arrAccess);
 
     // Parse ASSIGN (nonterminal)
-    TreeNode* assign = parseAssign();
+    TreeNode* assign = parseAssign(parser);
     if (!assign) {
-        freeTree(arrAssign);
         return NULL; // ASSIGN is mandatory
     }
-    addChild(arrAssign, assign);
+    addChild(parser, arrAssign, assign);
 
     // Match SEMICOLON
-    if (!match("SEMICOLON",0)) {
-        freeTree(arrAssign);
+    if (!match(parser, SEMICOLON, 0)) {
         return NULL; // SEMICOLON is mandatory
     }
-    TreeNode* semicolon = createNode("SEMICOLON");
-    addChild(arrAssign, semicolon);
+    TreeNode* semicolon = createNode(parser, SEMICOLON);
+    addChild(parser, arrAssign, semicolon);
 
     // Return the successfully parsed ARR_ASSIGN node
     return arrAssign;
 }
 
-TreeNode* parseArrAccess() {
+TreeNode* parseArrAccess(Parser* parser) {
     // Create the root node for ARR_ACCESS
-    TreeNode* arrAccess = createNode("ARR_ACCESS");
+    TreeNode* arrAccess = createNode(parser, NODE_ARR_ACCESS);
 
     // Match IDENTIFIER
-    if (!match("IDENTIFIER",0)) {
-        freeTree(arrAccess);
+    if (!match(parser, IDENTIFIER, 0)) {
         return NULL; // IDENTIFIER is mandatory
     }
-    TreeNode* identifier = createNode("IDENTIFIER");
-    addChild(arrAccess, identifier);
+    TreeNode* identifier = createNode(parser, IDENTIFIER);
+    addChild(parser, arrAccess, identifier);
 
     // Match LEFT_BRACKET
-    if (!match("LEFT_BRACKET",0)) {
-        freeTree(arrAccess);
+    if (!match(parser, LEFT_BRACKET, 0)) {
         return NULL; // LEFT_BRACKET is mandatory
     }
-    TreeNode* leftBracket = createNode("LEFT_BRACKET");
-    addChild(arrAccess, leftBracket);
+    TreeNode* leftBracket = createNode(parser, LEFT_BRACKET);
+    addChild(parser, arrAccess, leftBracket);
 
     // Parse ARITH_EXP (nonterminal)
-    TreeNode* arithExp = parseArithExp();
+    TreeNode* arithExp = parseArithExp(parser);
     if (!arithExp) {
-        freeTree(arrAccess);
         return NULL; // ARITH_EXP is mandatory
     }
-    addChild(arrAccess, arithExp);
+    addChild(parser, arrAccess, arithExp);
 
     // Match RIGHT_BRACKET
-    if (!match("RIGHT_BRACKET",0)) {
-        freeTree(arrAccess);
+    if (!match(parser, RIGHT_BRACKET, 0)) {
         return NULL; // RIGHT_BRACKET is mandatory
     }
-    TreeNode* rightBracket = createNode("RIGHT_BRACKET");
-    addChild(arrAccess, rightBracket);
+    TreeNode* rightBracket = createNode(parser, RIGHT_BRACKET);
+    addChild(parser, arrAccess, rightBracket);
 
     // Return the successfully parsed ARR_ACCESS node
     return arrAccess;
 }
 
-TreeNode* parseArrInit() {
+TreeNode* parseArrInit(Parser* parser) {
     // Create the root node for ARR_INIT
-    TreeNode* arrInit = createNode("ARR_INIT");
+    TreeNode* arrInit = createNode(parser, NODE_ARR_INIT);
 
     // Parse TYPE_SPEC (nonterminal)
-    TreeNode* typeSpec = parseTypeSpec();
+    TreeNode* typeSpec = parseTypeSpec(parser);
     if (!typeSpec) {
-        freeTree(arrInit);
         return NULL; // TYPE_SPEC is mandatory
     }
-    addChild(arrInit, typeSpec);
+    addChild(parser, arrInit, typeSpec);
 
     // Match IDENTIFIER
-    if (!match("IDENTIFIER",0)) {
-        freeTree(arrInit);
+    if (!match(parser, IDENTIFIER, 0)) {
         return NULL; // IDENTIFIER is mandatory
     }
-    TreeNode* identifier = createNode("IDENTIFIER");
-    addChild(arrInit, identifier);
+    TreeNode* identifier = createNode(parser, IDENTIFIER);
+    addChild(parser, arrInit, identifier);
 
     // Match LEFT_BRACKET
-    if (!match("LEFT_BRACKET",0)) {
-        freeTree(arrInit);
+    if (!match(parser, LEFT_BRACKET, 0)) {
         return NULL; // LEFT_BRACKET is mandatory
     }
-    TreeNode* leftBracket1 = createNode("LEFT_BRACKET");
-    addChild(arrInit, leftBracket1);
+    TreeNode* leftBracket1 = createNode(parser, LEFT_BRACKET);
+    addChild(parser, arrInit, leftBracket1);
 
     // Match NUM_CONST
-    if (!match("NUM_CONST",0)) {
-        freeTree(arrInit);
+    if (!match(parser, NUM_CONST, 0)) {
         return NULL; // NUM_CONST is mandatory
     }
-    TreeNode* numConst = createNode("NUM_CONST");
-    addChild(arrInit, numConst);
+    TreeNode* numConst = createNode(parser, NUM_CONST);
+    addChild(parser, arrInit, numConst);
 
     // Match RIGHT_BRACKET
-    if (!match("RIGHT_BRACKET",0)) {
-        freeTree(arrInit);
+    if (!match(parser, RIGHT_BRACKET, 0)) {
         return NULL; // RIGHT_BRACKET is mandatory
     }
-    TreeNode* rightBracket1 = createNode("RIGHT_BRACKET");
-    addChild(arrInit, rightBracket1);
+    TreeNode* rightBracket1 = createNode(parser, RIGHT_BRACKET);
+    addChild(parser, arrInit, rightBracket1);
 
     // Match ASSIGN_OP
-    if (!match("ASSIGN_OP",0)) {
-        freeTree(arrInit);
+    if (!match(parser, ASSIGN_OP, 0)) {
         return NULL; // ASSIGN_OP is mandatory
     }
-    TreeNode* assignOp = createNode("ASSIGN_OP");
-    addChild(arrInit, assignOp);
+    TreeNode* assignOp = createNode(parser, ASSIGN_OP);
+    addChild(parser, arrInit, assignOp);
 
     // Match LEFT_BRACKET
-    if (!match("LEFT_BRACKET",0)) {
-        freeTree(arrInit);
+    if (!match(parser, LEFT_BRACKET, 0)) {
         return NULL; // LEFT_BRACKET is mandatory
     }
-    TreeNode* leftBracket2 = createNode("LEFT_BRACKET");
-    addChild(arrInit, leftBracket2);
+    TreeNode* leftBracket2 = createNode(parser, LEFT_BRACKET);
+    addChild(parser, arrInit, leftBracket2);
 
     // Parse ARR_LIST (nonterminal)
-    TreeNode* arrList = parseArrList();
+    TreeNode* arrList = parseArrList(parser);
     if (!arrList) {
-        freeTree(arrInit);
         return NULL; // ARR_LIST is mandatory
     }
-    addChild(arrInit, arrList);
+    addChild(parser, arrInit, arrList);
 
     // Match RIGHT_BRACKET
-    if (!match("RIGHT_BRACKET",0)) {
-        freeTree(arrInit);
+    if (!match(parser, RIGHT_BRACKET, 0)) {
         return NULL; // RIGHT_BRACKET is mandatory
     }
-    TreeNode* rightBracket2 = createNode("RIGHT_BRACKET");
-    addChild(arrInit, rightBracket2);
+    TreeNode* rightBracket2 = createNode(parser, RIGHT_BRACKET);
+    addChild(parser, arrInit, rightBracket2);
 
     // Match SEMICOLON
-    if (!match("SEMICOLON",0)) {
-        freeTree(arrInit);
+    if (!match(parser, SEMICOLON, 0)) {
         return NULL; // SEMICOLON is mandatory
     }
-    TreeNode* semicolon = createNode("SEMICOLON");
-    addChild(arrInit, semicolon);
+    TreeNode* semicolon = createNode(parser, SEMICOLON);
+    addChild(parser, arrInit, semicolon);
 
     // Return the successfully parsed ARR_INIT node
     return arrInit;
 }
 
-TreeNode* parseArrList() {
+TreeNode* parseArrList(Parser* parser) {
     // Create the root node for ARR_LIST
-    TreeNode* arrList = createNode("ARR_LIST");
+    TreeNode* arrList = createNode(parser, NODE_ARR_LIST);
 
     // Parse the first ARR_ELEM (mandatory)
-    TreeNode* arrElem = parseArrElem();
+    TreeNode* arrElem = parseArrElem(parser);
     if (!arrElem) {
-        freeTree(arrList);
         return NULL; // ARR_ELEM is mandatory
     }
-    addChild(arrList, arrElem);
+    addChild(parser, arrList, arrElem);
 
     // Parse any additional ARR_ELEM separated by COMMA
-    while (match("COMMA",0)) {
-        TreeNode* comma = createNode("COMMA");
-        addChild(arrList, comma);
+    while (match(parser, COMMA, 0)) {
+        TreeNode* comma = createNode(parser, COMMA);
+        addChild(parser, arrList, comma);
 
         // Parse the next ARR_ELEM
-        TreeNode* nextArrElem = parseArrElem();
+        TreeNode* nextArrElem = parseArrElem(parser);
         if (!nextArrElem) {
-            freeTree(arrList);
             return NULL; // If there's a COMMA, ARR_ELEM is mandatory
         }
-        addChild(arrList, nextArrElem);
+        addChild(parser, arrList, nextArrElem);
     }
 
     // Return the successfully parsed ARR_LIST node
     return arrList;
 }
 
-TreeNode* parseArrElem() {
+TreeNode* parseArrElem(Parser* parser) {
     // Try to parse ARR_ACCESS (nonterminal)
-    TreeNode* arrAccess = parseArrAccess();
+    TreeNode* arrAccess = parseArrAccess(parser);
     if (arrAccess) {
         return arrAccess; // If ARR_ACCESS is valid, return it
     }
 
     // Match BOOL_LITERAL (nonterminal)
-    TreeNode* boolLiteral = parseBoolLiteral();
+    TreeNode* boolLiteral = parseBoolLiteral(parser);
     if (boolLiteral) {
         return boolLiteral; // If BOOL_LITERAL is valid, return it
     }
 
     // Match IDENTIFIER (terminal)
-    if (match("IDENTIFIER",0)) {
-        return createNode("IDENTIFIER");
+    if (match(parser, IDENTIFIER, 0)) {
+        return createNode(parser, IDENTIFIER);
     }
 
     // Match NUM_CONST (terminal)
-    if (match("NUM_CONST",0)) {
-        return createNode("NUM_CONST");
+    if (match(parser, NUM_CONST, 0)) {
+        return createNode(parser, NUM_CONST);
     }
 
     // Match CHAR_CONST (terminal)
-    if (match("CHAR_CONST",0)) {
-        return createNode("CHAR_CONST");
+    if (match(parser, CHAR_CONST, 0)) {
+        return createNode(parser, CHAR_CONST);
     }
 
     // Match STR_CONST (terminal)
-    if (match("STR_CONST",0)) {
-        return createNode("STR_CONST");
+    if (match(parser, STR_CONST, 0)) {
+        return createNode(parser, STR_CONST);
     }
 
     // Match FLOAT_CONST (terminal)
-    if (match("FLOAT_CONST",0)) {
-        return createNode("FLOAT_CONST");
+    if (match(parser, FLOAT_CONST, 0)) {
+        return createNode(parser, FLOAT_CONST);
     }
 
     // If none of the cases match, return NULL (parsing failed)
     return NULL;
 }
 
-TreeNode* parseCondStmt() {
+TreeNode* parseCondStmt(Parser* parser) {
     // Create the root node for COND_STMT
-    TreeNode* condStmt = createNode("COND_STMT");
+    TreeNode* condStmt = createNode(parser, NODE_COND_STMT);
 
-    // Attempt to parse IF_STMT
-    TreeNode* ifStmt = parseIfStmt();
-    if (ifStmt) {
-        addChild(condStmt, ifStmt);
-        return condStmt;
-    }
+    // Every alternative starts with the same IF_STMT, which the memo parses only once
+    ParseMark saved = markParse(parser);
 
     // Attempt to parse IFELSE_STMT
-    TreeNode* ifElseStmt = parseIfElseStmt();
+    TreeNode* ifElseStmt = parseIfElseStmt(parser);
     if (ifElseStmt) {
-        addChild(condStmt, ifElseStmt);
+        releaseMark(parser, saved);
+        addChild(parser, condStmt, ifElseStmt);
         return condStmt;
     }
+    rewindParse(parser, saved);
 
     // Attempt to parse ELSEIF_STMT
-    TreeNode* elseIfStmt = parseElseIfStmt();
+    TreeNode* elseIfStmt = parseElseIfStmt(parser);
     if (elseIfStmt) {
-        addChild(condStmt, elseIfStmt);
+        releaseMark(parser, saved);
+        addChild(parser, condStmt, elseIfStmt);
+        return condStmt;
+    }
+    rewindParse(parser, saved);
+
+    // Attempt to parse IF_STMT
+    TreeNode* ifStmt = parseIfStmt(parser);
+    if (ifStmt) {
+        releaseMark(parser, saved);
+        addChild(parser, condStmt, ifStmt);
         return condStmt;
     }
 
     // If none match, free the root node and return NULL
-    freeTree(condStmt);
     return NULL;
 }
 
-TreeNode* parseIfStmt() {
+TreeNode* parseIfStmt(Parser* parser) {
+    return memoized(parser, MEMO_IF_STMT, parseIfStmtRule);
+}
+
+TreeNode* parseIfStmtRule(Parser* parser) {
     // Create the root node for IF_STMT
-    TreeNode* ifStmt = createNode("IF_STMT");
+    TreeNode* ifStmt = createNode(parser, NODE_IF_STMT);
 
     // Match the KW_IF token
-    if (!match("KW_IF",0)) {
-        freeTree(ifStmt);
+    if (!match(parser, KW_IF, 0)) {
         return NULL; // If "if" keyword is not found, return NULL
     }
 
     // Match the LEFT_PAREN token
-    if (!match("LEFT_PAREN",0)) {
-        freeTree(ifStmt);
+    if (!match(parser, LEFT_PAREN, 0)) {
         return NULL; // If "(" is not found, return NULL
     }
 
     // Parse BOOL_EXP (nonterminal)
-    TreeNode* boolExp = parseBoolExp();
+    TreeNode* boolExp = parseBoolExp(parser);
     if (!boolExp) {
-        freeTree(ifStmt);
         return NULL; // If BOOL_EXP is not parsed, return NULL
     }
-    addChild(ifStmt, boolExp);
+    addChild(parser, ifStmt, boolExp);
 
     // Match the RIGHT_PAREN token
-    if (!match("RIGHT_PAREN",0)) {
-        freeTree(ifStmt);
+    if (!match(parser, RIGHT_PAREN, 0)) {
         return NULL; // If ")" is not found, return NULL
     }
 
     // Optionally match NW_THEN (if present)
-    if (match("NW_THEN",1)) {
-        TreeNode* thenNode = createNode("NW_THEN");
-        addChild(ifStmt, thenNode);
+    if (match(parser, NW_THEN, 1)) {
+        TreeNode* thenNode = createNode(parser, NW_THEN);
+        addChild(parser, ifStmt, thenNode);
     }
 
     // Parse BLOCK (nonterminal)
-    TreeNode* block = parseBlock();
+    TreeNode* block = parseBlock(parser);
     if (!block) {
-        freeTree(ifStmt);
         return NULL; // If BLOCK is not parsed, return NULL
     }
-    addChild(ifStmt, block);
+    addChild(parser, ifStmt, block);
 
     // Return the successfully parsed IF_STMT node
     return ifStmt;
 }
 
-TreeNode* parseIfElseStmt() {
+TreeNode* parseIfElseStmt(Parser* parser) {
     // Create the root node for IFELSE_STMT
-    TreeNode* ifElseStmt = createNode("IFELSE_STMT");
+    TreeNode* ifElseStmt = createNode(parser, NODE_IFELSE_STMT);
 
     // Parse IF_STMT (nonterminal)
-    TreeNode* ifStmt = parseIfStmt();
+    TreeNode* ifStmt = parseIfStmt(parser);
     if (!ifStmt) {
-        freeTree(ifElseStmt);
         return NULL; // If IF_STMT parsing fails, return NULL
     }
-    addChild(ifElseStmt, ifStmt);
+    addChild(parser, ifElseStmt, ifStmt);
 
     // Parse ELSE_STMT (nonterminal)
-    TreeNode* elseStmt = parseElseStmt();
+    TreeNode* elseStmt = parseElseStmt(parser);
     if (!elseStmt) {
-        freeTree(ifElseStmt);
         return NULL; // If ELSE_STMT parsing fails, return NULL
     }
-    addChild(ifElseStmt, elseStmt);
+    addChild(parser, ifElseStmt, elseStmt);
 
     // Return the successfully parsed IFELSE_STMT node
     return ifElseStmt;
 }
 
-TreeNode* parseElseIfStmt() {
+TreeNode* parseElseIfStmt(Parser* parser) {
     // Create the root node for ELSEIF_STMT
-    TreeNode* elseIfStmt = createNode("ELSEIF_STMT");
+    TreeNode* elseIfStmt = createNode(parser, NODE_ELSEIF_STMT);
 
     // Parse the initial IF_STMT (nonterminal)
-    TreeNode* ifStmt = parseIfStmt();
+    TreeNode* ifStmt = parseIfStmt(parser);
     if (!ifStmt) {
-        freeTree(elseIfStmt);
         return NULL; // If IF_STMT parsing fails, return NULL
     }
-    addChild(elseIfStmt, ifStmt);
+    addChild(parser, elseIfStmt, ifStmt);
+
+    // Parse the sequence of KW_ELSE KW_IF (loop), requiring at least one
+    if (peekType(parser, 0) != KW_ELSE || peekType(parser, 1) != KW_IF) {
+        return NULL; // A plain IF_STMT is handled by parseIfStmt
+    }
+    while (peekType(parser, 0) == KW_ELSE && peekType(parser, 1) == KW_IF) {
+        match(parser, KW_ELSE, 0);
+        match(parser, KW_IF, 0);
 
-    // Parse the sequence of KW_ELSE KW_IF (loop)
-    while (match("KW_ELSE",0) && match("KW_IF",0)) {
         // Parse LEFT_PAREN
-        if (!match("LEFT_PAREN",0)) {
-            freeTree(elseIfStmt);
+        if (!match(parser, LEFT_PAREN, 0)) {
             return NULL; // If LEFT_PAREN is not found, return NULL
         }
 
         // Parse BOOL_EXP
-        TreeNode* boolExp = parseBoolExp();
+        TreeNode* boolExp = parseBoolExp(parser);
         if (!boolExp) {
-            freeTree(elseIfStmt);
             return NULL; // If BOOL_EXP parsing fails, return NULL
         }
-        addChild(elseIfStmt, boolExp);
+        addChild(parser, elseIfStmt, boolExp);
 
         // Parse RIGHT_PAREN
-        if (!match("RIGHT_PAREN",0)) {
-            freeTree(elseIfStmt);
+        if (!match(parser, RIGHT_PAREN, 0)) {
             return NULL; // If RIGHT_PAREN is not found, return NULL
         }
 
         // Optionally match NW_THEN
-        if (match("NW_THEN",1)) {
-            TreeNode* thenNode = createNode("NW_THEN");
-            addChild(elseIfStmt, thenNode);
+        if (match(parser, NW_THEN, 1)) {
+            TreeNode* thenNode = createNode(parser, NW_THEN);
+            addChild(parser, elseIfStmt, thenNode);
         }
 
         // Parse BLOCK
-        TreeNode* block = parseBlock();
+        TreeNode* block = parseBlock(parser);
         if (!block) {
-            freeTree(elseIfStmt);
             return NULL; // If BLOCK parsing fails, return NULL
         }
-        addChild(elseIfStmt, block);
+        addChild(parser, elseIfStmt, block);
     }
 
     // Optionally parse ELSE_STMT
-    if (match("KW_ELSE",1)) {
-        TreeNode* elseStmt = parseElseStmt();
+    if (peekType(parser, 0) == KW_ELSE) {
+        TreeNode* elseStmt = parseElseStmt(parser);
         if (elseStmt) {
-            addChild(elseIfStmt, elseStmt);
+            addChild(parser, elseIfStmt, elseStmt);
         }
     }
 
@@ -1968,187 +2368,168 @@ TreeNode* parseElseIfStmt() {
     return elseIfStmt;
 }
 
-TreeNode* parseElseStmt() {
+TreeNode* parseElseStmt(Parser* parser) {
     // Create the root node for ELSE_STMT
-    TreeNode* elseStmt = createNode("ELSE_STMT");
+    TreeNode* elseStmt = createNode(parser, NODE_ELSE_STMT);
 
     // Match KW_ELSE
-    if (!match("KW_ELSE",0)) {
-        freeTree(elseStmt);
+    if (!match(parser, KW_ELSE, 0)) {
         return NULL; // If KW_ELSE is not found, return NULL
     }
 
     // Parse BLOCK (nonterminal)
-    TreeNode* block = parseBlock();
+    TreeNode* block = parseBlock(parser);
     if (!block) {
-        freeTree(elseStmt);
         return NULL; // If BLOCK parsing fails, return NULL
     }
-    addChild(elseStmt, block);
+    addChild(parser, elseStmt, block);
 
     // Return the successfully parsed ELSE_STMT node
     return elseStmt;
 }
 
-TreeNode* parseIterStmt() {
+TreeNode* parseIterStmt(Parser* parser) {
     // Create the root node for ITER_STMT
-    TreeNode* iterStmt = createNode("ITER_STMT");
+    TreeNode* iterStmt = createNode(parser, NODE_ITER_STMT);
 
     // Attempt to parse WHILE_STMT
-    TreeNode* whileStmt = parseWhileStmt();
+    TreeNode* whileStmt = parseWhileStmt(parser);
     if (whileStmt) {
-        addChild(iterStmt, whileStmt);
+        addChild(parser, iterStmt, whileStmt);
         return iterStmt;  // If WHILE_STMT parsing is successful, return the node
     }
 
     // Attempt to parse FOR_STMT
-    TreeNode* forStmt = parseForStmt();
+    TreeNode* forStmt = parseForStmt(parser);
     if (forStmt) {
-        addChild(iterStmt, forStmt);
+        addChild(parser, iterStmt, forStmt);
         return iterStmt;  // If FOR_STMT parsing is successful, return the node
     }
 
     // If neither WHILE_STMT nor FOR_STMT is found, free the root and return NULL
-    freeTree(iterStmt);
     return NULL;
 }
 
-TreeNode* parseWhileStmt() {
+TreeNode* parseWhileStmt(Parser* parser) {
     // Create the root node for WHILE_STMT
-    TreeNode* whileStmt = createNode("WHILE_STMT");
+    TreeNode* whileStmt = createNode(parser, NODE_WHILE_STMT);
 
     // Match KW_WHILE token
-    if (!match("KW_WHILE",0)) {
-        freeTree(whileStmt);
+    if (!match(parser, KW_WHILE, 0)) {
         return NULL; // If KW_WHILE is not found, return NULL
     }
 
     // Match LEFT_PAREN token
-    if (!match("LEFT_PAREN",0)) {
-        freeTree(whileStmt);
+    if (!match(parser, LEFT_PAREN, 0)) {
         return NULL; // If LEFT_PAREN is not found, return NULL
     }
 
     // Parse BOOL_EXP (nonterminal)
-    TreeNode* boolExp = parseBoolExp();
+    TreeNode* boolExp = parseBoolExp(parser);
     if (!boolExp) {
-        freeTree(whileStmt);
         return NULL; // If BOOL_EXP parsing fails, return NULL
     }
-    addChild(whileStmt, boolExp);
+    addChild(parser, whileStmt, boolExp);
 
     // Match RIGHT_PAREN token
-    if (!match("RIGHT_PAREN",0)) {
-        freeTree(whileStmt);
+    if (!match(parser, RIGHT_PAREN, 0)) {
         return NULL; // If RIGHT_PAREN is not found, return NULL
     }
 
     // Check for optional NW_DO token (do-block syntax)
-    match("NW_DO",1);
+    match(parser, NW_DO, 1);
 
     // Parse BLOCK (nonterminal)
-    TreeNode* block = parseBlock();
+    TreeNode* block = parseBlock(parser);
     if (!block) {
-        freeTree(whileStmt);
         return NULL; // If BLOCK parsing fails, return NULL
     }
-    addChild(whileStmt, block);
+    addChild(parser, whileStmt, block);
 
     // Return the successfully parsed WHILE_STMT node
     return whileStmt;
 }
 
-TreeNode* parseForStmt() {
+TreeNode* parseForStmt(Parser* parser) {
     // Create the root node for FOR_STMT
-    TreeNode* forStmt = createNode("FOR_STMT");
+    TreeNode* forStmt = createNode(parser, NODE_FOR_STMT);
 
     // Match KW_FOR token
-    if (!match("KW_FOR",0)) {
-        freeTree(forStmt);
+    if (!match(parser, KW_FOR, 0)) {
         return NULL; // If KW_FOR is not found, return NULL
     }
 
     // Match LEFT_PAREN token
-    if (!match("LEFT_PAREN",0)) {
-        freeTree(forStmt);
+    if (!match(parser, LEFT_PAREN, 0)) {
         return NULL; // If LEFT_PAREN is not found, return NULL
     }
 
     // Parse either VAR_DECL or ASSIGN_STMT (one of these nonterminals)
-    TreeNode* initStmt = parseVarDecl();
+    TreeNode* initStmt = parseVarDecl(parser);
     if (!initStmt) {
-        initStmt = parseAssignStmt(); // Try ASSIGN_STMT if VAR_DECL fails
+        initStmt = parseAssignStmt(parser); // Try ASSIGN_STMT if VAR_DECL fails
     }
     if (!initStmt) {
-        freeTree(forStmt);
         return NULL; // If neither VAR_DECL nor ASSIGN_STMT is found, return NULL
     }
-    addChild(forStmt, initStmt);  // Add the initStmt to the FOR_STMT node
+    addChild(parser, forStmt, initStmt);  // Add the initStmt to the FOR_STMT node
 
     // Parse BOOL_EXP (nonterminal)
-    TreeNode* boolExp = parseBoolExp();
+    TreeNode* boolExp = parseBoolExp(parser);
     if (!boolExp) {
-        freeTree(forStmt);
         return NULL; // If BOOL_EXP parsing fails, return NULL
     }
-    addChild(forStmt, boolExp);
+    addChild(parser, forStmt, boolExp);
 
     // Match SEMICOLON token
-    if (!match("SEMICOLON",0)) {
-        freeTree(forStmt);
+    if (!match(parser, SEMICOLON, 0)) {
         return NULL; // If SEMICOLON is not found, return NULL
     }
 
     // Parse UPDATE (nonterminal)
-    TreeNode* update = parseUpdate();
+    TreeNode* update = parseUpdate(parser);
     if (!update) {
-        freeTree(forStmt);
         return NULL; // If UPDATE parsing fails, return NULL
     }
-    addChild(forStmt, update);
+    addChild(parser, forStmt, update);
 
     // Match RIGHT_PAREN token
-    if (!match("RIGHT_PAREN",0)) {
-        freeTree(forStmt);
+    if (!match(parser, RIGHT_PAREN, 0)) {
         return NULL; // If RIGHT_PAREN is not found, return NULL
     }
 
     // Check for optional NW_DO token (do-block syntax)
-    match("NW_DO",1);
+    match(parser, NW_DO, 1);
 
     // Parse BLOCK (nonterminal)
-    TreeNode* block = parseBlock();
+    TreeNode* block = parseBlock(parser);
     if (!block) {
-        freeTree(forStmt);
         return NULL; // If BLOCK parsing fails, return NULL
     }
-    addChild(forStmt, block);
+    addChild(parser, forStmt, block);
 
     // Return the successfully parsed FOR_STMT node
     return forStmt;
 }
 
-TreeNode* parseReturnStmt() {
+TreeNode* parseReturnStmt(Parser* parser) {
     // Create the root node for RETURN_STMT
-    TreeNode* returnStmt = createNode("RETURN_STMT");
+    TreeNode* returnStmt = createNode(parser, NODE_RETURN_STMT);
 
     // Match KW_RETURN token
-    if (!match("KW_RETURN",0)) {
-        freeTree(returnStmt);
+    if (!match(parser, KW_RETURN, 0)) {
         return NULL; // If KW_RETURN is not found, return NULL
     }
 
     // Parse EXP (nonterminal) - this can be either ARITH_EXP or BOOL_EXP
-    TreeNode* exp = parseExp();
+    TreeNode* exp = parseExp(parser);
     if (!exp) {
-        freeTree(returnStmt);
         return NULL; // If EXP parsing fails, return NULL
     }
-    addChild(returnStmt, exp);  // Add EXP to the RETURN_STMT node
+    addChild(parser, returnStmt, exp);  // Add EXP to the RETURN_STMT node
 
     // Match SEMICOLON token
-    if (!match("SEMICOLON",0)) {
-        freeTree(returnStmt);
+    if (!match(parser, SEMICOLON, 0)) {
         return NULL; // If SEMICOLON is not found, return NULL
     }
 
@@ -2156,450 +2537,856 @@ TreeNode* parseReturnStmt() {
     return returnStmt;
 }
 
-TreeNode* parseOutputStmt() {
+TreeNode* parseOutputStmt(Parser* parser) {
     // Create the root node for OUTPUT_STMT
-    TreeNode* outputStmt = createNode("OUTPUT_STMT");
+    TreeNode* outputStmt = createNode(parser, NODE_OUTPUT_STMT);
 
     // Try to parse STD_OUTPUT
-    TreeNode* stdOutput = parseStdOutput();
+    TreeNode* stdOutput = parseStdOutput(parser);
     if (stdOutput) {
-        addChild(outputStmt, stdOutput); // If successful, add to the OUTPUT_STMT node
+        addChild(parser, outputStmt, stdOutput); // If successful, add to the OUTPUT_STMT node
         return outputStmt;
     }
 
     // Try to parse VALUE_OUTPUT
-    TreeNode* valueOutput = parseValueOutput();
+    TreeNode* valueOutput = parseValueOutput(parser);
     if (valueOutput) {
-        addChild(outputStmt, valueOutput); // If successful, add to the OUTPUT_STMT node
+        addChild(parser, outputStmt, valueOutput); // If successful, add to the OUTPUT_STMT node
         return outputStmt;
     }
 
     // Try to parse SEQUENCE_OUTPUT
-    TreeNode* sequenceOutput = parseSequenceOutput();
+    TreeNode* sequenceOutput = parseSequenceOutput(parser);
     if (sequenceOutput) {
-        addChild(outputStmt, sequenceOutput); // If successful, add to the OUTPUT_STMT node
+        addChild(parser, outputStmt, sequenceOutput); // If successful, add to the OUTPUT_STMT node
         return outputStmt;
     }
 
     // If none of the above parsing attempts are successful, free the node and return NULL
-    freeTree(outputStmt);
     return NULL;
 }
 
-TreeNode* parseStdOutput() {
+TreeNode* parseStdOutput(Parser* parser) {
     // Save the current token index to allow backtracking
-    size_t savedIndex = currentTokenIndex;
+    ParseMark saved = markParse(parser);
 
     // Create the root node for STD_OUTPUT
-    TreeNode* stdOutput = createNode("STD_OUTPUT");
+    TreeNode* stdOutput = createNode(parser, NODE_STD_OUTPUT);
 
     // Match KW_DISPLAY
-    if (!match("KW_DISPLAY",0)) {
-        freeTree(stdOutput);
-        currentTokenIndex = savedIndex;
+    if (!match(parser, KW_DISPLAY, 0)) {
+        rewindParse(parser, saved);
         return NULL;
     }
-    addChild(stdOutput, createNode("KW_DISPLAY"));
+    addChild(parser, stdOutput, createNode(parser, KW_DISPLAY));
 
     // Match LEFT_PAREN
-    if (!match("LEFT_PAREN",0)) {
-        freeTree(stdOutput);
-        currentTokenIndex = savedIndex;
+    if (!match(parser, LEFT_PAREN, 0)) {
+        rewindParse(parser, saved);
         return NULL;
     }
-    addChild(stdOutput, createNode("LEFT_PAREN"));
+    addChild(parser, stdOutput, createNode(parser, LEFT_PAREN));
 
     // Match STR_CONST
-    if (!match("STR_CONST",0)) {
-        freeTree(stdOutput);
-        currentTokenIndex = savedIndex;
+    if (!match(parser, STR_CONST, 0)) {
+        rewindParse(parser, saved);
         return NULL;
     }
-    addChild(stdOutput, createNode("STR_CONST"));
+    addChild(parser, stdOutput, createNode(parser, STR_CONST));
 
     // Match RIGHT_PAREN
-    if (!match("RIGHT_PAREN",0)) {
-        freeTree(stdOutput);
-        currentTokenIndex = savedIndex;
+    if (!match(parser, RIGHT_PAREN, 0)) {
+        rewindParse(parser, saved);
         return NULL;
     }
-    addChild(stdOutput, createNode("RIGHT_PAREN"));
+    addChild(parser, stdOutput, createNode(parser, RIGHT_PAREN));
 
     // Match SEMICOLON
-    if (!match("SEMICOLON",0)) {
-        freeTree(stdOutput);
-        currentTokenIndex = savedIndex;
+    if (!match(parser, SEMICOLON, 0)) {
+        rewindParse(parser, saved);
         return NULL;
     }
-    addChild(stdOutput, createNode("SEMICOLON"));
+    addChild(parser, stdOutput, createNode(parser, SEMICOLON));
 
     // Return the successfully parsed STD_OUTPUT tree
+    releaseMark(parser, saved);
     return stdOutput;
 }
 
-TreeNode* parseValueOutput() {
+TreeNode* parseValueOutput(Parser* parser) {
     // Save the current token index to allow backtracking
-    size_t savedIndex = currentTokenIndex;
+    ParseMark saved = markParse(parser);
 
     // Create the root node for VALUE_OUTPUT
-    TreeNode* valueOutput = createNode("VALUE_OUTPUT");
+    TreeNode* valueOutput = createNode(parser, NODE_VALUE_OUTPUT);
 
     // Match KW_DISPLAY
-    if (!match("KW_DISPLAY",0)) {
-        freeTree(valueOutput);
-        currentTokenIndex = savedIndex;
+    if (!match(parser, KW_DISPLAY, 0)) {
+        rewindParse(parser, saved);
         return NULL;
     }
-    addChild(valueOutput, createNode("KW_DISPLAY"));
+    addChild(parser, valueOutput, createNode(parser, KW_DISPLAY));
 
     // Match LEFT_PAREN
-    if (!match("LEFT_PAREN",0)) {
-        freeTree(valueOutput);
-        currentTokenIndex = savedIndex;
+    if (!match(parser, LEFT_PAREN, 0)) {
+        rewindParse(parser, saved);
         return NULL;
     }
-    addChild(valueOutput, createNode("LEFT_PAREN"));
+    addChild(parser, valueOutput, createNode(parser, LEFT_PAREN));
 
     // Parse FORMAT_SPECIFIER (nonterminal)
-    TreeNode* formatSpecifier = parseFormatSpecifier();
+    TreeNode* formatSpecifier = parseFormatSpecifier(parser);
     if (!formatSpecifier) {
-        freeTree(valueOutput);
-        currentTokenIndex = savedIndex;
+        rewindParse(parser, saved);
         return NULL;
     }
-    addChild(valueOutput, formatSpecifier);
+    addChild(parser, valueOutput, formatSpecifier);
 
     // Match COMMA
-    if (!match("COMMA",0)) {
-        freeTree(valueOutput);
-        currentTokenIndex = savedIndex;
+    if (!match(parser, COMMA, 0)) {
+        rewindParse(parser, saved);
         return NULL;
     }
-    addChild(valueOutput, createNode("COMMA"));
+    addChild(parser, valueOutput, createNode(parser, COMMA));
 
     // Match IDENTIFIER
-    if (!match("IDENTIFIER",0)) {
-        freeTree(valueOutput);
-        currentTokenIndex = savedIndex;
+    if (!match(parser, IDENTIFIER, 0)) {
+        rewindParse(parser, saved);
         return NULL;
     }
-    addChild(valueOutput, createNode("IDENTIFIER"));
+    addChild(parser, valueOutput, createNode(parser, IDENTIFIER));
 
     // Match RIGHT_PAREN
-    if (!match("RIGHT_PAREN",0)) {
-        freeTree(valueOutput);
-        currentTokenIndex = savedIndex;
+    if (!match(parser, RIGHT_PAREN, 0)) {
+        rewindParse(parser, saved);
         return NULL;
     }
-    addChild(valueOutput, createNode("RIGHT_PAREN"));
+    addChild(parser, valueOutput, createNode(parser, RIGHT_PAREN));
 
     // Match SEMICOLON
-    if (!match("SEMICOLON",0)) {
-        freeTree(valueOutput);
-        currentTokenIndex = savedIndex;
+    if (!match(parser, SEMICOLON, 0)) {
+        rewindParse(parser, saved);
         return NULL;
     }
-    addChild(valueOutput, createNode("SEMICOLON"));
+    addChild(parser, valueOutput, createNode(parser, SEMICOLON));
 
     // Return the successfully parsed VALUE_OUTPUT tree
+    releaseMark(parser, saved);
     return valueOutput;
 }
 
-TreeNode* parseFormatSpecifier() {
-    // Create the root node for FORMAT_SPECIFIER
-    TreeNode* formatSpecifier = createNode("FORMAT_SPECIFIER");
-
-    // Match FORMAT_INT
-    if (match("FORMAT_INT",0)) {
-        addChild(formatSpecifier, createNode("FORMAT_INT"));
-        return formatSpecifier;
-    }
-
-    // Match FORMAT_CHAR
-    if (match("FORMAT_CHAR",0)) {
-        addChild(formatSpecifier, createNode("FORMAT_CHAR"));
-        return formatSpecifier;
-    }
-
-    // Match FORMAT_FLOAT
-    if (match("FORMAT_FLOAT",0)) {
-        addChild(formatSpecifier, createNode("FORMAT_FLOAT"));
-        return formatSpecifier;
-    }
-
-    // Match FORMAT_STR
-    if (match("FORMAT_STR",0)) {
-        addChild(formatSpecifier, createNode("FORMAT_STR"));
-        return formatSpecifier;
+TreeNode* parseFormatSpecifier(Parser* parser) {
+    // Match FORMAT_INT, FORMAT_CHAR, FORMAT_FLOAT or FORMAT_STR
+    if (!matchAny(parser, SET_FORMAT_SPEC, "FORMAT_SPECIFIER")) {
+        return NULL;
     }
 
-    // If no matches, free the root node and return NULL
-    freeTree(formatSpecifier);
-    return NULL;
+    // Create the root node for FORMAT_SPECIFIER
+    TreeNode* formatSpecifier = createNode(parser, NODE_FORMAT_SPECIFIER);
+    addChild(parser, formatSpecifier, createNode(parser, matchedType(parser)));
+    return formatSpecifier;
 }
 
-TreeNode* parseSequenceOutput() {
+TreeNode* parseSequenceOutput(Parser* parser) {
     // Create the root node for SEQUENCE_OUTPUT
-    TreeNode* sequenceOutput = createNode("SEQUENCE_OUTPUT");
+    TreeNode* sequenceOutput = createNode(parser, NODE_SEQUENCE_OUTPUT);
 
     // Match KW_DISPLAY
-    if (!match("KW_DISPLAY",0)) {
-        freeTree(sequenceOutput);
+    if (!match(parser, KW_DISPLAY, 0)) {
         return NULL;
     }
-    addChild(sequenceOutput, createNode("KW_DISPLAY"));
+    addChild(parser, sequenceOutput, createNode(parser, KW_DISPLAY));
 
     // Match LEFT_PAREN
-    if (!match("LEFT_PAREN",0)) {
-        freeTree(sequenceOutput);
+    if (!match(parser, LEFT_PAREN, 0)) {
         return NULL;
     }
-    addChild(sequenceOutput, createNode("LEFT_PAREN"));
+    addChild(parser, sequenceOutput, createNode(parser, LEFT_PAREN));
 
     // Match STR_WITH_FORMAT
-    if (!match("STR_WITH_FORMAT",0)) {
-        freeTree(sequenceOutput);
+    if (!match(parser, STR_WITH_FORMAT, 0)) {
         return NULL;
     }
-    addChild(sequenceOutput, createNode("STR_WITH_FORMAT"));
+    addChild(parser, sequenceOutput, createNode(parser, STR_WITH_FORMAT));
 
     // Match { COMMA OUTPUT_ELEM }
-    while (match("COMMA",0)) {
-        TreeNode* outputElem = parseOutputElem();
+    while (match(parser, COMMA, 0)) {
+        TreeNode* outputElem = parseOutputElem(parser);
         if (outputElem == NULL) {
-            freeTree(sequenceOutput);
             return NULL;
         }
-        addChild(sequenceOutput, createNode("COMMA"));
-        addChild(sequenceOutput, outputElem);
+        addChild(parser, sequenceOutput, createNode(parser, COMMA));
+        addChild(parser, sequenceOutput, outputElem);
     }
 
     // Match RIGHT_PAREN
-    if (!match("RIGHT_PAREN",0)) {
-        freeTree(sequenceOutput);
+    if (!match(parser, RIGHT_PAREN, 0)) {
         return NULL;
     }
-    addChild(sequenceOutput, createNode("RIGHT_PAREN"));
+    addChild(parser, sequenceOutput, createNode(parser, RIGHT_PAREN));
 
     // Match SEMICOLON
-    if (!match("SEMICOLON",0)) {
-        freeTree(sequenceOutput);
+    if (!match(parser, SEMICOLON, 0)) {
         return NULL;
     }
-    addChild(sequenceOutput, createNode("SEMICOLON"));
+    addChild(parser, sequenceOutput, createNode(parser, SEMICOLON));
 
     return sequenceOutput;
 }
 
-TreeNode* parseOutputElem() {
+TreeNode* parseOutputElem(Parser* parser) {
     // Create the root node for OUTPUT_ELEM
-    TreeNode* outputElem = createNode("OUTPUT_ELEM");
+    TreeNode* outputElem = createNode(parser, NODE_OUTPUT_ELEM);
 
     // Match STR_CONST
-    if (match("STR_CONST",0)) {
-        addChild(outputElem, createNode("STR_CONST"));
+    if (match(parser, STR_CONST, 0)) {
+        addChild(parser, outputElem, createNode(parser, STR_CONST));
         return outputElem;
     }
 
     // Match IDENTIFIER
-    if (match("IDENTIFIER",0)) {
-        addChild(outputElem, createNode("IDENTIFIER"));
+    if (match(parser, IDENTIFIER, 0)) {
+        addChild(parser, outputElem, createNode(parser, IDENTIFIER));
         return outputElem;
     }
 
     // Parse ARITH_EXP
-    TreeNode* arithExp = parseArithExp();
+    TreeNode* arithExp = parseArithExp(parser);
     if (arithExp) {
-        addChild(outputElem, arithExp);
+        addChild(parser, outputElem, arithExp);
         return outputElem;
     }
 
     // If none of the cases match, free the tree and return NULL
-    freeTree(outputElem);
     return NULL;
 }
 
-TreeNode* parseInputStmt() {
+TreeNode* parseInputStmt(Parser* parser) {
     // Create the root node for INPUT_STMT
-    TreeNode* inputStmt = createNode("INPUT_STMT");
+    TreeNode* inputStmt = createNode(parser, NODE_INPUT_STMT);
 
     // Match IDENTIFIER
-    if (match("IDENTIFIER",0)) {
-        addChild(inputStmt, createNode("IDENTIFIER"));
+    if (match(parser, IDENTIFIER, 0)) {
+        addChild(parser, inputStmt, createNode(parser, IDENTIFIER));
     } else {
-        freeTree(inputStmt);
         return NULL;
     }
 
     // Match '='
-    if (match("ASSIGN_OP",0)) {
-        addChild(inputStmt, createNode("="));
+    if (match(parser, ASSIGN_OP, 0)) {
+        addChild(parser, inputStmt, createNode(parser, NODE_EQUALS_SIGN));
     } else {
-        freeTree(inputStmt);
         return NULL;
     }
 
     // Match KW_INPUT
-    if (match("KW_INPUT",0)) {
-        addChild(inputStmt, createNode("KW_INPUT"));
+    if (match(parser, KW_INPUT, 0)) {
+        addChild(parser, inputStmt, createNode(parser, KW_INPUT));
     } else {
-        freeTree(inputStmt);
         return NULL;
     }
 
     // Match LEFT_PAREN
-    if (match("LEFT_PAREN",0)) {
-        addChild(inputStmt, createNode("("));
+    if (match(parser, LEFT_PAREN, 0)) {
+        addChild(parser, inputStmt, createNode(parser, NODE_OPEN_PAREN_SIGN));
     } else {
-        freeTree(inputStmt);
         return NULL;
     }
 
     // Match STR_CONST
-    if (match("STR_CONST",0)) {
-        addChild(inputStmt, createNode("STR_CONST"));
+    if (match(parser, STR_CONST, 0)) {
+        addChild(parser, inputStmt, createNode(parser, STR_CONST));
     } else {
-        freeTree(inputStmt);
         return NULL;
     }
 
     // Match COMMA
-    if (match("COMMA",0)) {
-        addChild(inputStmt, createNode(","));
+    if (match(parser, COMMA, 0)) {
+        addChild(parser, inputStmt, createNode(parser, NODE_COMMA_SIGN));
     } else {
-        freeTree(inputStmt);
         return NULL;
     }
 
     // Parse TYPE_SPEC
-    TreeNode* typeSpec = parseTypeSpec();
+    TreeNode* typeSpec = parseTypeSpec(parser);
     if (typeSpec) {
-        addChild(inputStmt, typeSpec);
+        addChild(parser, inputStmt, typeSpec);
     } else {
-        freeTree(inputStmt);
         return NULL;
     }
 
     // Match RIGHT_PAREN
-    if (match("RIGHT_PAREN",0)) {
-        addChild(inputStmt, createNode(")"));
+    if (match(parser, RIGHT_PAREN, 0)) {
+        addChild(parser, inputStmt, createNode(parser, NODE_CLOSE_PAREN_SIGN));
     } else {
-        freeTree(inputStmt);
         return NULL;
     }
 
     // Match SEMICOLON
-    if (match("SEMICOLON",0)) {
-        addChild(inputStmt, createNode(";"));
+    if (match(parser, SEMICOLON, 0)) {
+        addChild(parser, inputStmt, createNode(parser, NODE_SEMICOLON_SIGN));
     } else {
-        freeTree(inputStmt);
         return NULL;
     }
 
     return inputStmt;
 }
 
+// Lowering to the abstract syntax tree. The AST lives in treeArena next
+// to the parse tree and is built on first use by lowerParseTree().
+
+static AstNode* lowerNode(Parser* parser, TreeNode* node);
+
+// Source line a subtree starts on: that of its first token
+static uint32_t firstLine(TreeNode* node) {
+    if (node->line) return node->line;
+    for (uint32_t i = 0; i < node->childCount; i++) {
+        uint32_t line = firstLine(node->children[i]);
+        if (line) return line;
+    }
+    return 0;
+}
+
+// A node for up to `capacity` operands; more than fit inline get an array
+static AstNode* newAstNode(Parser* parser, AstKind kind, TokenType op, uint32_t line, uint32_t capacity) {
+    AstNode* node = arena_alloc(&parser->treeArena, sizeof(AstNode));
+    node->kind = kind;
+    node->op = op;
+    node->line = line;
+    node->count = 0;
+    node->operands = capacity > AST_INLINE_OPERANDS ? arena_alloc(&parser->treeArena, sizeof(AstNode*) * capacity)
+                                                    : node->inlineOperands;
+    return node;
+}
+
+static AstNode* newAstLeaf(Parser* parser, AstKind kind, TreeNode* terminal) {
+    AstNode* node = newAstNode(parser, kind, TOKEN_UNKNOWN, terminal->line, 0);
+    node->leaf.text = parser->treeSource + terminal->token.offset;
+    node->leaf.length = terminal->token.length;
+    node->leaf.value = terminal->token.value;
+    return node;
+}
+
+static void appendOperand(AstNode* node, AstNode* operand) {
+    if (operand) node->operands[node->count++] = operand;
+}
+
+// Type keywords, which become the op of the declaration holding them
+static int isTypeToken(NodeKind kind) {
+    return kind < NODE_SIMPLICITY && ((TOKEN_SETS[kind] & SET_TYPE_SPEC) || kind == (NodeKind)RW_VOID);
+}
+
+// The token an UPDATE_OP, ASSIGNMENT or FORMAT_SPECIFIER node wraps
+static TokenType wrappedToken(TreeNode* node) {
+    return (TokenType)node->children[0]->kind;
+}
+
+// Lower the value of an ASSIGN node and store its operator in *op
+static AstNode* lowerAssignValue(Parser* parser, TreeNode* assign, TokenType* op) {
+    AstNode* value = NULL;
+    *op = ASSIGN_OP;
+    for (uint32_t i = 0; i < assign->childCount; i++) {
+        TreeNode* child = assign->children[i];
+        if (child->kind == NODE_ASSIGNMENT) {
+            *op = wrappedToken(child);
+        } else if (child->kind != (NodeKind)ASSIGN_OP) {
+            value = lowerNode(parser, child);
+        }
+    }
+    return value;
+}
+
+// Lower the children of `node` in order into the operands of one node of
+// `kind`. Type, format and update tokens become its op, an ASSIGN adds
+// its operator and value, and punctuation and keywords are dropped.
+static AstNode* lowerOperands(Parser* parser, TreeNode* node, AstKind kind) {
+    AstNode* result = newAstNode(parser, kind, TOKEN_UNKNOWN, firstLine(node), node->childCount);
+    for (uint32_t i = 0; i < node->childCount; i++) {
+        TreeNode* child = node->children[i];
+        if (isTypeToken(child->kind)) {
+            result->op = (TokenType)child->kind;
+        } else if (child->kind == NODE_FORMAT_SPECIFIER || child->kind == NODE_UPDATE_OP) {
+            result->op = wrappedToken(child);
+        } else if (child->kind == NODE_ASSIGN) {
+            appendOperand(result, lowerAssignValue(parser, child, &result->op));
+        } else {
+            appendOperand(result, lowerNode(parser, child));
+        }
+    }
+    return result;
+}
+
+// Top-level declarations, then MAIN with the arguments and body that
+// follow the return type and "main"
+static AstNode* lowerProgram(Parser* parser, TreeNode* root) {
+    AstNode* program = newAstNode(parser, AST_PROGRAM, TOKEN_UNKNOWN, firstLine(root), root->childCount);
+    AstNode* main = newAstNode(parser, AST_MAIN, TOKEN_UNKNOWN, 0, 2);
+    int inMain = 0;
+
+    for (uint32_t i = 0; i < root->childCount; i++) {
+        TreeNode* child = root->children[i];
+        if (child->kind == NODE_MAIN) {
+            inMain = 1;
+        } else if (inMain) {
+            if (child->kind == NODE_ARG_LIST || child->kind == NODE_BLOCK) appendOperand(main, lowerNode(parser, child));
+        } else if (isTypeToken(child->kind)) {
+            main->op = (TokenType)child->kind;
+            main->line = child->line;
+        } else {
+            appendOperand(program, lowerNode(parser, child));
+        }
+    }
+    appendOperand(program, main);
+    return program;
+}
+
+// One VAR per declared name, holding the initializer that follows it
+static AstNode* lowerVarDecl(Parser* parser, TreeNode* varDecl) {
+    TokenType type = TOKEN_UNKNOWN;
+    TreeNode* names = NULL;
+    for (uint32_t i = 0; i < varDecl->childCount; i++) {
+        TreeNode* child = varDecl->children[i];
+        if (isTypeToken(child->kind)) type = (TokenType)child->kind;
+        if (child->kind == NODE_ID_LIST || child->kind == (NodeKind)IDENTIFIER) names = child;
+    }
+
+    TreeNode* const* items = names->kind == NODE_ID_LIST ? names->children : &names;
+    uint32_t itemCount = names->kind == NODE_ID_LIST ? names->childCount : 1;
+    AstNode* decl = newAstNode(parser, AST_VAR_DECL, type, firstLine(varDecl), itemCount);
+    AstNode* var = NULL;
+
+    for (uint32_t i = 0; i < itemCount; i++) {
+        if (items[i]->kind == (NodeKind)IDENTIFIER) {
+            var = newAstNode(parser, AST_VAR, TOKEN_UNKNOWN, items[i]->line, 2);
+            appendOperand(var, newAstLeaf(parser, AST_NAME, items[i]));
+            appendOperand(decl, var);
+        } else if (items[i]->kind == NODE_ASSIGN && var) {
+            appendOperand(var, lowerAssignValue(parser, items[i], &var->op));
+        }
+    }
+    return decl;
+}
+
+// The statements of the STMT_LIST and the closing break, continue or return
+static AstNode* lowerBlock(Parser* parser, TreeNode* block) {
+    uint32_t capacity = block->childCount;
+    for (uint32_t i = 0; i < block->childCount; i++) {
+        if (block->children[i]->kind == NODE_STMT_LIST) capacity += block->children[i]->childCount;
+    }
+
+    AstNode* result = newAstNode(parser, AST_BLOCK, TOKEN_UNKNOWN, firstLine(block), capacity);
+    for (uint32_t i = 0; i < block->childCount; i++) {
+        TreeNode* child = block->children[i];
+        if (child->kind != NODE_STMT_LIST) {
+            appendOperand(result, lowerNode(parser, child));
+            continue;
+        }
+        for (uint32_t j = 0; j < child->childCount; j++) {
+            appendOperand(result, lowerNode(parser, child->children[j]));
+        }
+    }
+    return result;
+}
+
+// IF_STMT { BOOL_EXP BLOCK } [ELSE_STMT] becomes a chain of IFs, each
+// else-if being the else branch of the one before
+static AstNode* lowerIfChain(Parser* parser, TreeNode* node) {
+    AstNode* chain = lowerNode(parser, node->children[0]);
+    AstNode* last = chain;
+    AstNode* condition = NULL;
+
+    for (uint32_t i = 1; i < node->childCount; i++) {
+        TreeNode* child = node->children[i];
+        AstNode* lowered = lowerNode(parser, child);
+        if (!lowered) continue;
+
+        if (child->kind == NODE_ELSE_STMT) {
+            appendOperand(last, lowered);
+        } else if (!condition) {
+            condition = lowered;
+        } else {
+            AstNode* elseIf = newAstNode(parser, AST_IF, TOKEN_UNKNOWN, condition->line, 3);
+            appendOperand(elseIf, condition);
+            appendOperand(elseIf, lowered);
+            appendOperand(last, elseIf);
+            last = elseIf;
+            condition = NULL;
+        }
+    }
+    return chain;
+}
+
+static AstNode* lowerNode(Parser* parser, TreeNode* node) {
+    switch ((int)node->kind) {
+        case IDENTIFIER:
+            return newAstLeaf(parser, AST_NAME, node);
+        case NUM_CONST:
+            return newAstLeaf(parser, AST_INT, node);
+        case FLOAT_CONST:
+            return newAstLeaf(parser, AST_FLOAT, node);
+        case RW_NULL:
+            return newAstLeaf(parser, AST_NULL, node);
+        case BOOL_CONST: {
+            AstNode* leaf = newAstLeaf(parser, AST_BOOL, node);
+            leaf->leaf.value.integer = leaf->leaf.length == 4;  // "true"
+            return leaf;
+        }
+        case CHAR_CONST: {
+            AstNode* leaf = newAstLeaf(parser, AST_CHAR, node);
+            leaf->leaf.value.integer = leaf->leaf.length ? (unsigned char)leaf->leaf.text[0] : 0;
+            return leaf;
+        }
+        case STR_CONST:
+        case STR_WITH_FORMAT: {
+            AstNode* leaf = newAstLeaf(parser, AST_STRING, node);
+            leaf->op = (TokenType)node->kind;
+            return leaf;
+        }
+        case KW_BREAK:
+            return newAstNode(parser, AST_BREAK, TOKEN_UNKNOWN, node->line, 0);
+        case KW_CONTINUE:
+            return newAstNode(parser, AST_CONTINUE, TOKEN_UNKNOWN, node->line, 0);
+
+        // Wrappers around a single construct
+        case NODE_DECL_STMT:
+        case NODE_FUNC_STMT:
+        case NODE_ARR_STMT:
+        case NODE_COND_STMT:
+        case NODE_ITER_STMT:
+        case NODE_OUTPUT_STMT:
+        case NODE_OUTPUT_ELEM:
+        case NODE_ELSE_STMT:
+        case NODE_EXP:
+        case NODE_BOOL_LITERAL:
+            for (uint32_t i = 0; i < node->childCount; i++) {
+                AstNode* lowered = lowerNode(parser, node->children[i]);
+                if (lowered) return lowered;
+            }
+            return NULL;
+
+        case NODE_SIMPLICITY:
+            return lowerProgram(parser, node);
+        case NODE_VAR_DECL:
+            return lowerVarDecl(parser, node);
+        case NODE_BLOCK:
+        case NODE_STMT_LIST:
+            return lowerBlock(parser, node);
+        case NODE_IFELSE_STMT:
+        case NODE_ELSEIF_STMT:
+            return lowerIfChain(parser, node);
+        case NODE_PARAM:
+            if (node->children[0]->kind == NODE_ARR_DECL) return lowerNode(parser, node->children[0]);
+            return lowerOperands(parser, node, AST_PARAM);
+        case NODE_UPDATE:
+            return lowerOperands(parser, node, node->children[0]->kind == (NodeKind)IDENTIFIER ? AST_POSTFIX_UPDATE : AST_PREFIX_UPDATE);
+
+        case NODE_ASSIGN_STMT:
+        case NODE_ARR_ASSIGN:
+            return lowerOperands(parser, node, AST_ASSIGN);
+        case NODE_ARR_ACCESS:
+            return lowerOperands(parser, node, AST_INDEX);
+        case NODE_ARR_DECL:
+            return lowerOperands(parser, node, AST_ARRAY_DECL);
+        case NODE_ARR_INIT:
+            return lowerOperands(parser, node, AST_ARRAY_INIT);
+        case NODE_ARR_LIST:
+            return lowerOperands(parser, node, AST_LIST);
+        case NODE_FUNC_DECL:
+            return lowerOperands(parser, node, AST_FUNC_DECL);
+        case NODE_FUNC_DEF:
+            return lowerOperands(parser, node, AST_FUNC_DEF);
+        case NODE_PARAM_LIST:
+            return lowerOperands(parser, node, AST_PARAMS);
+        case NODE_FUNC_CALL:
+            return lowerOperands(parser, node, AST_CALL);
+        case NODE_ARG_LIST:
+            return lowerOperands(parser, node, AST_ARGS);
+        case NODE_IF_STMT:
+            return lowerOperands(parser, node, AST_IF);
+        case NODE_WHILE_STMT:
+            return lowerOperands(parser, node, AST_WHILE);
+        case NODE_FOR_STMT:
+            return lowerOperands(parser, node, AST_FOR);
+        case NODE_RETURN_STMT:
+            return lowerOperands(parser, node, AST_RETURN);
+        case NODE_STD_OUTPUT:
+        case NODE_VALUE_OUTPUT:
+        case NODE_SEQUENCE_OUTPUT:
+            return lowerOperands(parser, node, AST_DISPLAY);
+        case NODE_INPUT_STMT:
+            return lowerOperands(parser, node, AST_INPUT);
+
+        default:
+            break;
+    }
+
+    // Operator nodes are terminals with operands; other terminals are
+    // punctuation and keywords
+    if (node->kind < NODE_SIMPLICITY && node->childCount > 0) {
+        AstNode* result = lowerOperands(parser, node, node->childCount == 2 ? AST_BINARY : AST_UNARY);
+        result->op = (TokenType)node->kind;
+        return result;
+    }
+    return NULL;
+}
+
+// Lower the tree of the last successful parse, once
+const AstNode* lowerParseTree(Parser* parser) {
+    if (!parser->ast && parser->tree) parser->ast = lowerNode(parser, parser->tree);
+    return parser->ast;
+}
+
+Parser* createParser() {
+    Parser* parser = calloc(1, sizeof(Parser));
+    if (parser) {
+        parser->outputDir = "output";
+        parser->traceEnabled = traceByDefault;
+        parser->outputs = outputsByDefault;
+    }
+    return parser;
+}
+
+// Drop the tree and memo of the previous parse
+static void resetParser(Parser* parser) {
+    freeMemoTable(parser);
+    releaseTree(parser);
+    parser->tree = NULL;
+    parser->ast = NULL;
+    flat_tree_free(parser->flatTree);
+    parser->flatTree = NULL;
+}
+
+void destroyParser(Parser* parser) {
+    if (!parser) return;
+    resetParser(parser);
+    free(parser->markStack);
+    free(parser);
+}
+
+// Parse the tokens loaded into the parser. The tree stays in parser->tree
+// until the next parse; the memo is only needed while parsing.
+static int parseLoaded(Parser* parser) {
+    resetParser(parser);
+    parser->currentTokenIndex = 0;
+    parser->markDepth = 0;
+    parser->outOfMemory = 0;
+    parser->literalHint = 0;
+    parser->treeSource = parser->tokens->source;
+    openParseTrace(parser);
+
+    parser->tree = parseSimplicity(parser);
+    if (parser->outOfMemory) {
+        // Rules that lost a node failed or dropped a child, so the tree
+        // cannot be trusted
+        fprintf(stderr, "Error: out of memory while parsing\n");
+        parser->tree = NULL;
+    }
+
+    freeMemoTable(parser);
+    if (parser->trace_file) {
+        fclose(parser->trace_file);
+        parser->trace_file = NULL;
+    }
+    return parser->tree != NULL;
+}
+
+// Parse lexer tokens without writing any output files
+int parseLexedTokens(Parser* parser, const TokenStream* tokens) {
+    parser->tokens = tokens;
+    parser->token_count = tokens->count;
+
+    int parsed = parseLoaded(parser);
+    parser->tokens = NULL;
+    parser->token_count = 0;
+    return parsed;
+}
+
+// Read tokens from `pull` while parsing instead of loading them all first
+static void startPull(Parser* parser, const LexerState* lexer, TokenPull pull, void* context) {
+    parser->window.count = 0;
+    parser->window.literal_count = 0;
+    parser->literalHint = 0;
+    parser->window.source = lexer_source(lexer);
+    parser->tokens = &parser->window;
+    parser->tokenBase = 0;
+    parser->token_count = 0;
+    parser->pull = pull;
+    parser->pullContext = context;
+}
+
+static void endPull(Parser* parser) {
+    token_stream_free(&parser->window);
+    parser->tokens = NULL;
+    parser->tokenBase = 0;
+    parser->token_count = 0;
+    parser->pull = NULL;
+    parser->pullContext = NULL;
+}
+
+// Parse tokens pulled from a stream without writing any output files
+int parsePulledTokens(Parser* parser, const LexerState* lexer, TokenPull pull, void* context) {
+    startPull(parser, lexer, pull, context);
+    int parsed = parseLoaded(parser);
+    endPull(parser);
+    return parsed;
+}
+
+// Parse tokens pulled from a stream and write the output files into outputDir
+int writePulledParseOutputs(Parser* parser, const LexerState* lexer, TokenPull pull, void* context, const char* outputDir) {
+    startPull(parser, lexer, pull, context);
+    parser->outputDir = outputDir;
+
+    int parsed = parseTokens(parser);
+    endPull(parser);
+    parser->outputDir = "output";
+    return parsed;
+}
+
+// Parse lexer tokens and write parsed.txt and the tree files into outputDir
+int writeParseOutputs(Parser* parser, const TokenStream* tokens, const char* outputDir) {
+    parser->tokens = tokens;
+    parser->token_count = tokens->count;
+    parser->outputDir = outputDir;
+
+    int parsed = parseTokens(parser);
+    parser->tokens = NULL;
+    parser->token_count = 0;
+    parser->outputDir = "output";
+    return parsed;
+}
+
 void runParser(const char* symbol_table_file) {
+    Parser* parser = createParser();
+    if (!parser) return;
+    parser->verbose = 1;
+
     // Read the symbol table
-    tokens = readSymbolTable(symbol_table_file, &token_count);
-    if (!tokens) {
+    TokenStream tokens;
+    if (!readSymbolTable(symbol_table_file, &tokens)) {
         fprintf(stderr, "Failed to read symbol table\n");
+        destroyParser(parser);
         return;
     }
 
-    // Open parsed.txt for writing
-    parsed_file = fopen("output/parsed.txt", "w");
-    if (!parsed_file) {
-        fprintf(stderr, "Failed to open output/parsed.txt for writing\n");
-        // Clean up tokens before returning
-        for (size_t i = 0; i < token_count; i++) {
-            free(tokens[i].type);
-            free(tokens[i].value);
-        }
-        free(tokens);
-        return;
+    parser->tokens = &tokens;
+    parser->token_count = tokens.count;
+    parseTokens(parser);
+    freeSymbolTable(&tokens);
+    destroyParser(parser);
+}
+
+// Parse the tokens returned by lexer_lex() without going through symbol_table.txt
+void runParserTokens(const TokenStream* tokens, const char* outputDir) {
+    Parser* parser = createParser();
+    if (!parser) return;
+    parser->verbose = 1;
+
+    writeParseOutputs(parser, tokens, outputDir);
+    destroyParser(parser);
+}
+
+// Open <outputDir>/<name> for writing
+static FILE* openOutput(Parser* parser, const char* name) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/%s", parser->outputDir, name);
+
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "Failed to open %s for writing\n", path);
     }
+    return file;
+}
 
-    // Initialize parsing state
-    currentTokenIndex = 0;
-    nextNodeID = 0;
+// Open <outputDir>/<name> if `output` is one of the parser's outputs
+static FILE* openSelectedOutput(Parser* parser, unsigned output, const char* name) {
+    return (parser->outputs & output) ? openOutput(parser, name) : NULL;
+}
 
-    // Parse the input starting from the top-level nonterminal
-    TreeNode* parseTree = parseSimplicity();
-    
-    if (parseTree) {
-        printf("Parsing successful!\n");
-        fprintf(parsed_file, "Parsing successful!\n\n");
+// Output files by ParseOutput flag
+static const struct {
+    unsigned output;
+    const char* name;
+} OUTPUT_FILES[] = {
+    { PARSE_OUTPUT_PARSED, "parsed.txt" },
+    { PARSE_OUTPUT_CSV, "parse_tree.csv" },
+    { PARSE_OUTPUT_PARENTHESIZED, "parse_tree_parenthesized.txt" },
+    { PARSE_OUTPUT_AST, "ast.txt" },
+    { PARSE_OUTPUT_TREE_BINARY, "parse_tree.bin" },
+};
 
-        // Write the parse tree in the original format to parsed.txt
-        fprintf(parsed_file, "Parsed Tree:\n");
-        writeParseTree(parsed_file, parseTree);
+// Delete the files of earlier runs that this parser does not write, so
+// none of them is taken for a result of this run
+static void removeDeselectedOutputs(Parser* parser) {
+    for (size_t i = 0; i < sizeof(OUTPUT_FILES) / sizeof(OUTPUT_FILES[0]); i++) {
+        if (parser->outputs & OUTPUT_FILES[i].output) continue;
 
-        // Write the CSV format
-        FILE* csvFile = fopen("output/parse_tree.csv", "w");
-        if (csvFile) {
-            fprintf(csvFile, "NodeID,ParentID,Value\n");
-            writeParseTree(csvFile, parseTree);
-            fclose(csvFile);
-        } else {
-            fprintf(stderr, "Failed to open output/parse_tree.csv for writing\n");
+        char path[4096];
+        snprintf(path, sizeof(path), "%s/%s", parser->outputDir, OUTPUT_FILES[i].name);
+        remove(path);
+    }
+}
+
+// Parse the loaded tokens and write the selected output files
+static int parseTokens(Parser* parser) {
+    removeDeselectedOutputs(parser);
+
+    // Open parsed.txt for writing
+    FILE* parsed_file = openSelectedOutput(parser, PARSE_OUTPUT_PARSED, "parsed.txt");
+    if (!parsed_file && (parser->outputs & PARSE_OUTPUT_PARSED)) return 0;
+
+    // Parse the input starting from the top-level nonterminal; the tree
+    // writers all work on its preorder layout
+    int parsed = parseLoaded(parser);
+    const FlatTree* flatTree = parsed ? flattenParseTree(parser) : NULL;
+
+    if (parsed) {
+        LOG_PARSE(parser, "Parsing successful!\n");
+        if (parsed_file) {
+            fprintf(parsed_file, "Parsing successful!\n\n");
+            fprintf(parsed_file, "Parsed Tree:\n");
         }
 
-        // Write the parenthesized format
-        FILE* txtFile = fopen("output/parse_tree_parenthesized.txt", "w");
-        if (txtFile) {
-            writeParseTreeParenthesized(txtFile, parseTree, 0);
-            fclose(txtFile);
-        } else {
-            fprintf(stderr, "Failed to open output/parse_tree_parenthesized.txt for writing\n");
+        // parsed.txt, the CSV format and the parenthesized format, written
+        // together in one scan of the tree
+        FILE* csvFile = openSelectedOutput(parser, PARSE_OUTPUT_CSV, "parse_tree.csv");
+        if (csvFile) fprintf(csvFile, "NodeID,ParentID,Value\n");
+        FILE* txtFile = openSelectedOutput(parser, PARSE_OUTPUT_PARENTHESIZED, "parse_tree_parenthesized.txt");
+        if (flatTree) writeTreeOutputs(flatTree, parsed_file, csvFile, txtFile);
+        if (csvFile) fclose(csvFile);
+        if (txtFile) fclose(txtFile);
+
+        // Save the flat tree itself, which tools can map back in
+        if ((parser->outputs & PARSE_OUTPUT_TREE_BINARY) && flatTree) {
+            char path[4096];
+            snprintf(path, sizeof(path), "%s/parse_tree.bin", parser->outputDir);
+            if (!flat_tree_save(flatTree, path)) {
+                fprintf(stderr, "Failed to open %s for writing\n", path);
+            }
         }
 
-        // Free the parse tree
-        freeTree(parseTree);
+        // Write the abstract syntax tree
+        FILE* astFile = openSelectedOutput(parser, PARSE_OUTPUT_AST, "ast.txt");
+        if (astFile) {
+            write_ast(lowerParseTree(parser), astFile);
+            fclose(astFile);
+        }
     } else {
         // Report parsing failure
-        printf("Parsing failed at token %zu: %s\n", 
-               currentTokenIndex, 
-               currentTokenIndex < token_count ? tokens[currentTokenIndex].type : "END");
-        fprintf(parsed_file, "Parsing failed at token %zu: %s\n", 
-                currentTokenIndex, 
-                currentTokenIndex < token_count ? tokens[currentTokenIndex].type : "END");
-    }
-
-    // Clean up
-    fclose(parsed_file);
-    for (size_t i = 0; i < token_count; i++) {
-        free(tokens[i].type);
-        free(tokens[i].value);
-    }
-    free(tokens);
-}
-
-// New function to write parse tree in parenthesized format
-void writeParseTreeParenthesized(FILE* file, TreeNode* node, int depth) {
-    if (!node) return;
-    
-    // Add indentation for better readability
-    for (int i = 0; i < depth; i++) {
-        fprintf(file, "  ");
-    }
-    
-    // Print the current node's value
-    fprintf(file, "(%s", node->value);
-    
-    // If node has children, print them on new lines
-    if (node->childCount > 0) {
-        fprintf(file, "\n");
-        for (size_t i = 0; i < node->childCount; i++) {
-            writeParseTreeParenthesized(file, node->children[i], depth + 1);
-        }
-        // Close parenthesis on a new line with proper indentation
-        for (int i = 0; i < depth; i++) {
-            fprintf(file, "  ");
+        LOG_PARSE(parser, "Parsing failed at token %zu: %s\n", 
+               parser->currentTokenIndex, 
+               hasToken(parser, parser->currentTokenIndex) ? token_type_to_string(tokenKind(parser, parser->currentTokenIndex)) : "END");
+        if (parsed_file) {
+            fprintf(parsed_file, "Parsing failed at token %zu: %s\n", 
+                    parser->currentTokenIndex, 
+                    hasToken(parser, parser->currentTokenIndex) ? token_type_to_string(tokenKind(parser, parser->currentTokenIndex)) : "END");
         }
-        fprintf(file, ")\n");
-    } else {
-        // For leaf nodes, close parenthesis on the same line
-        fprintf(file, ")\n");
     }
-}
\ No newline at end of file
+
+    if (parsed_file) fclose(parsed_file);
+    return parsed;
+}
+
+// Write the tree in parenthesized format, one node per line
+void writeParseTreeParenthesized(FILE* file, const FlatTree* tree) {
+    writeTreeOutputs(tree, NULL, NULL, file);
+}
@@ -1,85 +1,170 @@
-#ifndef PARSER_H
-#define PARSER_H
-
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-
-// Define the maximum number of children for a parse tree node
-#define MAX_CHILDREN 10
-
-// Define the TreeNode structure
-typedef struct TreeNode {
-    int nodeID;               // Unique ID for the node
-    int parentID;             // Parent node ID
-    char value[256];          // Value or label of the node
-    int childCount;           // Number of children
-    struct TreeNode* children[MAX_CHILDREN]; // Array of child nodes
-} TreeNode;
-
-// Function declarations
-
-/**
- * Create a new parse tree node.
- * @param id The unique ID of the node.
- * @param parentID The ID of the parent node.
- * @param value The value or label of the node.
- * @return A pointer to the newly created TreeNode.
- */
-TreeNode* createNode(int id, int parentID, const char* value);
-
-/**
- * Add a child node to a parent node.
- * @param parent The parent TreeNode.
- * @param child The child TreeNode to add.
- */
-void addChild(TreeNode* parent, TreeNode* child);
-
-/**
- * Save the parse tree to a CSV file.
- * @param root The root of the parse tree.
- * @param filename The name of the CSV file to save to.
- */
-void saveParseTreeToCSV(TreeNode* root, const char* filename);
-
-/**
- * Log parsing output messages to a text file.
- * @param message The message to log.
- * @param filename The name of the text file to log to.
- */
-void logParsedOutput(const char* message, const char* filename);
-
-/**
- * Advance the current token in the lexer.
- */
-void advanceToken();
-
-/**
- * Match and consume a token of the expected type.
- * @param expectedType The expected token type.
- * @return 1 if the token matches, 0 otherwise.
- */
-int matchToken(const char* expectedType);
-
-/**
- * Parse an expression.
- * @param parent The parent TreeNode for the expression.
- * @return A pointer to the TreeNode representing the parsed expression.
- */
-TreeNode* parseExpression(TreeNode* parent);
-
-/**
- * Parse an assignment statement.
- * @param parent The parent TreeNode for the assignment.
- * @return A pointer to the TreeNode representing the parsed assignment.
- */
-TreeNode* parseAssignment(TreeNode* parent);
-
-/**
- * Run the parser on a token file.
- * @param tokenFile The file containing tokens to parse.
- * @return 1 if parsing succeeds, 0 otherwise.
- */
-int runParser(const char* tokenFile);
-
-#endif // PARSER_H
+#ifndef PARSER_H
+#define PARSER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lexers.h"
+#include "ast.h"
+#include "flat_tree.h"
+
+/**
+ * Parser context holding the tokens, position, tree arena and memo of one
+ * parse. Separate parsers share no state and may run on different threads.
+ */
+typedef struct Parser Parser;
+
+/**
+ * The files a parse writes into its output directory, as flags for
+ * setParseOutputs().
+ */
+typedef enum {
+    PARSE_OUTPUT_PARSED = 1 << 0,         // parsed.txt
+    PARSE_OUTPUT_CSV = 1 << 1,            // parse_tree.csv
+    PARSE_OUTPUT_PARENTHESIZED = 1 << 2,  // parse_tree_parenthesized.txt
+    PARSE_OUTPUT_AST = 1 << 3,            // ast.txt
+    PARSE_OUTPUT_TREE_BINARY = 1 << 4     // parse_tree.bin, see flat_tree_save()
+} ParseOutput;
+
+#define PARSE_OUTPUT_DEFAULT (PARSE_OUTPUT_PARSED | PARSE_OUTPUT_CSV | PARSE_OUTPUT_PARENTHESIZED | PARSE_OUTPUT_AST)
+
+/**
+ * Create a parser. It prints no match log; its trace and output settings
+ * are taken from setParseTrace() and setParseOutputs().
+ * @return A new parser, or NULL if out of memory.
+ */
+Parser* createParser();
+
+/**
+ * Free a parser together with the tree of its last parse.
+ * @param parser The parser to destroy (may be NULL).
+ */
+void destroyParser(Parser* parser);
+
+/**
+ * Parse the tokens returned by lexer_lex() without writing output files.
+ * The parser reads the stream in place; it must stay alive until this
+ * returns. The resulting tree is kept until the next parse or destroyParser().
+ * @param parser The parser to run.
+ * @param tokens The token stream produced by lexer_lex().
+ * @return 1 if the whole program parsed, 0 otherwise.
+ */
+int parseLexedTokens(Parser* parser, const TokenStream* tokens);
+
+/**
+ * Parse the tokens returned by lexer_lex() and write the output files
+ * selected by setParseOutputs() (by default parsed.txt, parse_tree.csv,
+ * parse_tree_parenthesized.txt and ast.txt; parse_trace.txt too when
+ * tracing) into outputDir, which must already exist.
+ * @param parser The parser to run.
+ * @param tokens The token stream produced by lexer_lex().
+ * @param outputDir Directory for the output files.
+ * @return 1 if the whole program parsed, 0 otherwise.
+ */
+int writeParseOutputs(Parser* parser, const TokenStream* tokens, const char* outputDir);
+
+/**
+ * Parse tokens as a TokenPull source delivers them, e.g. from a lexer
+ * running on another thread, without writing output files. Tokens are
+ * pulled only when the parser reaches them.
+ * @param parser The parser to run.
+ * @param lexer The lexer state that owns the tokens' source.
+ * @param pull Returns the next tokens, or 0 at the end of the stream.
+ * @param context Passed to every pull call.
+ * @return 1 if the whole program parsed, 0 otherwise.
+ */
+int parsePulledTokens(Parser* parser, const LexerState* lexer, TokenPull pull, void* context);
+/**
+ * Like parsePulledTokens(), but also write the output files of
+ * writeParseOutputs() into outputDir. The stream may end early if the
+ * parse fails; the caller drains whatever is left.
+ * @param parser The parser to run.
+ * @param lexer The lexer state that owns the tokens' source.
+ * @param pull Returns the next tokens, or 0 at the end of the stream.
+ * @param context Passed to every pull call.
+ * @param outputDir Directory for the output files.
+ * @return 1 if the whole program parsed, 0 otherwise.
+ */
+int writePulledParseOutputs(Parser* parser, const LexerState* lexer, TokenPull pull, void* context, const char* outputDir);
+/**
+ * Lower the tree of the parser's last successful parse into an abstract
+ * syntax tree (see ast.h). It is built on the first call and kept, like
+ * the parse tree, until the next parse or destroyParser(). Its names and
+ * literals point into the parsed source, which must outlive their use.
+ * @param parser The parser whose last parse to lower.
+ * @return The PROGRAM node, or NULL if the last parse failed.
+ */
+const AstNode* lowerParseTree(Parser* parser);
+
+/**
+ * Copy the tree of the parser's last successful parse into a FlatTree
+ * (see flat_tree.h). Node IDs are preorder positions, as in
+ * parse_tree.csv, and flat_tree_parent() looks up a parent by ID. It is
+ * built on the first call and freed with the parse tree; use
+ * flat_tree_copy() to keep it longer.
+ * @param parser The parser whose last parse to flatten.
+ * @return The flat tree, or NULL if the last parse failed.
+ */
+const FlatTree* flattenParseTree(Parser* parser);
+
+/**
+ * Name of a parse tree node kind, as written to the output files.
+ * @param kind The kind of a FlatNode.
+ * @return The label, or "UNKNOWN" for a kind the parser does not produce.
+ */
+const char* nodeKindLabel(uint32_t kind);
+
+/**
+ * Write a flat tree in the formats of parsed.txt (the node lines only),
+ * parse_tree.csv (without its header line) and
+ * parse_tree_parenthesized.txt, all in one scan of the tree. Each view
+ * is collected in a buffer of its own and written in large blocks.
+ * @param tree A tree from flattenParseTree() or flat_tree_map().
+ * @param parsed File for the parsed.txt lines, or NULL to skip them.
+ * @param csv File for the CSV lines, or NULL to skip them.
+ * @param parenthesized File for the parenthesized view, or NULL to skip it.
+ */
+void writeTreeOutputs(const FlatTree* tree, FILE* parsed, FILE* csv, FILE* parenthesized);
+
+/**
+ * Write a flat tree in the format of parse_tree_parenthesized.txt.
+ * @param file The file to write to.
+ * @param tree A tree from flattenParseTree() or flat_tree_map().
+ */
+void writeParseTreeParenthesized(FILE* file, const FlatTree* tree);
+
+/**
+ * Choose the files the parser writes next to each other in outputDir.
+ * A file that is not selected is not written, and a copy left there by
+ * an earlier run is deleted.
+ * @param outputs ParseOutput flags for parsers created afterwards.
+ */
+void setParseOutputs(unsigned outputs);
+
+/**
+ * Enable or disable the match trace written to parse_trace.txt in the
+ * output directory.
+ * Each successful match adds one "<index> <lexeme>" line; use
+ * tools/expand_trace to rebuild the full token-stream view per match.
+ * @param enabled Nonzero to trace parsers created afterwards.
+ */
+void setParseTrace(int enabled);
+
+/**
+ * Run the parser on a token file.
+ * @param tokenFile The file containing tokens to parse.
+ */
+void runParser(const char* tokenFile);
+
+/**
+ * Run the parser directly on the tokens returned by lexer_lex(), printing
+ * the match log and writing the output files into outputDir, which must
+ * already exist. The tokens are only borrowed and must stay alive until
+ * this returns.
+ * @param tokens The token stream produced by lexer_lex().
+ * @param outputDir Directory for the output files.
+ */
+void runParserTokens(const TokenStream* tokens, const char* outputDir);
+
+#endif // PARSER_H
@@ -0,0 +1,142 @@
+#include "pipeline.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Tokens in flight between the threads; a power of two
+#ifndef QUEUE_CAPACITY
+#define QUEUE_CAPACITY 4096
+#endif
+
+#define CACHE_LINE 64
+
+// Single-producer/single-consumer ring. Each index is written by one
+// thread only and lives on its own cache line; each side also caches the
+// other's index and rereads it only when the ring looks full or empty.
+typedef struct {
+    _Alignas(CACHE_LINE) atomic_size_t head;  // Next slot to read, written by the consumer
+    size_t cached_tail;                       // Consumer's copy of tail
+    _Alignas(CACHE_LINE) atomic_size_t tail;  // Next slot to write, written by the producer
+    size_t cached_head;                       // Producer's copy of head
+    atomic_int closed;                        // Set by the producer after its last push
+    _Alignas(CACHE_LINE) Token slots[QUEUE_CAPACITY];
+} TokenQueue;
+
+typedef struct {
+    LexerState *lexer;
+    TokenQueue *queue;
+    const TokenStream *tokens;
+} LexJob;
+
+// TokenSink for the lexer thread: wait while the ring is full, then publish
+static void queue_push(void *context, const Token *token) {
+    TokenQueue *queue = context;
+    size_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+
+    while (tail - queue->cached_head == QUEUE_CAPACITY) {
+        queue->cached_head = atomic_load_explicit(&queue->head, memory_order_acquire);
+        if (tail - queue->cached_head == QUEUE_CAPACITY) sched_yield();
+    }
+
+    queue->slots[tail & (QUEUE_CAPACITY - 1)] = *token;
+    atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+}
+
+// TokenPull for the parser thread: take whatever is ready, waiting only
+// while the ring is empty and the lexer has not finished
+static size_t queue_pull(void *context, Token *out, size_t max) {
+    TokenQueue *queue = context;
+    size_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+
+    while (queue->cached_tail == head) {
+        // Read closed before tail: a push made before closing is then visible
+        int closed = atomic_load_explicit(&queue->closed, memory_order_acquire);
+        queue->cached_tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+        if (queue->cached_tail != head) break;
+        if (closed) return 0;
+        sched_yield();
+    }
+
+    size_t count = queue->cached_tail - head;
+    if (count > max) count = max;
+    for (size_t i = 0; i < count; i++) {
+        out[i] = queue->slots[(head + i) & (QUEUE_CAPACITY - 1)];
+    }
+    atomic_store_explicit(&queue->head, head + count, memory_order_release);
+    return count;
+}
+
+static void *run_lexer(void *arg) {
+    LexJob *job = arg;
+    job->tokens = lexer_tokenize(job->lexer);
+    atomic_store_explicit(&job->queue->closed, 1, memory_order_release);
+    return NULL;
+}
+
+const TokenStream *lex_and_parse_pipelined(LexerState *lexer, Parser *parser, const char *path,
+                                           const char *output_dir, int *parsed) {
+    *parsed = 0;
+    if (!lexer_load(lexer, path)) return NULL;
+
+    TokenQueue *queue = aligned_alloc(CACHE_LINE, sizeof(TokenQueue));
+    if (!queue) return NULL;
+    memset(queue, 0, sizeof(TokenQueue));
+
+    LexJob job = { lexer, queue, NULL };
+    lexer_set_sink(lexer, queue_push, queue);
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, run_lexer, &job) != 0) {
+        // No second thread: lex everything first, then parse as usual
+        lexer_set_sink(lexer, NULL, NULL);
+        free(queue);
+        const TokenStream *tokens = lexer_tokenize(lexer);
+        if (tokens) {
+            *parsed = output_dir ? writeParseOutputs(parser, tokens, output_dir)
+                                 : parseLexedTokens(parser, tokens);
+        }
+        return tokens;
+    }
+
+    *parsed = output_dir ? writePulledParseOutputs(parser, lexer, queue_pull, queue, output_dir)
+                         : parsePulledTokens(parser, lexer, queue_pull, queue);
+
+    // A failed parse stops pulling early; let the lexer run to the end
+    Token rest[256];
+    while (queue_pull(queue, rest, 256) > 0) {}
+
+    pthread_join(thread, NULL);
+    lexer_set_sink(lexer, NULL, NULL);
+    free(queue);
+    return job.tokens;
+}
+
+typedef struct {
+    LexerState *lexer;
+    size_t token_count;
+} Stream;
+
+// TokenPull straight from the lexer, one token at a time
+static size_t stream_pull(void *context, Token *out, size_t max) {
+    Stream *stream = context;
+    size_t count = 0;
+    while (count < max && lexer_next_token(stream->lexer, &out[count])) count++;
+    stream->token_count += count;
+    return count;
+}
+
+int parse_streaming(LexerState *lexer, Parser *parser, const char *output_dir, size_t *token_count) {
+    Stream stream = { lexer, 0 };
+    int parsed = output_dir ? writePulledParseOutputs(parser, lexer, stream_pull, &stream, output_dir)
+                            : parsePulledTokens(parser, lexer, stream_pull, &stream);
+
+    // A failed parse stops pulling early; the sink still gets every token
+    Token rest[256];
+    while (stream_pull(&stream, rest, 256) > 0) {}
+
+    *token_count = stream.token_count;
+    return parsed;
+}
@@ -0,0 +1,28 @@
+#ifndef PIPELINE_H_
+#define PIPELINE_H_
+
+#include "lexers.h"
+#include "parser.h"
+
+// Ways to run the parser while the lexer is still producing tokens.
+
+// Pipelined mode: load `path` ("-" for stdin), then lex it on a second
+// thread that hands each token through a bounded lock-free single-
+// producer/single-consumer ring to `parser` on this one. Output files go to
+// output_dir, or nowhere when it is NULL. The lexer keeps every token,
+// so the caller can still print them or write the symbol table.
+// Returns the tokens, or NULL if the source could not be read; *parsed
+// receives the parse result.
+const TokenStream *lex_and_parse_pipelined(LexerState *lexer, Parser *parser, const char *path,
+                                           const char *output_dir, int *parsed);
+
+// Streaming mode: one thread and no token array. The parser pulls tokens
+// from lexer_next_token() only when it reaches them and keeps just the
+// window its open backtrack marks can still rewind to. `lexer` must have
+// a source loaded by lexer_load(); its sink, if set, sees every token
+// once, e.g. to write the symbol table. Output files go to output_dir, or
+// nowhere when it is NULL. Returns the parse result; *token_count
+// receives the number of tokens lexed.
+int parse_streaming(LexerState *lexer, Parser *parser, const char *output_dir, size_t *token_count);
+
+#endif // PIPELINE_H_
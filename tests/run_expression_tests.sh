@@ -0,0 +1,36 @@
+#!/bin/sh
+# Expression parsing tests: parses every tests/expressions/<case>.cty and
+# compares its parse_tree.csv and ast.txt with the expected copies in
+# tests/expressions/<case>/. The cases cover operator precedence, left
+# and right associativity (a ^ b ^ c is a ^ (b ^ c)), unary NOT and
+# parentheses.
+#
+# Build: gcc -O2 -pthread main.c lexers.c parser.c arena.c batch.c pipeline.c ast.c flat_tree.c output_buffer.c -o simplicty
+# Usage: tests/run_expression_tests.sh [path/to/simplicty] (default ./simplicty, run from the repository root)
+
+compiler=${1:-./simplicty}
+cases=tests/expressions
+work=$(mktemp -d) || exit 1
+trap 'rm -rf "$work"' EXIT
+
+failures=0
+for source in "$cases"/*.cty; do
+    name=$(basename "$source" .cty)
+    mkdir -p "$work/$name"
+    "$compiler" --out "$work/$name" --no-symbol-table --emit csv,ast "$source" > /dev/null
+
+    status="ok  "
+    for file in parse_tree.csv ast.txt; do
+        if ! diff -u "$cases/$name/$file" "$work/$name/$file"; then
+            status="FAIL"
+        fi
+    done
+    [ "$status" = "FAIL" ] && failures=$((failures + 1))
+    echo "$status $name"
+done
+
+if [ "$failures" -ne 0 ]; then
+    echo "$failures expression tests failed."
+    exit 1
+fi
+echo "All expression tests passed."
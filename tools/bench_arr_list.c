@@ -0,0 +1,71 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../lexers.h"
+#include "../parser.h"
+
+// Microbenchmark for long child lists: parses a main() holding one array
+// initializer with N elements, so ARR_LIST gets 2N - 1 children through
+// parseArrList(). Lexing and parsing are timed separately.
+//
+// Build: gcc -O2 -o bench_arr_list tools/bench_arr_list.c lexers.c parser.c arena.c ast.c flat_tree.c output_buffer.c
+// Usage: bench_arr_list [elements] (run where output/ exists; default 100000)
+
+double elapsed_ms(struct timespec start, struct timespec end) {
+    return (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6;
+}
+
+// Write the benchmark program into a temporary file
+FILE *make_source(long elements) {
+    FILE *file = tmpfile();
+    if (!file) return NULL;
+
+    fprintf(file, "integer main() {\n    integer values[%ld] = [", elements);
+    for (long i = 0; i < elements; i++) {
+        fprintf(file, i ? ", %ld" : "%ld", i % 1000);
+    }
+    fprintf(file, "];\n}\n");
+    rewind(file);
+    return file;
+}
+
+int main(int argc, char *argv[]) {
+    long elements = argc > 1 ? atol(argv[1]) : 100000;
+    if (elements < 1) {
+        fprintf(stderr, "Usage: %s [elements]\n", argv[0]);
+        return 1;
+    }
+
+    FILE *source = make_source(elements);
+    if (!source) {
+        perror("tmpfile");
+        return 1;
+    }
+
+    struct timespec start, lexed, parsed;
+    size_t token_count = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    LexerState *lexer = lexer_create();
+    const TokenStream *tokens = lexer_lex_stream(lexer, source);
+    clock_gettime(CLOCK_MONOTONIC, &lexed);
+    fclose(source);
+    if (!tokens) {
+        fprintf(stderr, "Lexer failed\n");
+        return 1;
+    }
+
+    // The parser reports its own progress on stdout; keep the results on stderr
+    token_count = tokens->count;
+    runParserTokens(tokens, "output");
+    clock_gettime(CLOCK_MONOTONIC, &parsed);
+
+    fprintf(stderr, "elements: %ld\ntokens:   %zu\nlex:      %.1f ms\nparse:    %.1f ms\n",
+            elements, token_count, elapsed_ms(start, lexed), elapsed_ms(lexed, parsed));
+
+    lexer_destroy(lexer);
+    return 0;
+}
@@ -0,0 +1,119 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../lexers.h"
+#include "../parser.h"
+
+// Tree output benchmark: parses a program once, then writes the lines of
+// parsed.txt and parse_tree.csv and the parenthesized view to /dev/null,
+// repeatedly, in two ways:
+//   fprintf   three passes over the tree, one fprintf per field, as the
+//             writers did before writeTreeOutputs()
+//   emitter   writeTreeOutputs(): one pass, buffered, formatted by hand
+// The best and mean time of each is reported.
+//
+// Build: gcc -O2 -o bench_emit tools/bench_emit.c lexers.c parser.c arena.c ast.c flat_tree.c output_buffer.c
+// Usage: bench_emit <file.cty> [runs] (default 10)
+
+double elapsed_ms(struct timespec start, struct timespec end) {
+    return (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6;
+}
+
+void write_lines_fprintf(FILE *file, const FlatTree *tree) {
+    const uint32_t *parents = flat_tree_parents(tree);
+    for (uint32_t i = 0; i < tree->count; i++) {
+        long parent = parents[i] == FLAT_TREE_NO_PARENT ? -1 : (long)parents[i];
+        fprintf(file, "%u,%ld,%s\n", i, parent, nodeKindLabel(tree->nodes[i].kind));
+    }
+}
+
+void write_parenthesized_fprintf(FILE *file, const FlatTree *tree) {
+    uint32_t *ends = malloc(((size_t)tree->count + 1) * sizeof(uint32_t));
+    size_t depth = 0;
+    for (uint32_t i = 0; i <= tree->count; i++) {
+        while (depth > 0 && ends[depth - 1] <= i) {
+            depth--;
+            fprintf(file, "%*s)\n", (int)depth * 2, "");
+        }
+        if (i == tree->count) break;
+
+        const FlatNode *node = &tree->nodes[i];
+        fprintf(file, "%*s(%s", (int)depth * 2, "", nodeKindLabel(node->kind));
+        if (node->size == 1) {
+            fprintf(file, ")\n");
+            continue;
+        }
+        fprintf(file, "\n");
+        ends[depth++] = i + node->size;
+    }
+    free(ends);
+}
+
+void write_fprintf(const FlatTree *tree, FILE *parsed, FILE *csv, FILE *parenthesized) {
+    write_lines_fprintf(parsed, tree);
+    write_lines_fprintf(csv, tree);
+    write_parenthesized_fprintf(parenthesized, tree);
+}
+
+int main(int argc, char *argv[]) {
+    int runs = argc > 2 ? atoi(argv[2]) : 10;
+    if (argc < 2 || runs < 1) {
+        fprintf(stderr, "Usage: %s <file.cty> [runs]\n", argv[0]);
+        return 1;
+    }
+
+    LexerState *lexer = lexer_create();
+    const TokenStream *tokens = lexer ? lexer_lex(lexer, argv[1]) : NULL;
+    Parser *parser = createParser();
+    if (!tokens || !parser) {
+        fprintf(stderr, "Setup failed\n");
+        return 1;
+    }
+    const FlatTree *tree = parseLexedTokens(parser, tokens) ? flattenParseTree(parser) : NULL;
+    if (!tree) {
+        fprintf(stderr, "%s does not parse\n", argv[1]);
+        return 1;
+    }
+
+    FILE *files[3];
+    for (int i = 0; i < 3; i++) {
+        files[i] = fopen("/dev/null", "w");
+        if (!files[i]) {
+            perror("/dev/null");
+            return 1;
+        }
+    }
+
+    const char *names[2] = { "fprintf", "emitter" };
+    double best[2] = { 0, 0 }, total[2] = { 0, 0 };
+    for (int run = 0; run < runs; run++) {
+        for (int way = 0; way < 2; way++) {
+            struct timespec start, end;
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            if (way == 0) {
+                write_fprintf(tree, files[0], files[1], files[2]);
+            } else {
+                writeTreeOutputs(tree, files[0], files[1], files[2]);
+            }
+            for (int i = 0; i < 3; i++) fflush(files[i]);
+            clock_gettime(CLOCK_MONOTONIC, &end);
+
+            double ms = elapsed_ms(start, end);
+            total[way] += ms;
+            if (run == 0 || ms < best[way]) best[way] = ms;
+        }
+    }
+
+    printf("nodes:      %u\n", tree->count);
+    for (int way = 0; way < 2; way++) {
+        printf("%-8s    best %.2f ms, mean %.2f ms\n", names[way], best[way], total[way] / runs);
+    }
+    printf("speedup:    %.1fx (best)\n", best[0] / best[1]);
+
+    for (int i = 0; i < 3; i++) fclose(files[i]);
+    destroyParser(parser);
+    lexer_destroy(lexer);
+    return 0;
+}
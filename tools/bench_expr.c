@@ -0,0 +1,88 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../lexers.h"
+#include "../parser.h"
+
+// Expression parsing benchmark: parses a main() holding N assignments
+// whose right-hand sides mix arithmetic, comparisons, logical operators
+// and a bare literal, so every precedence level is exercised. The source
+// is lexed once; parseLexedTokens() runs repeatedly and the best and
+// mean parse times are reported. Nothing is written to output/.
+//
+// Build: gcc -O2 -o bench_expr tools/bench_expr.c lexers.c parser.c arena.c ast.c flat_tree.c output_buffer.c
+// Usage: bench_expr [statements] [runs] (defaults 20000 and 10)
+
+static const char *const EXPRESSIONS[] = {
+    "1 + 2 * 3 < 4 - 5 && 6 >= 7",
+    "true",
+    "1 < 2 && 3 > 4 || 5 == 6",
+    "(1 + 2) * 3 < 4",
+    "1 + 2 * 3 - 4 / 5 < 6",
+    "2 ^ 3 ^ 2 != 7 % 5",
+};
+
+double elapsed_ms(struct timespec start, struct timespec end) {
+    return (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6;
+}
+
+// Write the benchmark program into a temporary file
+FILE *make_source(long statements) {
+    FILE *file = tmpfile();
+    if (!file) return NULL;
+
+    size_t kinds = sizeof(EXPRESSIONS) / sizeof(EXPRESSIONS[0]);
+    fprintf(file, "integer main() {\n");
+    for (long i = 0; i < statements; i++) {
+        fprintf(file, "    x = %s;\n", EXPRESSIONS[i % kinds]);
+    }
+    fprintf(file, "}\n");
+    rewind(file);
+    return file;
+}
+
+int main(int argc, char *argv[]) {
+    long statements = argc > 1 ? atol(argv[1]) : 20000;
+    int runs = argc > 2 ? atoi(argv[2]) : 10;
+    if (statements < 1 || runs < 1) {
+        fprintf(stderr, "Usage: %s [statements] [runs]\n", argv[0]);
+        return 1;
+    }
+
+    FILE *source = make_source(statements);
+    if (!source) {
+        perror("tmpfile");
+        return 1;
+    }
+
+    LexerState *lexer = lexer_create();
+    const TokenStream *tokens = lexer_lex_stream(lexer, source);
+    fclose(source);
+    Parser *parser = createParser();
+    if (!tokens || !parser) {
+        fprintf(stderr, "Setup failed\n");
+        return 1;
+    }
+
+    int parsed = 0;
+    double best = 0, total = 0;
+    for (int run = 0; run < runs; run++) {
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        parsed = parseLexedTokens(parser, tokens);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        double ms = elapsed_ms(start, end);
+        total += ms;
+        if (run == 0 || ms < best) best = ms;
+    }
+
+    printf("statements: %ld\ntokens:     %zu\nparsed:     %s\nbest:       %.2f ms\nmean:       %.2f ms\n",
+           statements, tokens->count, parsed ? "yes" : "no", best, total / runs);
+
+    destroyParser(parser);
+    lexer_destroy(lexer);
+    return 0;
+}
@@ -0,0 +1,57 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../lexers.h"
+
+// Lexer throughput: load a file once, then run lexer_tokenize() over it
+// repeatedly and report MB/s of source scanned. Prints the best and the
+// mean of the runs. Nothing is written to output/. Set CTY_SIMD=scalar,
+// sse2 or avx2 to compare the run-skipping kernels.
+//
+// Build: gcc -O2 -o bench_lexer tools/bench_lexer.c lexers.c
+// Usage: [CTY_SIMD=scalar|sse2|avx2] bench_lexer <file.cty> [runs]
+
+double elapsed_ms(struct timespec start, struct timespec end) {
+    return (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2 || argc > 3) {
+        fprintf(stderr, "Usage: %s <file.cty> [runs]\n", argv[0]);
+        return 1;
+    }
+    int runs = argc == 3 ? atoi(argv[2]) : 20;
+    if (runs < 1) runs = 1;
+
+    LexerState *lexer = lexer_create();
+    FILE *file = fopen(argv[1], "rb");
+    if (!lexer || !file || !lexer_load(lexer, argv[1])) {
+        fprintf(stderr, "Error: cannot read %s\n", argv[1]);
+        return 1;
+    }
+    fseek(file, 0, SEEK_END);
+    double megabytes = ftell(file) / (1024.0 * 1024.0);
+    fclose(file);
+
+    size_t token_count = 0;
+    double best = 0, total = 0;
+    for (int run = 0; run < runs; run++) {
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        token_count = lexer_tokenize(lexer)->count;
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        double ms = elapsed_ms(start, end);
+        total += ms;
+        if (run == 0 || ms < best) best = ms;
+    }
+
+    printf("input:  %.2f MB, %zu tokens\nbest:   %.1f ms (%.1f MB/s)\nmean:   %.1f ms (%.1f MB/s)\n",
+           megabytes, token_count, best, megabytes / (best / 1e3),
+           total / runs, megabytes / (total / runs / 1e3));
+
+    lexer_destroy(lexer);
+    return 0;
+}
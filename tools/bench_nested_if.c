@@ -0,0 +1,91 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#include "../lexers.h"
+#include "../parser.h"
+
+// Conditional parsing benchmark: parses a main() holding ifs nested N
+// deep. Every level is tried as IFELSE_STMT, ELSEIF_STMT and IF_STMT, so
+// without the packrat memo the parse time grows exponentially with N.
+// With "else" every level also gets an else block, which the first
+// alternative accepts. The source is lexed once; parseLexedTokens() runs
+// repeatedly and the best and mean parse times and the peak RSS are
+// reported. Nothing is written to output/.
+//
+// Build: gcc -O2 -o bench_nested_if tools/bench_nested_if.c lexers.c parser.c arena.c ast.c flat_tree.c output_buffer.c
+// Usage: bench_nested_if [depth] [runs] [else] (defaults 1024 and 10)
+
+double elapsed_ms(struct timespec start, struct timespec end) {
+    return (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6;
+}
+
+// Write the benchmark program into a temporary file
+FILE *make_source(long depth, int with_else) {
+    FILE *file = tmpfile();
+    if (!file) return NULL;
+
+    fprintf(file, "integer x;\ninteger main(void) {\n");
+    for (long i = 0; i < depth; i++) {
+        fprintf(file, "if (x > %ld) { ", i);
+    }
+    fprintf(file, "display(\"a\");");
+    for (long i = 0; i < depth; i++) {
+        fprintf(file, with_else ? " } else { display(\"b\"); }" : " }");
+    }
+    fprintf(file, "\n}\n");
+    rewind(file);
+    return file;
+}
+
+int main(int argc, char *argv[]) {
+    long depth = argc > 1 ? atol(argv[1]) : 1024;
+    int runs = argc > 2 ? atoi(argv[2]) : 10;
+    int with_else = argc > 3 && strcmp(argv[3], "else") == 0;
+    if (depth < 1 || runs < 1 || (argc > 3 && !with_else)) {
+        fprintf(stderr, "Usage: %s [depth] [runs] [else]\n", argv[0]);
+        return 1;
+    }
+
+    FILE *source = make_source(depth, with_else);
+    if (!source) {
+        perror("tmpfile");
+        return 1;
+    }
+
+    LexerState *lexer = lexer_create();
+    const TokenStream *tokens = lexer_lex_stream(lexer, source);
+    fclose(source);
+    Parser *parser = createParser();
+    if (!tokens || !parser) {
+        fprintf(stderr, "Setup failed\n");
+        return 1;
+    }
+
+    int parsed = 0;
+    double best = 0, total = 0;
+    for (int run = 0; run < runs; run++) {
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        parsed = parseLexedTokens(parser, tokens);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        double ms = elapsed_ms(start, end);
+        total += ms;
+        if (run == 0 || ms < best) best = ms;
+    }
+
+    const FlatTree *tree = parsed ? flattenParseTree(parser) : NULL;
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    printf("depth:      %ld%s\ntokens:     %zu\nnodes:      %u\nparsed:     %s\nbest:       %.2f ms\nmean:       %.2f ms\npeak RSS:   %ld KB\n",
+           depth, with_else ? " (with else)" : "", tokens->count, tree ? tree->count : 0,
+           parsed ? "yes" : "no", best, total / runs, usage.ru_maxrss);
+
+    destroyParser(parser);
+    lexer_destroy(lexer);
+    return 0;
+}
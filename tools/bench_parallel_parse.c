@@ -0,0 +1,90 @@
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../lexers.h"
+#include "../parser.h"
+
+// Batch benchmark for the reentrant lexer and parser: every thread keeps
+// its own LexerState and Parser and takes the next unparsed file until
+// none are left. Nothing is written to output/.
+//
+// Build: gcc -O2 -pthread -o bench_parallel_parse tools/bench_parallel_parse.c lexers.c parser.c arena.c ast.c flat_tree.c output_buffer.c
+// Usage: bench_parallel_parse <threads> <file.cty>...
+
+typedef struct {
+    char **files;
+    int file_count;
+    int next_file;
+    int parsed;
+    size_t tokens;
+    pthread_mutex_t lock;
+} Batch;
+
+double elapsed_ms(struct timespec start, struct timespec end) {
+    return (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6;
+}
+
+void *parse_worker(void *arg) {
+    Batch *batch = arg;
+    LexerState *lexer = lexer_create();
+    Parser *parser = createParser();
+    if (!lexer || !parser) {
+        lexer_destroy(lexer);
+        destroyParser(parser);
+        return NULL;
+    }
+
+    for (;;) {
+        pthread_mutex_lock(&batch->lock);
+        int file = batch->next_file++;
+        pthread_mutex_unlock(&batch->lock);
+        if (file >= batch->file_count) break;
+
+        const TokenStream *tokens = lexer_lex(lexer, batch->files[file]);
+        if (!tokens) {
+            fprintf(stderr, "Cannot read %s\n", batch->files[file]);
+            continue;
+        }
+        int parsed = parseLexedTokens(parser, tokens);
+
+        pthread_mutex_lock(&batch->lock);
+        batch->parsed += parsed;
+        batch->tokens += tokens->count;
+        pthread_mutex_unlock(&batch->lock);
+    }
+
+    destroyParser(parser);
+    lexer_destroy(lexer);
+    return NULL;
+}
+
+int main(int argc, char *argv[]) {
+    int thread_count = argc > 2 ? atoi(argv[1]) : 0;
+    if (thread_count < 1) {
+        fprintf(stderr, "Usage: %s <threads> <file.cty>...\n", argv[0]);
+        return 1;
+    }
+
+    Batch batch = { argv + 2, argc - 2, 0, 0, 0, PTHREAD_MUTEX_INITIALIZER };
+    pthread_t *threads = malloc(sizeof(pthread_t) * thread_count);
+    struct timespec start, end;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < thread_count; i++) {
+        pthread_create(&threads[i], NULL, parse_worker, &batch);
+    }
+    for (int i = 0; i < thread_count; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double ms = elapsed_ms(start, end);
+    printf("threads: %d\nfiles:   %d (%d parsed)\ntokens:  %zu\ntime:    %.1f ms\nrate:    %.1f Mtokens/s\n",
+           thread_count, batch.file_count, batch.parsed, batch.tokens, ms, batch.tokens / ms / 1e3);
+
+    free(threads);
+    return 0;
+}
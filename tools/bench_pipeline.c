@@ -0,0 +1,62 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../lexers.h"
+#include "../parser.h"
+#include "../pipeline.h"
+
+// End-to-end latency of one file: lexing to completion and then parsing,
+// against lex_and_parse_pipelined() where the parser consumes tokens while
+// the lexer thread produces them. Nothing is written to output/.
+//
+// Build: gcc -O2 -pthread -o bench_pipeline tools/bench_pipeline.c lexers.c parser.c arena.c ast.c flat_tree.c output_buffer.c pipeline.c
+// Usage: bench_pipeline <file.cty> [runs]
+
+double elapsed_ms(struct timespec start, struct timespec end) {
+    return (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6;
+}
+
+int main(int argc, char *argv[]) {
+    int runs = argc > 2 ? atoi(argv[2]) : 5;
+    if (argc < 2 || runs < 1) {
+        fprintf(stderr, "Usage: %s <file.cty> [runs]\n", argv[0]);
+        return 1;
+    }
+
+    LexerState *lexer = lexer_create();
+    Parser *parser = createParser();
+    double best_sequential = 0, best_pipelined = 0;
+    size_t token_count = 0;
+    int parsed = 0;
+
+    for (int run = 0; run < runs; run++) {
+        struct timespec start, end;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        const TokenStream *tokens = lexer_lex(lexer, argv[1]);
+        if (!tokens) {
+            fprintf(stderr, "Cannot read %s\n", argv[1]);
+            return 1;
+        }
+        token_count = tokens->count;
+        parsed = parseLexedTokens(parser, tokens);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double ms = elapsed_ms(start, end);
+        if (run == 0 || ms < best_sequential) best_sequential = ms;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        lex_and_parse_pipelined(lexer, parser, argv[1], NULL, &parsed);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        ms = elapsed_ms(start, end);
+        if (run == 0 || ms < best_pipelined) best_pipelined = ms;
+    }
+
+    printf("tokens:     %zu (%s)\nsequential: %.1f ms\npipelined:  %.1f ms\n",
+           token_count, parsed ? "parsed" : "parse failed", best_sequential, best_pipelined);
+
+    destroyParser(parser);
+    lexer_destroy(lexer);
+    return 0;
+}
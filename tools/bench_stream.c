@@ -0,0 +1,57 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#include "../lexers.h"
+#include "../parser.h"
+#include "../pipeline.h"
+
+// Peak memory and time of one parse, either from the full token array
+// (lexer_lex + parseLexedTokens) or streamed through parse_streaming().
+// Run each mode in its own process: the peak RSS covers the whole run.
+// Nothing is written to output/.
+//
+// Build: gcc -O2 -pthread -o bench_stream tools/bench_stream.c lexers.c parser.c arena.c ast.c flat_tree.c output_buffer.c pipeline.c
+// Usage: bench_stream <array | stream> <file.cty>
+
+double elapsed_ms(struct timespec start, struct timespec end) {
+    return (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 3 || (strcmp(argv[1], "array") != 0 && strcmp(argv[1], "stream") != 0)) {
+        fprintf(stderr, "Usage: %s <array | stream> <file.cty>\n", argv[0]);
+        return 1;
+    }
+
+    LexerState *lexer = lexer_create();
+    Parser *parser = createParser();
+    size_t token_count = 0;
+    int parsed = 0;
+    struct timespec start, end;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (strcmp(argv[1], "array") == 0) {
+        const TokenStream *tokens = lexer_lex(lexer, argv[2]);
+        if (tokens) {
+            token_count = tokens->count;
+            parsed = parseLexedTokens(parser, tokens);
+        }
+    } else if (lexer_load(lexer, argv[2])) {
+        parsed = parse_streaming(lexer, parser, NULL, &token_count);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    printf("mode:     %s\ntokens:   %zu (%s)\ntime:     %.1f ms\npeak RSS: %.1f MB\n",
+           argv[1], token_count, parsed ? "parsed" : "parse failed",
+           elapsed_ms(start, end), usage.ru_maxrss / 1024.0);
+
+    destroyParser(parser);
+    lexer_destroy(lexer);
+    return 0;
+}
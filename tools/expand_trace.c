@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Rebuilds the old per-match view of parsed.txt from output/parse_trace.txt.
+// Every trace line "<index> <lexeme>" becomes one line listing the lexemes
+// of the tokens consumed so far followed by the types of the remaining ones.
+//
+// Usage: expand_trace [parse_trace.txt] > parsed_full.txt
+
+// Read a whole line of any length, without the trailing newline
+char *read_line(FILE *file) {
+    size_t capacity = 256;
+    size_t length = 0;
+    char *line = malloc(capacity);
+    int c;
+
+    while ((c = fgetc(file)) != EOF && c != '\n') {
+        if (length + 1 == capacity) {
+            capacity *= 2;
+            line = realloc(line, capacity);
+        }
+        line[length++] = (char)c;
+    }
+
+    if (c == EOF && length == 0) {
+        free(line);
+        return NULL;
+    }
+    line[length] = '\0';
+    return line;
+}
+
+// Undo the \n and \\ escapes written by writeParsingDelta()
+void unescape(char *text) {
+    char *out = text;
+    for (char *in = text; *in; in++) {
+        if (*in == '\\' && in[1] == 'n') {
+            *out++ = '\n';
+            in++;
+        } else if (*in == '\\' && in[1] == '\\') {
+            *out++ = '\\';
+            in++;
+        } else {
+            *out++ = *in;
+        }
+    }
+    *out = '\0';
+}
+
+int main(int argc, char *argv[]) {
+    const char *path = argc > 1 ? argv[1] : "output/parse_trace.txt";
+    FILE *trace = fopen(path, "r");
+    if (!trace) {
+        fprintf(stderr, "Error: Unable to open %s\n", path);
+        return 1;
+    }
+
+    size_t token_count = 0;
+    if (fscanf(trace, "TOKENS %zu\n", &token_count) != 1) {
+        fprintf(stderr, "Error: %s is not a parse trace\n", path);
+        fclose(trace);
+        return 1;
+    }
+
+    // Header line: the type of every token, separated by spaces
+    char *header = read_line(trace);
+    char **types = calloc(token_count + 1, sizeof(char *));
+    char **values = calloc(token_count + 1, sizeof(char *));
+    size_t type_count = 0;
+    for (char *type = strtok(header ? header : "", " "); type && type_count < token_count; type = strtok(NULL, " ")) {
+        types[type_count++] = type;
+    }
+
+    char *line;
+    while ((line = read_line(trace)) != NULL) {
+        char *lexeme = strchr(line, ' ');
+        if (!lexeme) {
+            free(line);
+            continue;
+        }
+        *lexeme++ = '\0';
+
+        size_t index = strtoul(line, NULL, 10);
+        if (index >= type_count) {
+            free(line);
+            continue;
+        }
+        unescape(lexeme);
+        free(values[index]);
+        values[index] = strdup(lexeme);
+        free(line);
+
+        // Tokens up to the matched one show their lexeme, the rest their type
+        for (size_t i = 0; i < type_count; i++) {
+            printf("%s ", i <= index ? (values[i] ? values[i] : "") : types[i]);
+        }
+        printf("\n");
+    }
+
+    for (size_t i = 0; i < type_count; i++) {
+        free(values[i]);
+    }
+    free(values);
+    free(types);
+    free(header);
+    fclose(trace);
+    return 0;
+}
@@ -0,0 +1,533 @@
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../lexers.h"
+
+// Generates scanner_dfa.h, the byte-indexed DFA that tokenize() runs,
+// and the perfect hash table of the words in KEYWORD_LIST.
+// Operators and delimiters come from the spellings in TOKEN_LIST; words,
+// numbers, strings, characters, comments and whitespace follow the rules
+// below, which mirror what the hand-written classify_* functions did.
+// The scanner stops on the first byte without a transition and then acts
+// on the state it stopped in, so every token is the longest match.
+// States that loop on most bytes (whitespace, comment and string bodies)
+// are tagged with a ScanRun, so the lexer can skip them with SIMD kernels;
+// build() checks each run against the bytes the kernels stop on.
+//
+// Build: gcc -o gen_scanner tools/gen_scanner.c
+// Usage: gen_scanner > scanner_dfa.h
+
+// What scan_token() does when the DFA stops in a state
+#define SCAN_ACTIONS(X) \
+    X(SCAN_END,                "End of input") \
+    X(SCAN_SKIP,               "Whitespace, or a lone '&' or '|': no token") \
+    X(SCAN_TOKEN,              "The whole lexeme, typed by SCAN_TYPE") \
+    X(SCAN_INTEGER,            "NUM_CONST, decoded into an int64_t") \
+    X(SCAN_REAL,               "FLOAT_CONST, decoded into a double") \
+    X(SCAN_WORD,               "Identifier or keyword, typed by classify_word()") \
+    X(SCAN_INVALID,            "Word or number with characters it may not contain") \
+    X(SCAN_STRING,             "String body between the quotes, typed by SCAN_TYPE") \
+    X(SCAN_OPEN_STRING,        "String that runs to the end of the input") \
+    X(SCAN_CHAR,               "Character constant") \
+    X(SCAN_EMPTY_CHAR,         "'' or ' at the end of the input: no token") \
+    X(SCAN_LONG_CHAR,          "Character constant with more than one character") \
+    X(SCAN_CLOSED_LONG_CHAR,   "The same, ended by its closing apostrophe") \
+    X(SCAN_LINE_COMMENT,       "~~ comment") \
+    X(SCAN_BLOCK_COMMENT,      "~^ ... ^~ comment") \
+    X(SCAN_OPEN_BLOCK_COMMENT, "~^ comment that runs to the end of the input") \
+    X(SCAN_UNRECOGNIZED,       "A byte no token starts with")
+
+typedef enum {
+#define ACTION_ENUM(action, description) action,
+    SCAN_ACTIONS(ACTION_ENUM)
+#undef ACTION_ENUM
+} ScanAction;
+
+static const char *const ACTION_NAMES[] = {
+#define ACTION_NAME(action, description) #action,
+    SCAN_ACTIONS(ACTION_NAME)
+#undef ACTION_NAME
+};
+
+static const char *const ACTION_DESCRIPTIONS[] = {
+#define ACTION_DESCRIPTION(action, description) description,
+    SCAN_ACTIONS(ACTION_DESCRIPTION)
+#undef ACTION_DESCRIPTION
+};
+
+// Long runs scan_token() may skip many bytes at a time. The kernels in
+// lexers.c stop on the bytes for which run_continues() is false.
+#define SCAN_RUNS(X) \
+    X(SCAN_RUN_NONE,          "No run") \
+    X(SCAN_RUN_SPACE,         "Whitespace") \
+    X(SCAN_RUN_LINE_COMMENT,  "~~ comment body, up to '\\n'") \
+    X(SCAN_RUN_BLOCK_COMMENT, "~^ comment body, up to '^'") \
+    X(SCAN_RUN_STRING,        "String body, up to '\"' or '%'")
+
+typedef enum {
+#define RUN_ENUM(run, description) run,
+    SCAN_RUNS(RUN_ENUM)
+#undef RUN_ENUM
+} ScanRun;
+
+static const char *const RUN_NAMES[] = {
+#define RUN_NAME(run, description) #run,
+    SCAN_RUNS(RUN_NAME)
+#undef RUN_NAME
+};
+
+static const char *const RUN_DESCRIPTIONS[] = {
+#define RUN_DESCRIPTION(run, description) description,
+    SCAN_RUNS(RUN_DESCRIPTION)
+#undef RUN_DESCRIPTION
+};
+
+// '\0' ends every run, like it ends the input in any state
+static int run_continues(ScanRun run, int c) {
+    switch (run) {
+        case SCAN_RUN_SPACE:         return c == ' ' || (c >= '\t' && c <= '\r');
+        case SCAN_RUN_LINE_COMMENT:  return c != '\0' && c != '\n';
+        case SCAN_RUN_BLOCK_COMMENT: return c != '\0' && c != '^';
+        case SCAN_RUN_STRING:        return c != '\0' && c != '"' && c != '%';
+        default:                     return 0;
+    }
+}
+
+static const char *const TYPE_NAMES[] = {
+#define TYPE_NAME(type, name, spelling) #type,
+    TOKEN_LIST(TYPE_NAME)
+#undef TYPE_NAME
+};
+
+typedef struct {
+    TokenType type;
+    const char *spelling;
+} Spelling;
+
+static const Spelling SPELLINGS[] = {
+#define TYPE_SPELLING(type, name, spelling) { type, spelling },
+    TOKEN_LIST(TYPE_SPELLING)
+#undef TYPE_SPELLING
+};
+
+#define MAX_STATES 256
+
+typedef struct {
+    unsigned char next[256];
+    ScanAction action;
+    TokenType type;
+    int newline;    // Entered only by a '\n' that starts a new line
+    ScanRun run;
+} State;
+
+static State states[MAX_STATES];
+static int state_count = 0;
+
+enum { STOP, START };
+
+static int add_state(ScanAction action, TokenType type, int newline) {
+    if (state_count == MAX_STATES) {
+        fprintf(stderr, "gen_scanner: more than %d states\n", MAX_STATES);
+        exit(1);
+    }
+    State *state = &states[state_count];
+    state->action = action;
+    state->type = type;
+    state->newline = newline;
+    state->run = SCAN_RUN_NONE;
+    return state_count++;
+}
+
+static void mark_run(const int *run_states, int count, ScanRun run) {
+    for (int i = 0; i < count; i++) states[run_states[i]].run = run;
+}
+
+static void on(int from, int c, int to) {
+    states[from].next[(unsigned char)c] = (unsigned char)to;
+}
+
+// Every byte except '\0', which ends the input in any state
+static void on_any(int from, int to) {
+    for (int c = 1; c < 256; c++) on(from, c, to);
+}
+
+static void on_chars(int from, const char *chars, int to) {
+    for (; *chars; chars++) on(from, *chars, to);
+}
+
+static int is_word_char(int c) {
+    return isalnum(c) || c == '_';
+}
+
+// Claim a byte that starts a hand-written token; it must not start a spelling
+static int unrecognized;
+static void lead(int c, int to) {
+    if (states[START].next[c] != unrecognized) {
+        fprintf(stderr, "gen_scanner: '%c' starts both a spelled token and a rule\n", c);
+        exit(1);
+    }
+    on(START, c, to);
+}
+
+static void build(void) {
+    add_state(SCAN_END, TOKEN_EOF, 0);      // STOP: no transitions
+    add_state(SCAN_END, TOKEN_EOF, 0);      // START: stops only on '\0'
+
+    unrecognized = add_state(SCAN_UNRECOGNIZED, TOKEN_UNKNOWN, 0);
+    on_any(START, unrecognized);
+
+    // Fixed spellings, as a trie of states. A prefix that is not a token
+    // itself, such as a lone '&', is dropped like before.
+    for (size_t i = 0; i < sizeof(SPELLINGS) / sizeof(SPELLINGS[0]); i++) {
+        const char *spelling = SPELLINGS[i].spelling;
+        if (!spelling) continue;
+
+        int state = START;
+        for (const char *c = spelling; *c; c++) {
+            int next = states[state].next[(unsigned char)*c];
+            if (next == STOP || next == unrecognized) {
+                next = add_state(SCAN_SKIP, TOKEN_UNKNOWN, 0);
+                on(state, *c, next);
+            }
+            state = next;
+        }
+        if (states[state].action == SCAN_TOKEN) {
+            fprintf(stderr, "gen_scanner: \"%s\" is spelled twice\n", spelling);
+            exit(1);
+        }
+        states[state].action = SCAN_TOKEN;
+        states[state].type = SPELLINGS[i].type;
+    }
+
+    // Whitespace
+    int space = add_state(SCAN_SKIP, TOKEN_UNKNOWN, 0);
+    int space_newline = add_state(SCAN_SKIP, TOKEN_UNKNOWN, 1);
+    for (int c = 1; c < 256; c++) {
+        if (!isspace(c)) continue;
+        int to = c == '\n' ? space_newline : space;
+        lead(c, to);
+        on(space, c, to);
+        on(space_newline, c, to);
+    }
+    int spaces[] = { space, space_newline };
+    mark_run(spaces, 2, SCAN_RUN_SPACE);
+
+    // Words: letters, digits and '_'; "@#.`?" make them invalid and any
+    // other punctuation ends them
+    int word = add_state(SCAN_WORD, IDENTIFIER, 0);
+    int bad_word = add_state(SCAN_INVALID, TOKEN_INVALID, 0);
+    for (int c = 1; c < 256; c++) {
+        if (isalpha(c) || c == '_') lead(c, word);
+        if (is_word_char(c)) {
+            on(word, c, word);
+            on(bad_word, c, bad_word);
+        }
+    }
+    on_chars(word, "@#.`?", bad_word);
+    on_chars(bad_word, "@#.`?", bad_word);
+
+    // Numbers: digits with at most one '.'; letters, '@' or '#' make them invalid
+    int integer = add_state(SCAN_INTEGER, NUM_CONST, 0);
+    int real = add_state(SCAN_REAL, FLOAT_CONST, 0);
+    int bad_number = add_state(SCAN_INVALID, TOKEN_INVALID, 0);
+    int numbers[] = { integer, real, bad_number };
+    for (int i = 0; i < 3; i++) {
+        for (int c = 1; c < 256; c++) {
+            if (isdigit(c)) on(numbers[i], c, numbers[i]);
+            if (isalpha(c)) on(numbers[i], c, bad_number);
+        }
+        on_chars(numbers[i], "@#", bad_number);
+    }
+    for (int c = '0'; c <= '9'; c++) lead(c, integer);
+    on(integer, '.', real);
+    on(real, '.', bad_number);
+    on(bad_number, '.', bad_number);
+
+    // Strings: a '%' followed by one of "dcfs" makes a format string.
+    // The byte after any '%' is taken as is, even a '\n'.
+    int string_ends[2], string_bodies[2], string_percents[2];
+    TokenType string_types[2] = { STR_CONST, STR_WITH_FORMAT };
+    for (int i = 0; i < 2; i++) {
+        string_bodies[i] = add_state(SCAN_OPEN_STRING, string_types[i], 0);
+        string_percents[i] = add_state(SCAN_OPEN_STRING, string_types[i], 0);
+        string_ends[i] = add_state(SCAN_STRING, string_types[i], 0);
+    }
+    for (int i = 0; i < 2; i++) {
+        int body_newline = add_state(SCAN_OPEN_STRING, string_types[i], 1);
+        int bodies[] = { string_bodies[i], body_newline };
+        for (int b = 0; b < 2; b++) {
+            on_any(bodies[b], string_bodies[i]);
+            on(bodies[b], '"', string_ends[i]);
+            on(bodies[b], '%', string_percents[i]);
+            on(bodies[b], '\n', body_newline);
+        }
+        mark_run(bodies, 2, SCAN_RUN_STRING);
+        on_any(string_percents[i], string_bodies[i]);
+        on(string_percents[i], '"', string_ends[i]);
+    }
+    on_chars(string_percents[0], "dcfs", string_bodies[1]);
+    lead('"', string_bodies[0]);
+
+    // Character constants
+    int char_open = add_state(SCAN_EMPTY_CHAR, TOKEN_INVALID, 0);
+    int char_one = add_state(SCAN_LONG_CHAR, TOKEN_INVALID, 0);
+    int char_done = add_state(SCAN_CHAR, CHAR_CONST, 0);
+    int char_long = add_state(SCAN_LONG_CHAR, TOKEN_INVALID, 0);
+    int char_long_done = add_state(SCAN_CLOSED_LONG_CHAR, TOKEN_INVALID, 0);
+    on_any(char_open, char_one);
+    on(char_open, '\'', STOP);
+    on_any(char_one, char_long);
+    on(char_one, '\'', char_done);
+    on_any(char_long, char_long);
+    on(char_long, '\'', char_long_done);
+    lead('\'', char_open);
+
+    // Comments; a '~' starting neither is unrecognized
+    int tilde = add_state(SCAN_UNRECOGNIZED, TOKEN_UNKNOWN, 0);
+    int line_comment = add_state(SCAN_LINE_COMMENT, TOKEN_COMMENT, 0);
+    int block = add_state(SCAN_OPEN_BLOCK_COMMENT, TOKEN_COMMENT, 0);
+    int block_newline = add_state(SCAN_OPEN_BLOCK_COMMENT, TOKEN_COMMENT, 1);
+    int block_caret = add_state(SCAN_OPEN_BLOCK_COMMENT, TOKEN_COMMENT, 0);
+    int block_done = add_state(SCAN_BLOCK_COMMENT, TOKEN_COMMENT, 0);
+    on(tilde, '~', line_comment);
+    on(tilde, '^', block);
+    on_any(line_comment, line_comment);
+    on(line_comment, '\n', STOP);
+    int blocks[] = { block, block_newline, block_caret };
+    for (int b = 0; b < 3; b++) {
+        on_any(blocks[b], block);
+        on(blocks[b], '^', block_caret);
+        on(blocks[b], '\n', block_newline);
+    }
+    on(block_caret, '~', block_done);
+    lead('~', tilde);
+    mark_run(&line_comment, 1, SCAN_RUN_LINE_COMMENT);
+    mark_run(blocks, 2, SCAN_RUN_BLOCK_COMMENT);
+}
+
+// A run state must stay in its run on exactly the bytes its kernel skips,
+// and enter a newline state on '\n' only, or skipped lines would be lost
+static void check_runs(void) {
+    for (int s = 0; s < state_count; s++) {
+        ScanRun run = states[s].run;
+        if (run == SCAN_RUN_NONE) {
+            if (states[s].newline) {
+                fprintf(stderr, "gen_scanner: newline state %d is not in a run\n", s);
+                exit(1);
+            }
+            continue;
+        }
+        for (int c = 0; c < 256; c++) {
+            const State *next = &states[states[s].next[c]];
+            int stays = next->run == run;
+            if (stays != run_continues(run, c) || (stays && next->newline != (c == '\n'))) {
+                fprintf(stderr, "gen_scanner: %s state %d disagrees with its kernel on byte %d\n", RUN_NAMES[run], s, c);
+                exit(1);
+            }
+        }
+    }
+}
+
+// Number the run states last and the newline states (all in runs) after
+// them, so the scanner needs one comparison per byte to notice a run and
+// one more per run to count a line
+static int order[MAX_STATES], number[MAX_STATES];
+static int first_run_state, first_newline_state;
+
+static void renumber(void) {
+    int count = 0;
+    for (int group = 0; group < 3; group++) {
+        if (group == 1) first_run_state = count;
+        if (group == 2) first_newline_state = count;
+        for (int s = 0; s < state_count; s++) {
+            int state_group = states[s].newline ? 2 : states[s].run != SCAN_RUN_NONE;
+            if (state_group != group) continue;
+            order[count] = s;
+            number[s] = count++;
+        }
+    }
+}
+
+// Keywords hash to (KEYWORD_ASSO[first byte] + KEYWORD_ASSO[last byte] +
+// length) % KEYWORD_SLOTS. The association values are searched for,
+// gperf style, so that no two keywords share a slot and the table has no
+// more slots than needed; a lookup is then one hash and one memcmp.
+typedef struct {
+    TokenType type;
+    const char *spelling;
+    size_t length;
+} Keyword;
+
+static const Keyword KEYWORDS[] = {
+#define KEYWORD_ENTRY(type, spelling) { type, spelling, sizeof(spelling) - 1 },
+    KEYWORD_LIST(KEYWORD_ENTRY)
+#undef KEYWORD_ENTRY
+};
+#define KEYWORD_COUNT (sizeof(KEYWORDS) / sizeof(KEYWORDS[0]))
+#define MAX_SLOTS 256
+
+static int asso[256];
+static int slot_count;
+static unsigned char hashed_chars[256];  // Bytes in the order values are chosen
+static int hashed_char_count;
+static long search_steps;
+
+static int keyword_slot(const Keyword *keyword) {
+    unsigned char first = keyword->spelling[0], last = keyword->spelling[keyword->length - 1];
+    return (asso[first] + asso[last] + (int)keyword->length) % slot_count;
+}
+
+// Whether every keyword whose bytes all have values so far gets its own slot
+static int slots_distinct(int assigned) {
+    int taken[MAX_SLOTS] = {0};
+    for (size_t k = 0; k < KEYWORD_COUNT; k++) {
+        const Keyword *keyword = &KEYWORDS[k];
+        int known = 0;
+        for (int i = 0; i < assigned; i++) {
+            known += hashed_chars[i] == (unsigned char)keyword->spelling[0];
+            known += hashed_chars[i] == (unsigned char)keyword->spelling[keyword->length - 1];
+        }
+        if (known < 2) continue;
+        int slot = keyword_slot(keyword);
+        if (taken[slot]++) return 0;
+    }
+    return 1;
+}
+
+static int assign_values(int next) {
+    if (next == hashed_char_count) return 1;
+    if (++search_steps > 2000000) return 0;
+    for (int value = 0; value < slot_count; value++) {
+        asso[hashed_chars[next]] = value;
+        if (slots_distinct(next + 1) && assign_values(next + 1)) return 1;
+    }
+    asso[hashed_chars[next]] = 0;
+    return 0;
+}
+
+static void hash_keywords(void) {
+    // Bytes used most often first, so collisions show up early
+    int uses[256] = {0};
+    for (size_t k = 0; k < KEYWORD_COUNT; k++) {
+        uses[(unsigned char)KEYWORDS[k].spelling[0]]++;
+        uses[(unsigned char)KEYWORDS[k].spelling[KEYWORDS[k].length - 1]]++;
+    }
+    for (int count = (int)KEYWORD_COUNT * 2; count > 0; count--) {
+        for (int c = 0; c < 256; c++) {
+            if (uses[c] == count) hashed_chars[hashed_char_count++] = (unsigned char)c;
+        }
+    }
+
+    for (slot_count = (int)KEYWORD_COUNT; slot_count <= MAX_SLOTS; slot_count++) {
+        memset(asso, 0, sizeof(asso));
+        search_steps = 0;
+        if (assign_values(0)) return;
+    }
+    fprintf(stderr, "gen_scanner: no perfect hash for KEYWORD_LIST\n");
+    exit(1);
+}
+
+static void emit(void) {
+    printf("// Generated by tools/gen_scanner.c from TOKEN_LIST in lexers.h; do not edit.\n");
+    printf("// Rebuild: gcc -o gen_scanner tools/gen_scanner.c && ./gen_scanner > scanner_dfa.h\n");
+    printf("#ifndef SCANNER_DFA_H_\n#define SCANNER_DFA_H_\n\n");
+
+    printf("// What scan_token() does when the DFA stops in a state\ntypedef enum {\n");
+    for (size_t a = 0; a < sizeof(ACTION_NAMES) / sizeof(ACTION_NAMES[0]); a++) {
+        char name[64];
+        snprintf(name, sizeof(name), "%s,", ACTION_NAMES[a]);
+        printf("    %-25s // %s\n", name, ACTION_DESCRIPTIONS[a]);
+    }
+    printf("} ScanAction;\n\n");
+
+    printf("// Runs of bytes scan_token() may skip with a SIMD kernel\ntypedef enum {\n");
+    for (size_t r = 0; r < sizeof(RUN_NAMES) / sizeof(RUN_NAMES[0]); r++) {
+        char name[64];
+        snprintf(name, sizeof(name), "%s,", RUN_NAMES[r]);
+        printf("    %-25s // %s\n", name, RUN_DESCRIPTIONS[r]);
+    }
+    printf("} ScanRun;\n\n");
+
+    printf("#define SCAN_STOP 0\n");
+    printf("#define SCAN_START 1\n");
+    printf("#define SCAN_STATE_COUNT %d\n", state_count);
+    printf("#define SCAN_FIRST_RUN_STATE %d      // States from here on have a ScanRun\n", first_run_state);
+    printf("#define SCAN_FIRST_NEWLINE_STATE %d  // Entering one of these starts a new line\n\n", first_newline_state);
+
+    printf("// Next state for every state and input byte; SCAN_STOP ends the token\n");
+    printf("static const unsigned char SCAN_NEXT[SCAN_STATE_COUNT][256] = {\n");
+    for (int n = 0; n < state_count; n++) {
+        const State *state = &states[order[n]];
+        printf("    { // %d: %s %s\n", n, ACTION_NAMES[state->action], TYPE_NAMES[state->type]);
+        for (int c = 0; c < 256; c++) {
+            printf("%s%d,%s", c % 32 == 0 ? "        " : "", number[state->next[c]], c % 32 == 31 ? "\n" : " ");
+        }
+        printf("    },\n");
+    }
+    printf("};\n\n");
+
+    printf("static const unsigned char SCAN_ACTION[SCAN_STATE_COUNT] = {\n");
+    for (int n = 0; n < state_count; n++) {
+        printf("    %s,\n", ACTION_NAMES[states[order[n]].action]);
+    }
+    printf("};\n\n");
+
+    printf("static const unsigned char SCAN_TYPE[SCAN_STATE_COUNT] = {\n");
+    for (int n = 0; n < state_count; n++) {
+        printf("    %s,\n", TYPE_NAMES[states[order[n]].type]);
+    }
+    printf("};\n\n");
+
+    printf("static const unsigned char SCAN_RUN[SCAN_STATE_COUNT] = {\n");
+    for (int n = 0; n < state_count; n++) {
+        printf("    %s,\n", RUN_NAMES[states[order[n]].run]);
+    }
+    printf("};\n\n");
+
+    size_t min_length = SIZE_MAX, max_length = 0;
+    for (size_t k = 0; k < KEYWORD_COUNT; k++) {
+        if (KEYWORDS[k].length < min_length) min_length = KEYWORDS[k].length;
+        if (KEYWORDS[k].length > max_length) max_length = KEYWORDS[k].length;
+    }
+    printf("// Keywords from KEYWORD_LIST: a word of KEYWORD_MIN_LENGTH to KEYWORD_MAX_LENGTH\n");
+    printf("// bytes can only be the keyword in slot\n");
+    printf("// (KEYWORD_ASSO[first byte] + KEYWORD_ASSO[last byte] + length) %% KEYWORD_SLOTS\n");
+    printf("#define KEYWORD_MIN_LENGTH %zu\n", min_length);
+    printf("#define KEYWORD_MAX_LENGTH %zu\n", max_length);
+    printf("#define KEYWORD_SLOTS %d\n\n", slot_count);
+
+    printf("static const unsigned char KEYWORD_ASSO[256] = {\n");
+    for (int c = 0; c < 256; c++) {
+        printf("%s%d,%s", c % 32 == 0 ? "    " : "", asso[c], c % 32 == 31 ? "\n" : " ");
+    }
+    printf("};\n\n");
+
+    printf("// Spelling in the source, spelling printed, length and type; empty slots have length 0\n");
+    printf("static const struct { const char *spelling; const char *printed; unsigned char length; unsigned char type; } KEYWORDS[KEYWORD_SLOTS] = {\n");
+    for (int slot = 0; slot < slot_count; slot++) {
+        const Keyword *keyword = NULL;
+        for (size_t k = 0; k < KEYWORD_COUNT; k++) {
+            if (keyword_slot(&KEYWORDS[k]) == slot) keyword = &KEYWORDS[k];
+        }
+        if (!keyword) {
+            printf("    { \"\", \"\", 0, IDENTIFIER },\n");
+            continue;
+        }
+        char printed[64];
+        for (size_t i = 0; i <= keyword->length; i++) printed[i] = (char)toupper((unsigned char)keyword->spelling[i]);
+        printf("    { \"%s\", \"%s\", %zu, %s },\n", keyword->spelling, printed, keyword->length, TYPE_NAMES[keyword->type]);
+    }
+    printf("};\n\n#endif // SCANNER_DFA_H_\n");
+}
+
+int main(void) {
+    build();
+    check_runs();
+    renumber();
+    hash_keywords();
+    emit();
+    return 0;
+}
@@ -0,0 +1,25 @@
+#include <stdio.h>
+
+#include "../flat_tree.h"
+#include "../parser.h"
+
+// Prints a parse_tree.bin written with --emit ...,bin in the format of
+// parse_tree_parenthesized.txt. The file is mapped and walked in place;
+// nothing is parsed or copied.
+//
+// Build: gcc -O2 -o print_tree tools/print_tree.c lexers.c parser.c arena.c ast.c flat_tree.c output_buffer.c
+// Usage: print_tree [output/parse_tree.bin] > parse_tree_parenthesized.txt
+
+int main(int argc, char *argv[]) {
+    const char *path = argc > 1 ? argv[1] : "output/parse_tree.bin";
+
+    const FlatTree *tree = flat_tree_map(path);
+    if (!tree) {
+        fprintf(stderr, "Error: %s is not a parse tree file\n", path);
+        return 1;
+    }
+
+    writeParseTreeParenthesized(stdout, tree);
+    flat_tree_unmap(tree);
+    return 0;
+}